@@ -0,0 +1,363 @@
+#include "Compression.h"
+#include "mpi12s.h"
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+namespace mpi12s
+{
+    namespace compression
+    {
+        namespace
+        {
+            enum { MIN_MATCH     = 4
+                 , LAST_LITERALS = 5       // matches do not start in the last LAST_LITERALS bytes
+                 , MAX_OFFSET    = 65535
+                 , HASH_LOG      = 14
+                 , FORMAT        = 1       // version of the compressed format
+                 };
+
+            inline uint32_t read32(uint8_t const* p)
+            {
+                uint32_t v;
+                memcpy( &v, p, sizeof(v) );
+                return v;
+            }
+
+            inline uint64_t read64(uint8_t const* p)
+            {
+                uint64_t v;
+                memcpy( &v, p, sizeof(v) );
+                return v;
+            }
+
+         // Copy n bytes in pieces of 16 bytes, which may write up to 15 bytes beyond dst + n. Pieces of
+         // src and dst must not overlap.
+            inline void wildCopy(uint8_t* dst, uint8_t const* src, size_t n)
+            {
+                for( size_t k = 0; k < n; k += 16 )
+                    memcpy( dst + k, src + k, 16 );
+            }
+
+            inline uint32_t hash(uint32_t v)
+            {
+                return (v * 2654435761u) >> (32 - HASH_LOG);
+            }
+
+         // Write a length of 15 or more as a sequence of bytes 255, ..., 255, rest
+            inline uint8_t* writeLength(uint8_t* op, size_t len)
+            {
+                for( ; len >= 255; len -= 255 )
+                    *op++ = 255;
+                *op++ = uint8_t(len);
+                return op;
+            }
+
+            inline size_t readLength(uint8_t const*& ip, uint8_t const* iend)
+            {
+                size_t len = 0;
+                uint8_t b;
+                do {
+                    if( ip >= iend )
+                        throw std::runtime_error(::mpi12s::info + "compression::lzDecompress() : corrupt data.");
+                    b = *ip++;
+                    len += b;
+                } while( b == 255 );
+                return len;
+            }
+
+            template<size_t N>
+            void shuffleN(uint8_t* dst, uint8_t const* src, size_t nElems)
+            {
+                for( size_t i = 0; i < nElems; ++i, src += N )
+                    for( size_t j = 0; j < N; ++j )
+                        dst[j*nElems + i] = src[j];
+            }
+            template<size_t N>
+            void unshuffleN(uint8_t* dst, uint8_t const* src, size_t nElems)
+            {
+                for( size_t i = 0; i < nElems; ++i, dst += N )
+                    for( size_t j = 0; j < N; ++j )
+                        dst[j] = src[j*nElems + i];
+            }
+
+         // scratch space for the shuffled data, per thread (messages may be posted concurrently).
+            std::vector<uint8_t>& scratch()
+            {
+                thread_local std::vector<uint8_t> buffer;
+                return buffer;
+            }
+        }
+
+     //------------------------------------------------------------------------------------------------
+        void shuffle(void* dst, void const* src, size_t n, size_t typeSize)
+        {
+            uint8_t*       d = static_cast<uint8_t*>(dst);
+            uint8_t const* s = static_cast<uint8_t const*>(src);
+            size_t nElems = ( typeSize ? n/typeSize : 0 );
+            switch(typeSize) {
+                case 4: shuffleN<4>(d, s, nElems); break;
+                case 8: shuffleN<8>(d, s, nElems); break;
+                default:
+                    for( size_t i = 0; i < nElems; ++i )
+                        for( size_t j = 0; j < typeSize; ++j )
+                            d[j*nElems + i] = s[i*typeSize + j];
+            }
+         // the remaining bytes are not shuffled
+            size_t done = nElems*typeSize;
+            memcpy( d + done, s + done, n - done );
+        }
+
+        void unshuffle(void* dst, void const* src, size_t n, size_t typeSize)
+        {
+            uint8_t*       d = static_cast<uint8_t*>(dst);
+            uint8_t const* s = static_cast<uint8_t const*>(src);
+            size_t nElems = ( typeSize ? n/typeSize : 0 );
+            switch(typeSize) {
+                case 4: unshuffleN<4>(d, s, nElems); break;
+                case 8: unshuffleN<8>(d, s, nElems); break;
+                default:
+                    for( size_t i = 0; i < nElems; ++i )
+                        for( size_t j = 0; j < typeSize; ++j )
+                            d[i*typeSize + j] = s[j*nElems + i];
+            }
+            size_t done = nElems*typeSize;
+            memcpy( d + done, s + done, n - done );
+        }
+
+     //------------------------------------------------------------------------------------------------
+     // The LZ format is a sequence of
+     //    token (literal length in the high nibble, match length - MIN_MATCH in the low nibble, 15 means
+     //           that the length continues in the following bytes, see writeLength())
+     //    [literal length bytes], literals, offset (2 bytes, little endian), [match length bytes]
+     // The last sequence has only literals.
+        size_t
+        lzCompress(void* dst, size_t dstCapacity, void const* src, size_t n)
+        {
+            if( n > 0xffffffffu ) // positions are stored in 32 bits
+                return 0;
+            uint8_t const* const base = static_cast<uint8_t const*>(src);
+            uint8_t const* const iend = base + n;
+            uint8_t const* const mflimit = ( n > LAST_LITERALS + MIN_MATCH ? iend - LAST_LITERALS : base );
+            uint8_t const* ip = base;
+            uint8_t const* anchor = base;
+            uint8_t* op = static_cast<uint8_t*>(dst);
+            uint8_t* const oend = op + dstCapacity;
+            std::vector<uint32_t> table(size_t(1) << HASH_LOG, 0);
+
+            while( ip + MIN_MATCH <= mflimit )
+            {
+                uint32_t v = read32(ip);
+                uint32_t& entry = table[hash(v)];
+                uint8_t const* ref = base + entry;
+                entry = uint32_t(ip - base);
+                if( ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != v ) {
+                 // skip faster through data that does not compress
+                    ip += 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+             // extend the match backwards and forwards
+                while( ip > anchor && ref > base && ip[-1] == ref[-1] ) {
+                    --ip; --ref;
+                }
+                uint8_t const* mp = ip + MIN_MATCH;
+                uint8_t const* rp = ref + MIN_MATCH;
+                while( mp + 8 <= iend ) {// 8 bytes at a time
+                    uint64_t diff = read64(mp) ^ read64(rp);
+                    if( diff ) {
+                        mp += __builtin_ctzll(diff) >> 3; // (little endian)
+                        break;
+                    }
+                    mp += 8; rp += 8;
+                }
+                if( mp + 8 > iend )
+                    while( mp < iend && *mp == *rp ) {
+                        ++mp; ++rp;
+                    }
+                size_t litLen   = ip - anchor;
+                size_t matchLen = mp - ip - MIN_MATCH;
+             // worst case size of the sequence
+                if( size_t(oend - op) < 1 + litLen/255 + 1 + litLen + 2 + matchLen/255 + 1 )
+                    return 0;
+                uint8_t* token = op++;
+                *token = uint8_t( (std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(matchLen, 15) );
+                if( litLen >= 15 )
+                    op = writeLength(op, litLen - 15);
+                memcpy( op, anchor, litLen );
+                op += litLen;
+                size_t offset = ip - ref;
+                *op++ = uint8_t(offset);
+                *op++ = uint8_t(offset >> 8);
+                if( matchLen >= 15 )
+                    op = writeLength(op, matchLen - 15);
+                ip = anchor = mp;
+            }
+         // the last literals
+            size_t litLen = iend - anchor;
+            if( size_t(oend - op) < 1 + litLen/255 + 1 + litLen )
+                return 0;
+            *op++ = uint8_t( std::min<size_t>(litLen, 15) << 4 );
+            if( litLen >= 15 )
+                op = writeLength(op, litLen - 15);
+            memcpy( op, anchor, litLen );
+            op += litLen;
+            return op - static_cast<uint8_t*>(dst);
+        }
+
+        void
+        lzDecompress(void* dst, size_t n, void const* src, size_t srcSize)
+        {
+            uint8_t const* ip = static_cast<uint8_t const*>(src);
+            uint8_t const* const iend = ip + srcSize;
+            uint8_t* const begin = static_cast<uint8_t*>(dst);
+            uint8_t* op = begin;
+            uint8_t* const oend = op + n;
+            std::string const errmsg = ::mpi12s::info + "compression::lzDecompress() : corrupt data.";
+            while( true )
+            {
+                if( ip >= iend )
+                    throw std::runtime_error(errmsg);
+                uint8_t token = *ip++;
+                size_t litLen = token >> 4;
+                if( litLen == 15 )
+                    litLen += readLength(ip, iend);
+                if( litLen > size_t(iend - ip) || litLen > size_t(oend - op) )
+                    throw std::runtime_error(errmsg);
+                if( size_t(iend - ip) >= litLen + 16 && size_t(oend - op) >= litLen + 16 )
+                    wildCopy( op, ip, litLen );
+                else
+                    memcpy( op, ip, litLen );
+                op += litLen;
+                ip += litLen;
+                if( ip == iend )
+                    break; // the last sequence
+                if( iend - ip < 2 )
+                    throw std::runtime_error(errmsg);
+                size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+                ip += 2;
+                size_t matchLen = token & 15;
+                if( matchLen == 15 )
+                    matchLen += readLength(ip, iend);
+                matchLen += MIN_MATCH;
+                if( offset == 0 || offset > size_t(op - begin) || matchLen > size_t(oend - op) )
+                    throw std::runtime_error(errmsg);
+                uint8_t const* match = op - offset;
+                if( offset >= 16 && size_t(oend - op) >= matchLen + 16 )
+                    wildCopy( op, match, matchLen );
+                else if( offset >= matchLen )
+                    memcpy( op, match, matchLen );
+                else if( offset >= 8 ) // overlapping, but every 8 byte piece is not
+                    for( size_t k = 0; k < matchLen; k += 8 )
+                        memcpy( op + k, match + k, std::min<size_t>(8, matchLen - k) );
+                else
+                    for( size_t k = 0; k < matchLen; ++k )
+                        op[k] = match[k];
+                op += matchLen;
+            }
+            if( op != oend )
+                throw std::runtime_error(errmsg);
+        }
+
+     //------------------------------------------------------------------------------------------------
+        size_t compressBound(size_t n)
+        {
+            return HEADER_SIZE + n + n/255 + 16;
+        }
+
+        size_t
+        compress(void* dst, void const* src, size_t n, size_t typeSize)
+        {
+            if( n <= HEADER_SIZE )
+                return 0;
+            void const* data = src;
+            if( typeSize > 1 ) {
+                std::vector<uint8_t>& shuffled = scratch();
+                shuffled.resize(n);
+                shuffle( shuffled.data(), src, n, typeSize );
+                data = shuffled.data();
+            }
+         // The compressed data must be smaller than n bytes
+            size_t sz = lzCompress( static_cast<uint8_t*>(dst) + HEADER_SIZE, n - HEADER_SIZE - 1, data, n );
+            if( sz == 0 )
+                return 0;
+            uint64_t header[2] = { uint64_t(n), (uint64_t(FORMAT) << 32) | uint64_t(typeSize) };
+            memcpy( dst, header, HEADER_SIZE );
+            return HEADER_SIZE + sz;
+        }
+
+        size_t decompressedSize(void const* src)
+        {
+            uint64_t n;
+            memcpy( &n, src, sizeof(n) );
+            return n;
+        }
+
+        void
+        decompress(void* dst, void const* src, size_t srcSize)
+        {
+            uint64_t header[2];
+            if( srcSize < HEADER_SIZE ) {
+                std::string errmsg = ::mpi12s::info + "compression::decompress() : corrupt data.";
+                throw std::runtime_error(errmsg);
+            }
+            memcpy( header, src, HEADER_SIZE );
+            size_t n        = header[0];
+            size_t typeSize = header[1] & 0xffffffffu;
+            if( (header[1] >> 32) != FORMAT ) {
+                std::string errmsg = ::mpi12s::info + "compression::decompress() : unknown format.";
+                throw std::runtime_error(errmsg);
+            }
+            uint8_t const* data = static_cast<uint8_t const*>(src) + HEADER_SIZE;
+            if( typeSize > 1 ) {
+                std::vector<uint8_t>& shuffled = scratch();
+                shuffled.resize(n);
+                lzDecompress( shuffled.data(), n, data, srcSize - HEADER_SIZE );
+                unshuffle( dst, shuffled.data(), n, typeSize );
+            } else
+                lzDecompress( dst, n, data, srcSize - HEADER_SIZE );
+        }
+    }// namespace compression
+
+ //------------------------------------------------------------------------------------------------
+ // Implementation of struct CompressionStatistics
+ //------------------------------------------------------------------------------------------------
+    CompressionStatistics&
+    CompressionStatistics::
+    operator+=(CompressionStatistics const& other)
+    {
+        nCompressed       += other.nCompressed;
+        nIncompressible   += other.nIncompressible;
+        bytesIn           += other.bytesIn;
+        bytesOut          += other.bytesOut;
+        compressSeconds   += other.compressSeconds;
+        nDecompressed     += other.nDecompressed;
+        bytesDecompressed += other.bytesDecompressed;
+        decompressSeconds += other.decompressSeconds;
+        return *this;
+    }
+
+    std::vector<std::string> // list of lines
+    CompressionStatistics::
+    toStr() const
+    {
+        std::stringstream ss;
+        std::vector<std::string> lines;
+        lines.push_back("CompressionStatistics :");
+        ss<<std::setw(20)<<""<<std::setw(12)<<"messages"<<std::setw(16)<<"bytes in"<<std::setw(16)<<"bytes out"
+          <<std::setw(10)<<"ratio"<<std::setw(16)<<"MB/s";
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<std::setw(20)<<"compressed"<<std::setw(12)<<nCompressed<<std::setw(16)<<bytesIn<<std::setw(16)<<bytesOut
+          <<std::setw(10)<<std::setprecision(3)<<ratio()<<std::setw(16)<<compressThroughput()*1e-6;
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<std::setw(20)<<"decompressed"<<std::setw(12)<<nDecompressed<<std::setw(16)<<""<<std::setw(16)<<bytesDecompressed
+          <<std::setw(10)<<""<<std::setw(16)<<decompressThroughput()*1e-6;
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<"incompressible messages="<<nIncompressible;
+        lines.push_back(ss.str()); ss.str(std::string());
+        return lines;
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
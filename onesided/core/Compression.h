@@ -0,0 +1,82 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Lossless compression of message payloads: a byte shuffle followed by a fast LZ77 codec (in the
+ // style of LZ4: a hash table of 4 byte sequences, matches within a 64 KiB window, literal and match
+ // lengths in a token byte).
+ // The byte shuffle groups byte 0 of all elements, then byte 1 of all elements, etc. For arrays of
+ // floats the bytes holding the sign, exponent and high mantissa bits are then adjacent, and they
+ // are very repetitive for particle data, which the LZ stage exploits.
+ //
+ // The compressed format is a header (the uncompressed size and the element size of the shuffle),
+ // followed by the LZ compressed shuffled bytes.
+ //------------------------------------------------------------------------------------------------
+    namespace compression
+    {
+        enum { HEADER_SIZE = 16 };
+
+     // The maximum size of the compressed data of n bytes.
+        size_t compressBound(size_t n);
+
+        size_t                    // the size of the compressed data, or 0 if the compressed data would not be
+                                  // smaller than the data itself (dst is then unspecified).
+        compress
+          ( void* dst             // must have room for compressBound(n) bytes
+          , void const* src       // the data to compress
+          , size_t n              // the number of bytes to compress
+          , size_t typeSize       // the element size for the byte shuffle (1 = no shuffle)
+          );
+
+     // The size of the uncompressed data, as recorded in the compressed data.
+        size_t decompressedSize(void const* src);
+
+        void decompress
+          ( void* dst             // must have room for decompressedSize(src) bytes
+          , void const* src       // the compressed data
+          , size_t srcSize        // the size of the compressed data, in bytes
+          );                      // throws if the compressed data is corrupt.
+
+     // The building blocks
+        void shuffle  (void* dst, void const* src, size_t n, size_t typeSize);
+        void unshuffle(void* dst, void const* src, size_t n, size_t typeSize);
+        size_t lzCompress  (void* dst, size_t dstCapacity, void const* src, size_t n); // 0 if it does not fit
+        void   lzDecompress(void* dst, size_t n, void const* src, size_t srcSize);
+    }// namespace compression
+
+ //------------------------------------------------------------------------------------------------
+ // Compression statistics, to check whether compressing pays off: the bytes before and after
+ // compression, and the time spent.
+    struct CompressionStatistics
+    {
+        size_t nCompressed       = 0; // number of messages compressed
+        size_t nIncompressible   = 0; // number of messages sent uncompressed because they did not compress
+        size_t bytesIn           = 0; // uncompressed bytes of the compressed messages
+        size_t bytesOut          = 0; // compressed bytes
+        double compressSeconds   = 0;
+        size_t nDecompressed     = 0; // number of messages decompressed
+        size_t bytesDecompressed = 0; // uncompressed bytes of the decompressed messages
+        double decompressSeconds = 0;
+
+        inline double ratio() const { return bytesOut ? double(bytesIn)/bytesOut : 0; }
+     // throughput in bytes per second of uncompressed data
+        inline double compressThroughput  () const { return compressSeconds   > 0 ? bytesIn          /compressSeconds   : 0; }
+        inline double decompressThroughput() const { return decompressSeconds > 0 ? bytesDecompressed/decompressSeconds : 0; }
+
+        CompressionStatistics& operator+=(CompressionStatistics const& other);
+
+     // Intelligible string representation
+        std::vector<std::string> // list of lines
+        toStr() const;
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // COMPRESSION_H
@@ -0,0 +1,101 @@
+#include "Coroutine.h"
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class Scheduler
+ //------------------------------------------------------------------------------------------------
+    Scheduler::
+    ~Scheduler()
+    {
+        for( auto handle : tasks_ )
+            handle.destroy();
+    }
+
+    void
+    Scheduler::
+    spawn(Task task)
+    {
+        tasks_.push_back(task.handle_);
+        ready_.push_back(task.handle_);
+        task.handle_ = nullptr; // the Scheduler owns the coroutine now
+    }
+
+    void
+    Scheduler::
+    await_(MessageBuffer& messageBuffer, std::coroutine_handle<> handle)
+    {
+        exchanges_.push_back( Exchange{&messageBuffer, handle} );
+    }
+
+    void
+    Scheduler::
+    progress_(bool wait)
+    {
+        for( size_t i = 0; i < exchanges_.size(); )
+        {
+            MessageBuffer& messageBuffer = *exchanges_[i].messageBuffer;
+            if( ( wait && i == 0 ) || messageBuffer.testBroadcast() ) {
+                messageBuffer.finishBroadcast();
+                messageBuffer.readMessages();
+                messageBuffer.clear();
+                ready_.push_back( exchanges_[i].handle );
+                exchanges_.erase( exchanges_.begin() + i );
+                wait = false;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    void
+    Scheduler::
+    run()
+    {
+        std::exception_ptr exception;
+        while( !ready_.empty() || !exchanges_.empty() )
+        {
+            progress_( ready_.empty() );
+            if( ready_.empty() )
+                continue;
+            std::coroutine_handle<> handle = ready_.front();
+            ready_.pop_front();
+            handle.resume();
+        // destroy the finished coroutines
+            for( size_t i = 0; i < tasks_.size(); )
+            {
+                if( tasks_[i].done() ) {
+                    if( tasks_[i].promise().exception_ && !exception )
+                        exception = tasks_[i].promise().exception_;
+                    tasks_[i].destroy();
+                    tasks_.erase( tasks_.begin() + i );
+                } else {
+                    ++i;
+                }
+            }
+        }
+        if( exception )
+            std::rethrow_exception(exception);
+    }
+
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class Channel
+ //------------------------------------------------------------------------------------------------
+    Channel::
+    Channel
+      ( Scheduler& scheduler
+      , MessageBuffer& messageBuffer
+      )
+      : scheduler_(scheduler)
+      , messageBuffer_(messageBuffer)
+    {}
+
+    void
+    Channel::Exchange::
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        channel_.messageBuffer_.startBroadcast();
+        channel_.scheduler_.await_(channel_.messageBuffer_, handle);
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,145 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <coroutine>
+#include <deque>
+#include <vector>
+#include <exception>
+#include "MessageBuffer.h"
+
+namespace mpi12s
+{
+    class Scheduler; // forward declaration
+
+ //------------------------------------------------------------------------------------------------
+    class Task
+ // The return type of a coroutine that is executed by a Scheduler. E.g.
+ //
+ //     Task step(Scheduler& scheduler, Channel& channel, MyMessageHandler& mh)
+ //     {
+ //         mh.postMessage(next_rank());
+ //         co_await channel.exchange();   // other ready coroutines run, while the messages travel
+ //         /* the messages are read, use them */
+ //     }
+ //     Task interior(Scheduler& scheduler)
+ //     {
+ //         for( ... ) {
+ //             /* compute a block */
+ //             co_await scheduler.yield(); // let the scheduler progress the communication
+ //         }
+ //     }
+ //     ...
+ //     Scheduler scheduler;
+ //     Channel channel(scheduler);
+ //     scheduler.spawn( step(scheduler, channel, mh) );
+ //     scheduler.spawn( interior(scheduler) );
+ //     scheduler.run();
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        struct promise_type
+        {
+            std::exception_ptr exception_;
+
+            Task get_return_object() { return Task( std::coroutine_handle<promise_type>::from_promise(*this) ); }
+         // The coroutine does not start before the Scheduler resumes it, and is destroyed by the Scheduler.
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { exception_ = std::current_exception(); }
+        };
+
+        Task(Task&& other) : handle_(other.handle_) { other.handle_ = nullptr; }
+        ~Task() { if( handle_ ) handle_.destroy(); }
+
+    private:
+        friend class Scheduler;
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+        Task(Task const&); // prevent object copy
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+ //------------------------------------------------------------------------------------------------
+    class Scheduler
+ // Runs coroutines (Tasks) on the calling thread, in the order they become ready. Coroutines awaiting
+ // an exchange (see Channel::exchange()) become ready when the exchange is complete. The Scheduler
+ // progresses the exchanges in between resuming coroutines. When no coroutine is ready, it waits for
+ // the oldest exchange.
+ // The exchanges are collective operations: all ranks must start them in the same order, i.e. spawn
+ // the same coroutines in the same order.
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        ~Scheduler();
+
+     // Add a coroutine, it is started by run().
+        void spawn(Task task);
+
+     // Run until all coroutines are finished. If a coroutine threw an exception, the first one is
+     // rethrown here (after all coroutines are finished).
+        void run();
+
+     // Awaitable: suspend the calling coroutine, and put it at the end of the ready queue.
+        struct Yield
+        {
+            Scheduler& scheduler_;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { scheduler_.ready_.push_back(handle); }
+            void await_resume() const noexcept {}
+        };
+        inline Yield yield() { return Yield{*this}; }
+
+     // number of coroutines that are not finished
+        inline size_t nTasks() const { return tasks_.size(); }
+
+    private:
+        friend class Channel;
+     // Register a coroutine that awaits the exchange of messageBuffer (which is started).
+        void await_(MessageBuffer& messageBuffer, std::coroutine_handle<> handle);
+     // Make the coroutines of the complete exchanges ready. If wait, wait for the oldest exchange.
+        void progress_(bool wait);
+
+        struct Exchange
+        {
+            MessageBuffer*          messageBuffer;
+            std::coroutine_handle<> handle;
+        };
+        std::deque<std::coroutine_handle<>> ready_;
+        std::deque<Exchange>                exchanges_;
+        std::vector<std::coroutine_handle<Task::promise_type>> tasks_;
+    };
+
+ //------------------------------------------------------------------------------------------------
+    class Channel
+ // The exchanges of a MessageBuffer, as awaitables for coroutines run by a Scheduler.
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        Channel
+          ( Scheduler& scheduler
+          , MessageBuffer& messageBuffer = theMessageBuffer
+          );
+
+     // Awaitable: start the exchange of the messages posted in the MessageBuffer, and suspend the
+     // calling coroutine until it is complete. On resumption, the messages have been read (by 
+     // MessageBuffer::readMessages()) and the MessageBuffer is cleared.
+        struct Exchange
+        {
+            Channel& channel_;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle);
+            void await_resume() const noexcept {}
+        };
+        inline Exchange exchange() { return Exchange{*this}; }
+
+        inline MessageBuffer& messageBuffer() { return messageBuffer_; }
+
+    private:
+        Scheduler&     scheduler_;
+        MessageBuffer& messageBuffer_;
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // COROUTINE_H
@@ -0,0 +1,273 @@
+#include "Encoding.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+namespace mpi12s
+{
+ //-------------------------------------------------------------------------------------------------
+ // Implementation of struct Encoding
+ //-------------------------------------------------------------------------------------------------
+    Encoding
+    Encoding::
+    float16()
+    {
+        Encoding encoding;
+        encoding.kind = FLOAT16;
+        encoding.bits = 16;
+        std::fill( encoding.lower, encoding.lower + MAX_COMPONENTS, 0.0 );
+        std::fill( encoding.upper, encoding.upper + MAX_COMPONENTS, 0.0 );
+        return encoding;
+    }
+
+    Encoding
+    Encoding::
+    fixedPoint(size_t bits, double lower, double upper)
+    {
+        Encoding encoding;
+        encoding.kind = FIXED_POINT;
+        encoding.bits = bits;
+        std::fill( encoding.lower, encoding.lower + MAX_COMPONENTS, lower );
+        std::fill( encoding.upper, encoding.upper + MAX_COMPONENTS, upper );
+        encoding.validate();
+        return encoding;
+    }
+
+    void
+    Encoding::
+    validate() const
+    {
+        if( kind == FLOAT16 && bits == 16 )
+            return;
+        if( kind == FIXED_POINT ) {
+            if( bits < 1 || bits > 32 ) {
+                std::string errmsg = ::mpi12s::info + "Encoding::validate() : FIXED_POINT bits must be in [1,32].";
+                throw std::runtime_error(errmsg);
+            }
+            for( size_t c = 0; c < MAX_COMPONENTS; ++c ) {
+                if( !( lower[c] < upper[c] ) ) {
+                    std::string errmsg = ::mpi12s::info + "Encoding::validate() : FIXED_POINT requires lower < upper.";
+                    throw std::runtime_error(errmsg);
+                }
+            }
+            return;
+        }
+        std::string errmsg = ::mpi12s::info + "Encoding::validate() : invalid encoding.";
+        throw std::runtime_error(errmsg);
+    }
+
+    size_t
+    Encoding::
+    bytesPerComponent() const
+    {
+        if( kind == FLOAT16 )
+            return 2;
+        return ( bits <= 8 ? 1 : bits <= 16 ? 2 : 4 );
+    }
+
+    double
+    Encoding::
+    errorBound(size_t c) const
+    {
+        if( kind == FLOAT16 )
+            return std::ldexp(1.0, -11);
+        return 0.5*( upper[c] - lower[c] )/( std::ldexp(1.0, int(bits)) - 1 );
+    }
+
+    std::string
+    Encoding::
+    toStr() const
+    {
+        std::stringstream ss;
+        if( kind == FLOAT16 )
+            ss<<"FLOAT16";
+        else {
+            ss<<"FIXED_POINT(bits="<<bits<<", [";
+            for( size_t c = 0; c < MAX_COMPONENTS; ++c )
+                ss<<(c ? ", " : "")<<lower[c];
+            ss<<"], [";
+            for( size_t c = 0; c < MAX_COMPONENTS; ++c )
+                ss<<(c ? ", " : "")<<upper[c];
+            ss<<"])";
+        }
+        return ss.str();
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // The encoding kernels. The elements are processed in chunks which are converted in a local buffer,
+ // so that the loops work on aligned data, with the number of components known at compile time,
+ // and vectorise. The chunk is then copied to or from the (unaligned) message buffer.
+ //-------------------------------------------------------------------------------------------------
+    namespace encoding
+    {
+        namespace
+        {
+            enum { CHUNK = 256 }; // elements per chunk
+
+         // Quantise n elements of NC components: word = round( (x - lower)*scale ), clamped to [0,qmax].
+         // Real is the floating point type of the computation.
+            template<typename Word, typename Real, int NC, typename Scalar>
+            void quantise(void* dst, Scalar const* src, size_t n, Encoding const& encoding)
+            {
+                Real lower[NC], scale[NC];
+                Real const qmax = Real( std::ldexp(1.0, int(encoding.bits)) - 1 );
+                for( int c = 0; c < NC; ++c ) {
+                    lower[c] = Real(encoding.lower[c]);
+                    scale[c] = Real( qmax/( encoding.upper[c] - encoding.lower[c] ) );
+                }
+                alignas(64) Word words[CHUNK*NC];
+                char* d = static_cast<char*>(dst);
+                for( size_t begin = 0; begin < n; begin += CHUNK )
+                {
+                    size_t m = std::min<size_t>(CHUNK, n - begin);
+                    Scalar const* s = src + begin*NC;
+                    for( size_t i = 0; i < m; ++i )
+                        for( int c = 0; c < NC; ++c ) {
+                            Real q = ( Real(s[i*NC + c]) - lower[c] )*scale[c];
+                            q = ( q > 0    ? q : Real(0) ); // also maps nan to 0
+                            q = ( q < qmax ? q : qmax );
+                            words[i*NC + c] = Word( q + Real(0.5) );
+                        }
+                    memcpy( d, words, m*NC*sizeof(Word) );
+                    d += m*NC*sizeof(Word);
+                }
+            }
+
+            template<typename Word, typename Real, int NC, typename Scalar>
+            void dequantise(Scalar* dst, void const* src, size_t n, Encoding const& encoding)
+            {
+                Real lower[NC], step[NC];
+                Real const qmax = Real( std::ldexp(1.0, int(encoding.bits)) - 1 );
+                for( int c = 0; c < NC; ++c ) {
+                    lower[c] = Real(encoding.lower[c]);
+                    step [c] = Real( ( encoding.upper[c] - encoding.lower[c] )/qmax );
+                }
+                alignas(64) Word words[CHUNK*NC];
+                char const* s = static_cast<char const*>(src);
+                for( size_t begin = 0; begin < n; begin += CHUNK )
+                {
+                    size_t m = std::min<size_t>(CHUNK, n - begin);
+                    memcpy( words, s, m*NC*sizeof(Word) );
+                    s += m*NC*sizeof(Word);
+                    Scalar* d = dst + begin*NC;
+                    for( size_t i = 0; i < m; ++i )
+                        for( int c = 0; c < NC; ++c )
+                            d[i*NC + c] = Scalar( lower[c] + Real(words[i*NC + c])*step[c] );
+                }
+            }
+
+         // Select the word size. The computation is done in double for all word sizes: in float, the
+         // rounding errors of the scale and the offset would exceed errorBound() for float elements too.
+            template<int NC, typename Scalar>
+            void quantiseNC(void* dst, Scalar const* src, size_t n, Encoding const& encoding)
+            {
+                switch( encoding.bytesPerComponent() ) {
+                    case 1: quantise<uint8_t ,double,NC>(dst, src, n, encoding); break;
+                    case 2: quantise<uint16_t,double,NC>(dst, src, n, encoding); break;
+                    case 4: quantise<uint32_t,double,NC>(dst, src, n, encoding); break;
+                }
+            }
+
+            template<int NC, typename Scalar>
+            void dequantiseNC(Scalar* dst, void const* src, size_t n, Encoding const& encoding)
+            {
+                switch( encoding.bytesPerComponent() ) {
+                    case 1: dequantise<uint8_t ,double,NC>(dst, src, n, encoding); break;
+                    case 2: dequantise<uint16_t,double,NC>(dst, src, n, encoding); break;
+                    case 4: dequantise<uint32_t,double,NC>(dst, src, n, encoding); break;
+                }
+            }
+
+         // float16, nScalars scalars
+            template<typename Scalar>
+            void toHalf(void* dst, Scalar const* src, size_t nScalars)
+            {
+                alignas(64) uint16_t halfs[CHUNK];
+                alignas(64) float    floats[CHUNK];
+                char* d = static_cast<char*>(dst);
+                for( size_t begin = 0; begin < nScalars; begin += CHUNK )
+                {
+                    size_t m = std::min<size_t>(CHUNK, nScalars - begin);
+                    float const* f = reinterpret_cast<float const*>(src + begin);
+                    if constexpr(!std::is_same<Scalar,float>::value) {
+                        for( size_t i = 0; i < m; ++i )
+                            floats[i] = float(src[begin + i]);
+                        f = floats;
+                    }
+                    simd::floatToHalf( halfs, f, m );
+                    memcpy( d, halfs, m*sizeof(uint16_t) );
+                    d += m*sizeof(uint16_t);
+                }
+            }
+
+            template<typename Scalar>
+            void fromHalf(Scalar* dst, void const* src, size_t nScalars)
+            {
+                alignas(64) uint16_t halfs[CHUNK];
+                alignas(64) float    floats[CHUNK];
+                char const* s = static_cast<char const*>(src);
+                for( size_t begin = 0; begin < nScalars; begin += CHUNK )
+                {
+                    size_t m = std::min<size_t>(CHUNK, nScalars - begin);
+                    memcpy( halfs, s, m*sizeof(uint16_t) );
+                    s += m*sizeof(uint16_t);
+                    if constexpr(std::is_same<Scalar,float>::value)
+                        simd::halfToFloat( dst + begin, halfs, m );
+                    else {
+                        simd::halfToFloat( floats, halfs, m );
+                        for( size_t i = 0; i < m; ++i )
+                            dst[begin + i] = floats[i];
+                    }
+                }
+            }
+        }
+
+        template<typename Scalar>
+        void
+        encode(void* dst, Scalar const* src, size_t n, size_t nComponents, Encoding const& encoding)
+        {
+            if( encoding.kind == Encoding::FLOAT16 ) {
+                toHalf( dst, src, n*nComponents );
+                return;
+            }
+            switch(nComponents) {
+                case 1: quantiseNC<1>(dst, src, n, encoding); break;
+                case 2: quantiseNC<2>(dst, src, n, encoding); break;
+                case 3: quantiseNC<3>(dst, src, n, encoding); break;
+                case 4: quantiseNC<4>(dst, src, n, encoding); break;
+                default: {
+                    std::string errmsg = ::mpi12s::info + "encoding::encode() : too many components.";
+                    throw std::runtime_error(errmsg);
+                }
+            }
+        }
+
+        template<typename Scalar>
+        void
+        decode(Scalar* dst, void const* src, size_t n, size_t nComponents, Encoding const& encoding)
+        {
+            if( encoding.kind == Encoding::FLOAT16 ) {
+                fromHalf( dst, src, n*nComponents );
+                return;
+            }
+            switch(nComponents) {
+                case 1: dequantiseNC<1>(dst, src, n, encoding); break;
+                case 2: dequantiseNC<2>(dst, src, n, encoding); break;
+                case 3: dequantiseNC<3>(dst, src, n, encoding); break;
+                case 4: dequantiseNC<4>(dst, src, n, encoding); break;
+                default: {
+                    std::string errmsg = ::mpi12s::info + "encoding::decode() : too many components.";
+                    throw std::runtime_error(errmsg);
+                }
+            }
+        }
+
+        template void encode<float >(void*, float  const*, size_t, size_t, Encoding const&);
+        template void encode<double>(void*, double const*, size_t, size_t, Encoding const&);
+        template void decode<float >(float *, void const*, size_t, size_t, Encoding const&);
+        template void decode<double>(double*, void const*, size_t, size_t, Encoding const&);
+    }// namespace encoding
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
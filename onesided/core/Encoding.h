@@ -0,0 +1,244 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <vector>
+#include <string>
+#include "Message.h"
+
+namespace mpi12s
+{
+ //-------------------------------------------------------------------------------------------------
+    struct Encoding
+ // A lossy encoding of floating point message items (float, double, and Eigen vectors of these),
+ // e.g. for the positions and velocities of ghost particles, which need not be exact:
+ //   - FLOAT16    : IEEE 754 half precision, 2 bytes per component, relative error <= 2^-11,
+ //                  (absolute values beyond 65504 become inf),
+ //   - FIXED_POINT: bits bits per component (stored in 1, 2 or 4 bytes), uniformly quantised in
+ //                  [lower[c],upper[c]] for component c (typically the bounding box of the ghost
+ //                  region). Values outside are clamped. The absolute error is <= errorBound(c),
+ //                  plus the rounding of the decoded value to float (<= |x|*2^-24) for float items.
+ // E.g. 16 bit fixed point positions in a box:
+ //
+ //     message().push_back(pc.x, indices, Encoding::fixedPoint(16, boxLower, boxUpper), allocate);
+ //
+ // The parameters of the encoding are written in the message, so the receiving side only needs to
+ // know that the item is encoded (any Encoding will do, e.g. Encoding::float16()).
+ //-------------------------------------------------------------------------------------------------
+    {
+        enum Kind { FLOAT16 = 1, FIXED_POINT = 2 };
+        enum { MAX_COMPONENTS = 4 };
+
+        Kind   kind;
+        size_t bits;                   // bits per component
+        double lower[MAX_COMPONENTS];  // the bounds per component (FIXED_POINT only)
+        double upper[MAX_COMPONENTS];
+
+        static Encoding float16();
+     // The same bounds for all components
+        static Encoding fixedPoint(size_t bits, double lower, double upper);
+     // Bounds per component, e.g. Eigen vectors (N <= MAX_COMPONENTS)
+        template<typename V>
+        static Encoding fixedPoint(size_t bits, V const& lower, V const& upper)
+        {
+            Encoding encoding = fixedPoint(bits, 0.0, 1.0);
+            if( size_t(lower.size()) > MAX_COMPONENTS ) {
+                std::string errmsg = ::mpi12s::info + "Encoding::fixedPoint() : too many components.";
+                throw std::runtime_error(errmsg);
+            }
+            for( Eigen::Index c = 0; c < lower.size(); ++c ) {
+                encoding.lower[c] = lower[c];
+                encoding.upper[c] = upper[c];
+            }
+            encoding.validate();
+            return encoding;
+        }
+
+     // The number of bytes per component in the message
+        size_t bytesPerComponent() const;
+     // The maximum absolute error of component c (FIXED_POINT), or the maximum relative error (FLOAT16).
+     // For FIXED_POINT, this is the error of the decoded value before it is rounded to the element type.
+        double errorBound(size_t c) const;
+     // throws if the encoding is invalid.
+        void validate() const;
+
+        std::string toStr() const;
+    };
+
+    namespace encoding
+    {
+     // Scalar type and number of components of the types that can be encoded
+        template<typename T>
+        struct traits {
+            typedef T Scalar;
+            enum { nComponents = 1 };
+        };
+        template<typename S, int N>
+        struct traits<Eigen::Matrix<S,N,1,Eigen::DontAlign>> {
+            typedef S Scalar;
+            enum { nComponents = N };
+        };
+
+     // Encode the n elements of nComponents components in src to dst (n*nComponents*bytesPerComponent()
+     // bytes), and decode. Scalar is float or double.
+        template<typename Scalar>
+        void encode(void* dst, Scalar const* src, size_t n, size_t nComponents, Encoding const& encoding);
+        template<typename Scalar>
+        void decode(Scalar* dst, void const* src, size_t n, size_t nComponents, Encoding const& encoding);
+    }// namespace encoding
+
+ //-------------------------------------------------------------------------------------------------
+    template<typename T>
+    class EncodedMessageItem : public MessageItemBase
+ // A message item for a std::vector<T>, or for the elements array[indices[i]] of a std::vector<T>
+ // (as IndexedMessageItem), with a lossy encoding. T is float, double, or an Eigen vector of these.
+ // The message contains the number of elements, the encoding, and the encoded elements.
+ //-------------------------------------------------------------------------------------------------
+    {
+        typedef typename encoding::traits<T>::Scalar Scalar;
+        static size_t const nComponents = encoding::traits<T>::nComponents;
+        static_assert( std::is_same<Scalar,float>::value || std::is_same<Scalar,double>::value
+                     , "EncodedMessageItem<T> : T must be float, double, or an Eigen vector of float or double." );
+        static_assert( nComponents <= Encoding::MAX_COMPONENTS, "EncodedMessageItem<T> : too many components.");
+        static_assert( sizeof(T) == nComponents*sizeof(Scalar), "EncodedMessageItem<T> : T must be unaligned.");
+     // number of elements, kind, bits, lower bounds, upper bounds
+        enum { PREFIX_SIZE = 3*sizeof(size_t) + 2*Encoding::MAX_COMPONENTS*sizeof(double) };
+    public:
+        EncodedMessageItem
+          ( std::vector<T>& array              // the array to write, or read
+          , Encoding const& encoding
+          , std::vector<Index_t>* indices = nullptr // if not nullptr, only the elements array[indices[i]]
+          , AllocateSlots_t allocate = nullptr // provides target slots on reading (see IndexedMessageItem)
+          )
+          : array_(&array), indices_(indices), allocate_(allocate), encoding_(encoding)
+        {
+            encoding_.validate();
+        }
+
+        virtual void write(void*& ptr) const
+        {
+            size_t n = size_();
+            writePrefix_( ptr, n, encoding_ );
+            Scalar const* src = reinterpret_cast<Scalar const*>(array_->data());
+            if( indices_ )
+            {// gather the elements first, so that the encoding kernel works on contiguous elements
+                std::vector<T,DefaultInitAllocator<T>>& gathered = scratch_();
+                gathered.resize(n);
+                simd::gather( gathered.data(), array_->data(), array_->size(), sizeof(T), indices_->data(), n );
+                src = reinterpret_cast<Scalar const*>(gathered.data());
+            }
+            encoding::encode<Scalar>( ptr, src, n, nComponents, encoding_ );
+            internal::advance_void_ptr( ptr, n * nComponents * encoding_.bytesPerComponent() );
+        }
+
+        virtual void read(void*& ptr)
+        {
+            size_t n;
+            Encoding encoding;
+            readPrefix_( ptr, n, encoding );
+            if( indices_ ) {
+                provideSlots(n);
+                std::vector<T,DefaultInitAllocator<T>>& decoded = scratch_();
+                decoded.resize(n);
+                encoding::decode<Scalar>( reinterpret_cast<Scalar*>(decoded.data()), ptr, n, nComponents, encoding );
+                simd::scatter( array_->data(), array_->size(), decoded.data(), sizeof(T), indices_->data(), n );
+            } else {
+                array_->resize(n);
+                encoding::decode<Scalar>( reinterpret_cast<Scalar*>(array_->data()), ptr, n, nComponents, encoding );
+            }
+            internal::advance_void_ptr( ptr, n * nComponents * encoding.bytesPerComponent() );
+        }
+
+        virtual size_t messageSize() const {
+            return PREFIX_SIZE + size_() * nComponents * encoding_.bytesPerComponent();
+        }
+
+     // The elements are encoded (decoded) right away.
+        virtual void writeSegments(void*& ptr, CopySegments_t& /*segments*/) const { write(ptr); }
+        virtual void readSegments (void*& ptr, CopySegments_t& /*segments*/)       { read (ptr); }
+
+        virtual Lines_t debug_text() const
+        {
+            Lines_t lines;
+            lines.push_back( tostr("(size=", size_(), ", encoding=", encoding_.toStr(), ")") );
+            return lines;
+        }
+
+        virtual void provideSlots(size_t n)
+        {
+            if( !indices_ || indices_->size() == n )
+                return;
+            if( !allocate_ ) {
+                std::string errmsg = ::mpi12s::info + "EncodedMessageItem<T>::provideSlots() : wrong number of target slots, and no allocator.";
+                throw std::runtime_error(errmsg);
+            }
+            allocate_(n, *indices_);
+            if( indices_->size() != n ) {
+                std::string errmsg = ::mpi12s::info + "EncodedMessageItem<T>::provideSlots() : allocator provided the wrong number of target slots.";
+                throw std::runtime_error(errmsg);
+            }
+        }
+
+        inline Encoding const& encoding() const { return encoding_; }
+
+    private:
+        size_t size_() const { return indices_ ? indices_->size() : array_->size(); }
+
+        static void writePrefix_(void*& ptr, size_t n, Encoding const& encoding)
+        {
+            size_t header[3] = { n, size_t(encoding.kind), encoding.bits };
+            memcpy( ptr, header, sizeof(header) );
+            internal::advance_void_ptr( ptr, sizeof(header) );
+            memcpy( ptr, encoding.lower, sizeof(encoding.lower) );
+            internal::advance_void_ptr( ptr, sizeof(encoding.lower) );
+            memcpy( ptr, encoding.upper, sizeof(encoding.upper) );
+            internal::advance_void_ptr( ptr, sizeof(encoding.upper) );
+        }
+        static void readPrefix_(void*& ptr, size_t& n, Encoding& encoding)
+        {
+            size_t header[3];
+            memcpy( header, ptr, sizeof(header) );
+            internal::advance_void_ptr( ptr, sizeof(header) );
+            memcpy( encoding.lower, ptr, sizeof(encoding.lower) );
+            internal::advance_void_ptr( ptr, sizeof(encoding.lower) );
+            memcpy( encoding.upper, ptr, sizeof(encoding.upper) );
+            internal::advance_void_ptr( ptr, sizeof(encoding.upper) );
+            n = header[0];
+            encoding.kind = Encoding::Kind(header[1]);
+            encoding.bits = header[2];
+            encoding.validate();
+        }
+     // scratch space per thread, as messages may be written and read concurrently
+        static std::vector<T,DefaultInitAllocator<T>>& scratch_()
+        {
+            thread_local std::vector<T,DefaultInitAllocator<T>> buffer;
+            return buffer;
+        }
+
+        std::vector<T>* array_;
+        std::vector<Index_t>* indices_;
+        AllocateSlots_t allocate_;
+        Encoding encoding_;
+    };
+
+ //-------------------------------------------------------------------------------------------------
+ // Message::push_back with an encoding
+ //-------------------------------------------------------------------------------------------------
+    template<typename T>
+    void
+    Message::
+    push_back(std::vector<T>& array, Encoding const& encoding)
+    {
+        coll_.push_back( new EncodedMessageItem<T>(array, encoding) );
+    }
+
+    template<typename T>
+    void
+    Message::
+    push_back(std::vector<T>& array, std::vector<Index_t>& indices, Encoding const& encoding, AllocateSlots_t allocate)
+    {
+        coll_.push_back( new EncodedMessageItem<T>(array, encoding, &indices, allocate) );
+    }
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // ENCODING_H
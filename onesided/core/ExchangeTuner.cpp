@@ -0,0 +1,121 @@
+#include "ExchangeTuner.h"
+
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class ExchangeTuner
+ //------------------------------------------------------------------------------------------------
+    ExchangeTuner::
+    ExchangeTuner
+      ( size_t trialsPerCandidate
+      , double shiftFactor
+      )
+      : trialsPerCandidate_(trialsPerCandidate)
+      , shiftFactor_(shiftFactor)
+      , trial_(0)
+      , current_(0)
+      , selected_(0)
+      , tuned_(false)
+      , started_(false)
+      , refMessages_(0)
+      , refWords_(0)
+      , nTunings_(0)
+    {}
+
+    void
+    ExchangeTuner::
+    addCandidate
+      ( int id
+      , std::string const& name
+      )
+    {
+        candidates_.push_back(id);
+        names_     .push_back(name);
+        bestTime_  .push_back(std::numeric_limits<double>::max());
+        started_ = false; // the trials must be restarted
+    }
+
+    void
+    ExchangeTuner::
+    restart_(Index_t nMessages, Index_t nWords)
+    {
+        for( auto& t : bestTime_ )
+            t = std::numeric_limits<double>::max();
+        trial_ = 0;
+        tuned_ = false;
+        started_ = true;
+        refMessages_ = nMessages;
+        refWords_    = nWords;
+        ++nTunings_;
+    }
+
+    int
+    ExchangeTuner::
+    next
+      ( Index_t nMessages
+      , Index_t nWords
+      )
+    {
+        if( candidates_.empty() )
+            throw std::runtime_error("ExchangeTuner::next() : no candidates.");
+
+     // Has the traffic pattern shifted? (+1 to cope with empty exchanges)
+        auto shifted = [this](Index_t n, Index_t ref) {
+            double ratio = (n + 1.0)/(ref + 1.0);
+            return ratio > shiftFactor_ || ratio*shiftFactor_ < 1.0;
+        };
+        if( !started_ || shifted(nMessages, refMessages_) || shifted(nWords, refWords_) )
+            restart_(nMessages, nWords);
+
+        current_ = ( tuned_ ? selected_ : trial_ % candidates_.size() );
+        return candidates_[current_];
+    }
+
+    void
+    ExchangeTuner::
+    record(double seconds)
+    {
+        if( tuned_ )
+            return;
+        if( seconds < bestTime_[current_] )
+            bestTime_[current_] = seconds;
+        ++trial_;
+        if( trial_ == trialsPerCandidate_*candidates_.size() )
+        {// The trials are finished, select the fastest candidate
+            selected_ = 0;
+            for( size_t i = 1; i < candidates_.size(); ++i )
+                if( bestTime_[i] < bestTime_[selected_] )
+                    selected_ = i;
+            tuned_ = true;
+        }
+    }
+
+    std::vector<std::string> // list of lines
+    ExchangeTuner::
+    toStr() const
+    {
+        std::stringstream ss;
+        std::vector<std::string> lines;
+        lines.push_back("ExchangeTuner::toStr() :");
+        ss<<"tuned="<<tuned_<<", trial="<<trial_<<", tunings="<<nTunings_
+          <<", traffic=("<<refMessages_<<" messages, "<<refWords_<<" words)";
+        if( tuned_ )
+            ss<<", selected="<<names_[selected_];
+        lines.push_back(ss.str()); ss.str(std::string());
+        for( size_t i = 0; i < candidates_.size(); ++i ) {
+            ss<<std::setw(20)<<names_[i]<<std::setw(20);
+            if( bestTime_[i] == std::numeric_limits<double>::max() )
+                ss<<"-";
+            else
+                ss<<bestTime_[i];
+            lines.push_back(ss.str()); ss.str(std::string());
+        }
+        return lines;
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,73 @@
+#ifndef EXCHANGETUNER_H
+#define EXCHANGETUNER_H
+
+#include <vector>
+#include <string>
+#include "types.h"
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+    class ExchangeTuner
+ // Selects the fastest exchange strategy for the observed traffic pattern. During the first exchanges
+ // (the trials) the candidate strategies are used in turn, and timed. Afterwards the fastest one is 
+ // used, until the traffic pattern shifts, after which the candidates are timed again.
+ // All processes must take the same decisions. Therefore, the traffic pattern must be global (e.g.
+ // the total number of messages), and the times recorded must be identical on all processes (e.g. 
+ // the maximum over all processes).
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        ExchangeTuner
+          ( size_t trialsPerCandidate = 2 // number of exchanges that each candidate is timed
+          , double shiftFactor = 4.0      // the candidates are timed again if the number of messages or the
+                                          // payload size changes by more than this factor.
+          );
+
+     // Add a candidate strategy
+        void addCandidate
+          ( int id                 // identifies the strategy
+          , std::string const& name// name of the strategy (for reporting)
+          );
+
+     // Get the strategy to use for the next exchange.
+        int
+        next
+          ( Index_t nMessages // global number of messages of the next exchange
+          , Index_t nWords    // global payload size of the next exchange
+          );
+
+     // Record the time of the exchange using the strategy returned by the last call to next().
+        void record(double seconds);
+
+     // The decision
+        inline bool tuned   () const { return tuned_; }    // true if the trials are finished
+        inline int  selected() const { return candidates_[selected_]; } // the selected strategy, valid if tuned()
+        std::string selectedName() const { return names_[selected_]; }
+
+     // Intelligible string representation of the tuner state.
+        std::vector<std::string> // list of lines
+        toStr() const;
+
+    private:
+     // Start a new series of trials for the given traffic pattern.
+        void restart_(Index_t nMessages, Index_t nWords);
+
+        std::vector<int>         candidates_;
+        std::vector<std::string> names_;
+        std::vector<double>      bestTime_;     // the best time of every candidate in the current trials
+        size_t  trialsPerCandidate_;
+        double  shiftFactor_;
+        size_t  trial_;       // number of exchanges timed in the current trials
+        size_t  current_;     // index of the candidate returned by next()
+        size_t  selected_;    // index of the selected candidate
+        bool    tuned_;
+        bool    started_;
+        Index_t refMessages_; // the traffic pattern of the current trials
+        Index_t refWords_;
+        size_t  nTunings_;    // number of times the trials were (re)started
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // EXCHANGETUNER_H
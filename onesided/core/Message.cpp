@@ -1,5 +1,8 @@
 #include "Message.h"
 
+#include <cstring>
+#include <algorithm>
+
 namespace mpi12s
 {
  //-------------------------------------------------------------------------------------------------
@@ -39,6 +42,81 @@ namespace mpi12s
         }
     }
 
+    void
+    Message::
+    write(void*& ptr, ThreadPool& pool, size_t chunkSize) const
+    {
+        CopySegments_t segments;
+        for( MessageItemBase const* item : coll_ )
+            item->writeSegments(ptr, segments);
+        copy_(segments, pool, chunkSize);
+    }
+
+    void
+    Message::
+    read(void*& ptr, ThreadPool& pool, size_t chunkSize)
+    {
+        CopySegments_t segments;
+        for( MessageItemBase* item : coll_ )
+            item->readSegments(ptr, segments);
+        copy_(segments, pool, chunkSize);
+    }
+
+    void
+    Message::
+    copy_(CopySegments_t const& segments, ThreadPool& pool, size_t chunkSize)
+    {// Cut the segments in chunks of at most chunkSize bytes, and group consecutive small ones,
+     // so that every task copies about chunkSize bytes.
+        ThreadPool::TaskGroup group;
+        CopySegments_t task;
+        size_t taskBytes = 0;
+        size_t nTasks = 0;
+        auto submit = [&]()
+        {
+            if( task.empty() )
+                return;
+            ++nTasks;
+            pool.submit( group, [task]() {
+                for( CopySegment const& segment : task )
+                    copySegment_(segment);
+            });
+            task.clear();
+            taskBytes = 0;
+        };
+        size_t const threshold = simd::streamingThreshold();
+        for( CopySegment const& segment : segments )
+        {// Whether to stream is decided for the segment as a whole, not for its chunks.
+            bool stream = ( segment.nBytes >= threshold );
+            for( size_t offset = 0; offset < segment.nBytes; )
+            {
+                size_t nBytes = std::min( segment.nBytes - offset, chunkSize - taskBytes );
+                task.push_back( CopySegment{ (char*)segment.dst + offset, (char const*)segment.src + offset, nBytes, stream } );
+                taskBytes += nBytes;
+                offset += nBytes;
+                if( taskBytes == chunkSize )
+                    submit();
+            }
+        }
+        if( nTasks == 0 )
+        {// everything fits in a single task: just do it
+            for( CopySegment const& segment : task )
+                copySegment_(segment);
+        } else {
+            submit();
+            pool.wait(group);
+        }
+    }
+
+    void
+    Message::
+    copySegment_(CopySegment const& segment)
+    {
+        if( segment.stream )
+            simd::streamCopy( segment.dst, segment.src, segment.nBytes );
+        else
+            memcpy( segment.dst, segment.src, segment.nBytes );
+    }
+
     size_t
     Message::
     messageSize() const
@@ -52,6 +130,14 @@ namespace mpi12s
         return sz;
     }
 
+    void
+    Message::
+    setPeer(int peer) const
+    {
+        for( MessageItemBase const* item : coll_ )
+            item->setPeer(peer);
+    }
+
     ::mpi12s::Lines_t
     Message::
     debug_text() const
@@ -68,5 +154,72 @@ namespace mpi12s
         }
         return lines;
     }
+ //-------------------------------------------------------------------------------------------------
+    size_t
+    Message::
+    indexedElementSize() const
+    {
+        size_t elementSize = 0;
+        std::vector<Index_t>* indices = coll_.empty() ? nullptr : coll_[0]->indices();
+        for( MessageItemBase const* item : coll_ ) {
+            if( !item->indices() || item->indices() != indices ) {
+                std::string errmsg = ::mpi12s::info + "Message::indexedElementSize() : the message does not support zero-copy: "
+                                     "all items must refer to indexed elements, with the same indices.";
+                throw std::runtime_error(errmsg);
+            }
+            elementSize += item->indexedElementSize();
+        }
+        if( elementSize == 0 ) {
+            std::string errmsg = ::mpi12s::info + "Message::indexedElementSize() : empty message.";
+            throw std::runtime_error(errmsg);
+        }
+        return elementSize;
+    }
+
+    size_t
+    Message::
+    sendBlocks(IndexedBlocks_t& blocks) const
+    {
+        size_t elementSize = indexedElementSize();
+        for( MessageItemBase const* item : coll_ )
+            item->indexedBlocks(blocks);
+        return coll_[0]->indices()->size() * elementSize;
+    }
+
+    void
+    Message::
+    provideSlots(std::vector<size_t> const& nBytes)
+    {
+        size_t elementSize = indexedElementSize();
+        size_t n = 0;
+        for( size_t nb : nBytes )
+            n += nb / elementSize;
+     // new target slots
+        coll_[0]->indices()->clear();
+        for( MessageItemBase* item : coll_ )
+            item->provideSlots(n);
+    }
+
+    void
+    Message::
+    receiveBlocks(std::vector<size_t> const& nBytes, std::vector<IndexedBlocks_t>& blocks) const
+    {
+        size_t elementSize = indexedElementSize();
+        IndexedBlocks_t all;
+        for( MessageItemBase const* item : coll_ )
+            item->indexedBlocks(all);
+        blocks.assign( nBytes.size(), IndexedBlocks_t() );
+        size_t first = 0;
+        for( size_t m = 0; m < nBytes.size(); ++m )
+        {// the slots of message m
+            size_t n = nBytes[m] / elementSize;
+            for( IndexedBlock block : all ) {
+                block.indices += first;
+                block.n = n;
+                blocks[m].push_back(block);
+            }
+            first += n;
+        }
+    }
  //-------------------------------------------------------------------------------------------------
 }// namespace mpi12s
\ No newline at end of file
@@ -2,9 +2,17 @@
 #define MESSAGE_H
 
 #include "memcpy_able.h"
+#include "ThreadPool.h"
+#include "SimdKernels.h"
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <tuple>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
 
 namespace mpi12s
 {// Although nothing in this file uses MPI, it is necessary machinery for the MPI messageing 
@@ -22,6 +30,42 @@ namespace mpi12s
     }
 
  
+ //-------------------------------------------------------------------------------------------------
+ // A copy from src to dst of nBytes bytes. Packing and unpacking a message amounts to a list of copies
+ // which can be split in chunks, and executed in parallel. 
+    struct CopySegment
+    {
+        void*       dst;
+        void const* src;
+        size_t      nBytes;
+        bool        stream = false; // use streaming stores (set for the chunks of large segments, see simd::copy())
+    };
+    typedef std::vector<CopySegment> CopySegments_t;
+
+    namespace internal
+    {// Write t to os for debugging, if T has an operator<<, and its size otherwise.
+        template<typename T>
+        void printTo(std::ostream& os, T const& t)
+        {
+            if constexpr( requires(std::ostream& o, T const& x) { o<<x; } )
+                os<<t;
+            else
+                os<<'<'<<sizeof(T)<<" bytes>";
+        }
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // The elements array[indices[i]] of an array of elements of elementSize bytes. Zero-copy messages 
+ // are described by a list of IndexedBlocks (see MessageHandlerBase::postZeroCopyMessage()).
+    struct IndexedBlock
+    {
+        void const*    array;
+        size_t         elementSize;
+        Index_t const* indices;
+        size_t         n;          // the number of indices
+    };
+    typedef std::vector<IndexedBlock> IndexedBlocks_t;
+
  //-------------------------------------------------------------------------------------------------
     class MessageItemBase
  //-------------------------------------------------------------------------------------------------
@@ -34,8 +78,29 @@ namespace mpi12s
         virtual void read (void*& ptr)       = 0;
     // get the size of the message item (in bytes)
         virtual size_t messageSize() const = 0;
+    // write the prefix of the message item to ptr, and append the copy of its data to segments. On return
+    // ptr is advanced past the message item, as in write().
+        virtual void writeSegments(void*& ptr, CopySegments_t& segments) const = 0;
+    // read the prefix of the message item from ptr (resizing the item), and append the copy of its data to
+    // segments. On return ptr is advanced past the message item, as in read().
+        virtual void readSegments (void*& ptr, CopySegments_t& segments) = 0;
     // convert the message item to an intelligible list of strings (for debugging and testing mainly)
         virtual Lines_t debug_text() const = 0;
+
+    // Zero-copy messages are only supported by items referring to elements array[indices[i]].
+    // The indices of the item, or nullptr if the item does not support zero-copy messages.
+        virtual std::vector<Index_t>* indices() const { return nullptr; }
+    // The number of bytes per index.
+        virtual size_t indexedElementSize() const { return 0; }
+    // Make sure that there are n target slots (for receiving).
+        virtual void provideSlots(size_t /*n*/) {}
+    // Append the IndexedBlocks of the item to blocks.
+        virtual void indexedBlocks(IndexedBlocks_t& /*blocks*/) const {}
+
+    // The rank the message is about to be written for (before messageSize() and write()), or read from
+    // (before read()), or a negative value if unknown. Items that keep state per peer (e.g. PropertySet
+    // with change tracking) store it in the object they refer to.
+        virtual void setPeer(int /*peer*/) const {}
     };
 
  //-------------------------------------------------------------------------------------------------
@@ -73,6 +138,32 @@ namespace mpi12s
             return ::mpi12s::messageSize(*ptrT_);
         }
 
+        virtual void writeSegments(void*& ptr, CopySegments_t& segments) const {
+            if constexpr(!internal::contiguous_memcpy_able<T>::value) {
+                write(ptr); // the data are not contiguous, they are written right away.
+                return;
+            }
+            typedef internal::memcpy_traits<T> traits;
+            traits::writePrefix( *ptrT_, ptr );
+            internal::advance_void_ptr( ptr, traits::prefixSize() );
+            size_t nBytes = traits::dataSize(*ptrT_);
+            segments.push_back( CopySegment{ptr, traits::data(*ptrT_), nBytes} );
+            internal::advance_void_ptr( ptr, nBytes );
+        }
+
+        virtual void readSegments(void*& ptr, CopySegments_t& segments) {
+            if constexpr(!internal::contiguous_memcpy_able<T>::value) {
+                read(ptr);
+                return;
+            }
+            typedef internal::memcpy_traits<T> traits;
+            traits::readPrefix( *ptrT_, ptr );
+            internal::advance_void_ptr( ptr, traits::prefixSize() );
+            size_t nBytes = traits::dataSize(*ptrT_);
+            segments.push_back( CopySegment{traits::data(*ptrT_), ptr, nBytes} );
+            internal::advance_void_ptr( ptr, nBytes );
+        }
+
      // Content of the message
         virtual
         Lines_t // return a list of lines.
@@ -81,7 +172,9 @@ namespace mpi12s
             Lines_t lines;
             std::stringstream ss;
             if constexpr(internal::fixed_size_memcpy_able<T>::value) {
-                ss<<'['<<*ptrT_<<']';
+                ss<<'[';
+                internal::printTo(ss, *ptrT_);
+                ss<<']';
                 lines.push_back(ss.str());
             }
             else if constexpr(internal::variable_size_memcpy_able<T>::value) {
@@ -90,23 +183,301 @@ namespace mpi12s
                 lines.push_back(ss.str()); ss.str(std::string());
                 for( size_t i = 0; i < sz ; ++i ) {
                     ss<<std::setw(10)<<i
-                      <<std::setw(20)<<(*ptrT_)[i];
+                      <<std::setw(20);
+                    internal::printTo(ss, (*ptrT_)[i]);
                     lines.push_back(ss.str()); ss.str(std::string());
                 }   ss<<']';
                 lines.push_back(ss.str()); ss.str(std::string());
             }
+            else if constexpr(internal::ragged_memcpy_able<T>::value) {
+                ss<<"(rows="<<ptrT_->size()<<", elements="<<internal::ragged_traits<T>::nElements(*ptrT_)<<")";
+                lines.push_back(ss.str());
+            }
+            else if constexpr(internal::aggregate_memcpy_able<T>::value) {
+                ss<<"(fields="<<reflection::fieldCount<T>()<<", bytes="<<::mpi12s::messageSize(*ptrT_)<<")";
+                lines.push_back(ss.str());
+            }
+            else if constexpr(internal::column_memcpy_able<T>::value) {
+                ss<<"(size="<<ptrT_->size()<<", columns="<<reflection::fieldCount<typename T::value_type>()<<")";
+                lines.push_back(ss.str());
+            }
             else 
-                static_assert
-                  ( internal::   fixed_size_memcpy_able<T>::value ||
-                    internal::variable_size_memcpy_able<T>::value
-                  , "T is not memcpy-able."
-                  );
+                static_assert( internal::memcpy_able<T>::value, "T is not memcpy-able." );
             return lines;
         }
     private:
         T* ptrT_;
     };
 
+ //-------------------------------------------------------------------------------------------------
+ // Provide n target slots in indices, for reading an IndexedMessageItem (e.g. by adding n elements
+ // to a particle container).
+    typedef std::function<void(size_t n, std::vector<Index_t>& indices)> AllocateSlots_t;
+
+    class PropertySet; // forward declaration, see PropertySet.h
+    struct Encoding;   // forward declaration, see Encoding.h
+
+ //-------------------------------------------------------------------------------------------------
+    template <typename T>
+    class IndexedMessageItem : public MessageItemBase
+ // A message item for the elements array[indices[i]] of an array, typically a property of a
+ // structure of arrays. Writing gathers the elements directly into the message buffer, reading
+ // scatters them directly into the elements array[indices[i]]. There are no intermediate copies.
+ // In the message buffer it looks exactly like a std::vector<T> with the selected elements, so
+ // either side can also use a std::vector<T>.
+ // On reading, if the number of indices differs from the number of elements in the message, the
+ // target slots are obtained from allocate(n, indices). Several items may share the same indices
+ // (e.g. all properties of the same particles), then only the first one calls allocate. Clear
+ // indices before reading a message to obtain new target slots.
+ //-------------------------------------------------------------------------------------------------
+    {
+        static const bool _debug_ = true; // write debug output or not
+        static_assert(internal::fixed_size_memcpy_able<T>::value, "T is not fixed size memcpy-able.");
+    public:
+        IndexedMessageItem
+          ( std::vector<T>& array             // the array to gather from, or scatter to
+          , std::vector<Index_t>& indices     // the indices of the elements of array in the message
+          , AllocateSlots_t allocate = nullptr // provides target slots on reading
+          )
+          : array_(&array), indices_(&indices), allocate_(allocate)
+        {}
+
+        virtual void write(void*& ptr) const {
+            if constexpr(::mpi12s::_debug_ && _debug_) {
+                prdbg( tostr("IndexedMessageItem<T=", typeid(T).name(), ">::write()"), this->debug_text() );
+            }
+            size_t n = indices_->size();
+            memcpy( ptr, &n, sizeof(size_t) );
+            internal::advance_void_ptr( ptr, sizeof(size_t) );
+            gather_(ptr);
+            internal::advance_void_ptr( ptr, n * sizeof(T) );
+        }
+
+        virtual void read(void*& ptr) {
+            size_t n = readCount_(ptr);
+            scatter_(ptr);
+            internal::advance_void_ptr( ptr, n * sizeof(T) );
+            if constexpr(::mpi12s::_debug_ && _debug_) {
+                prdbg( tostr("IndexedMessageItem<T=", typeid(T).name(), ">::read()"), this->debug_text() );
+            }
+        }
+
+        virtual size_t messageSize() const {
+            return sizeof(size_t) + indices_->size() * sizeof(T);
+        }
+
+     // The elements are not contiguous, so they are gathered (scattered) right away, rather than
+     // appended to segments as a single copy.
+        virtual void writeSegments(void*& ptr, CopySegments_t& /*segments*/) const {
+            write(ptr);
+        }
+
+        virtual void readSegments(void*& ptr, CopySegments_t& /*segments*/) {
+            read(ptr);
+        }
+
+        virtual std::vector<Index_t>* indices() const { return indices_; }
+        virtual size_t indexedElementSize() const { return sizeof(T); }
+        virtual void provideSlots(size_t n)
+        {
+            if( indices_->size() == n )
+                return;
+            if( !allocate_ ) {
+                std::string errmsg = ::mpi12s::info + "IndexedMessageItem::provideSlots() : wrong number of target slots, and no allocator.";
+                throw std::runtime_error(errmsg);
+            }
+            allocate_(n, *indices_);
+            if( indices_->size() != n ) {
+                std::string errmsg = ::mpi12s::info + "IndexedMessageItem::provideSlots() : allocator provided the wrong number of target slots.";
+                throw std::runtime_error(errmsg);
+            }
+        }
+        virtual void indexedBlocks(IndexedBlocks_t& blocks) const {
+            blocks.push_back( IndexedBlock{array_->data(), sizeof(T), indices_->data(), indices_->size()} );
+        }
+
+        virtual
+        Lines_t // return a list of lines.
+        debug_text() const
+        {
+            Lines_t lines;
+            std::stringstream ss;
+            size_t sz = indices_->size();
+            ss<<"(size="<<sz<<", indexed) [";
+            lines.push_back(ss.str()); ss.str(std::string());
+            for( size_t i = 0; i < sz ; ++i ) {
+                ss<<std::setw(10)<<(*indices_)[i]
+                  <<std::setw(20)<<(*array_)[(*indices_)[i]];
+                lines.push_back(ss.str()); ss.str(std::string());
+            }   ss<<']';
+            lines.push_back(ss.str());
+            return lines;
+        }
+
+    private:
+     // Read the number of elements in the message, and make sure that there are as many target slots.
+        size_t readCount_(void*& ptr)
+        {
+            size_t n;
+            memcpy( &n, ptr, sizeof(size_t) );
+            internal::advance_void_ptr( ptr, sizeof(size_t) );
+            provideSlots(n);
+            return n;
+        }
+
+        void gather_(void* ptr) const
+        {
+            simd::gather( ptr, array_->data(), array_->size(), sizeof(T), indices_->data(), indices_->size() );
+        }
+
+        void scatter_(void const* ptr)
+        {
+            simd::scatter( array_->data(), array_->size(), ptr, sizeof(T), indices_->data(), indices_->size() );
+        }
+
+        std::vector<T>* array_;
+        std::vector<Index_t>* indices_;
+        AllocateSlots_t allocate_;
+    };
+
+ //-------------------------------------------------------------------------------------------------
+    template<typename T>
+    class MessageView
+ // A read-only view of the elements of a std::vector<T> in a received message, i.e. directly in the
+ // memory of the message buffer, as opposed to copying them into a std::vector<T>:
+ //
+ //     MessageView<double> r;
+ //     message().push_back(r);       // in the MessageHandler's constructor
+ //     ...
+ //     for( size_t i = 0; i < r.size(); ++i ) // after reading a message
+ //         sum += r[i];
+ //
+ // The view is valid until the message buffer is cleared (i.e. until the next exchange). The elements
+ // are not necessarily aligned in the message buffer (that depends on the preceding message items),
+ // hence operator[] returns a copy of the element, which for aligned elements compiles to a plain
+ // load. Use span() to access the elements through a pointer, which requires aligned elements.
+ // Elements that must outlive the message can be appended to a std::vector<T> with appendTo().
+ // Writing a MessageView writes the viewed elements, so a received std::vector<T> can be forwarded.
+ //-------------------------------------------------------------------------------------------------
+    {
+        static_assert(internal::fixed_size_memcpy_able<T>::value, "T is not fixed size memcpy-able.");
+    public:
+        MessageView() : data_(nullptr), size_(0) {}
+        MessageView(void const* data, size_t size) : data_(static_cast<char const*>(data)), size_(size) {}
+
+        inline size_t size() const { return size_; }
+        inline bool empty() const { return size_ == 0; }
+     // pointer to the first element in the message buffer
+        inline void const* data() const { return data_; }
+
+        inline T operator[](size_t i) const
+        {
+            T t;
+            memcpy( &t, data_ + i*sizeof(T), sizeof(T) ); // size known at compile time
+            return t;
+        }
+
+     // Are the elements aligned for T? (Always true for an empty view.)
+        inline bool isAligned() const {
+            return reinterpret_cast<uintptr_t>(data_) % alignof(T) == 0;
+        }
+     // The elements as a std::span (throws if the elements are not aligned).
+        std::span<T const> span() const
+        {
+            if( !isAligned() ) {
+                std::string errmsg = ::mpi12s::info + "MessageView<T>::span() : elements are not aligned.";
+                throw std::runtime_error(errmsg);
+            }
+            return std::span<T const>( reinterpret_cast<T const*>(data_), size_ );
+        }
+
+     // Append the elements to v. Only the appended elements are written, they are not
+     // value-initialised first, as with resize().
+        template<typename A>
+        void appendTo(std::vector<T,A>& v) const
+        {
+            size_t n = v.size();
+            if constexpr(std::is_same<A,DefaultInitAllocator<T>>::value) {
+                v.resize( n + size_ ); // default-initialisation, no zeroing
+                memcpy( v.data() + n, data_, size_*sizeof(T) );
+            } else if( isAligned() ) {
+                std::span<T const> s = span();
+                v.insert( v.end(), s.begin(), s.end() );
+            } else {
+                v.reserve( n + size_ );
+                for( size_t i = 0; i < size_; ++i )
+                    v.push_back( (*this)[i] );
+            }
+        }
+    private:
+        char const* data_;
+        size_t size_;
+    };
+
+    namespace internal
+    {// A MessageView is trivially copyable, but it is not the view that goes into a message.
+        template<typename T>
+        struct fixed_size_memcpy_able<MessageView<T>> : std::false_type {};
+    }
+
+ //-------------------------------------------------------------------------------------------------
+    template <typename T>
+    class ViewMessageItem : public MessageItemBase
+ // A message item for a MessageView<T>. In the message buffer it looks exactly like a std::vector<T>,
+ // so either side can also use a std::vector<T>. Reading sets the view, nothing is copied.
+ //-------------------------------------------------------------------------------------------------
+    {
+    public:
+        ViewMessageItem(MessageView<T>& view) : view_(&view) {}
+
+        virtual void write(void*& ptr) const {
+            size_t n = view_->size();
+            memcpy( ptr, &n, sizeof(size_t) );
+            internal::advance_void_ptr( ptr, sizeof(size_t) );
+            simd::copy( ptr, view_->data(), n * sizeof(T) );
+            internal::advance_void_ptr( ptr, n * sizeof(T) );
+        }
+
+        virtual void read(void*& ptr) {
+            size_t n;
+            memcpy( &n, ptr, sizeof(size_t) );
+            internal::advance_void_ptr( ptr, sizeof(size_t) );
+            *view_ = MessageView<T>(ptr, n);
+            internal::advance_void_ptr( ptr, n * sizeof(T) );
+        }
+
+        virtual size_t messageSize() const {
+            return sizeof(size_t) + view_->size() * sizeof(T);
+        }
+
+        virtual void writeSegments(void*& ptr, CopySegments_t& segments) const {
+            size_t n = view_->size();
+            memcpy( ptr, &n, sizeof(size_t) );
+            internal::advance_void_ptr( ptr, sizeof(size_t) );
+            segments.push_back( CopySegment{ptr, view_->data(), n * sizeof(T)} );
+            internal::advance_void_ptr( ptr, n * sizeof(T) );
+        }
+     // There is nothing to copy.
+        virtual void readSegments(void*& ptr, CopySegments_t& /*segments*/) { read(ptr); }
+
+        virtual Lines_t debug_text() const
+        {
+            Lines_t lines;
+            std::stringstream ss;
+            ss<<"(view, size="<<view_->size()<<") [";
+            lines.push_back(ss.str()); ss.str(std::string());
+            for( size_t i = 0; i < view_->size(); ++i ) {
+                ss<<std::setw(10)<<i
+                  <<std::setw(20)<<(*view_)[i];
+                lines.push_back(ss.str()); ss.str(std::string());
+            }   ss<<']';
+            lines.push_back(ss.str());
+            return lines;
+        }
+    private:
+        MessageView<T>* view_;
+    };
+
  //-------------------------------------------------------------------------------------------------
     class Message
  //-------------------------------------------------------------------------------------------------
@@ -123,21 +494,207 @@ namespace mpi12s
             coll_.push_back(p);
         }
 
+    // Add a view of a std::vector<T> in the message buffer to the message (see MessageView).
+        template<typename T>
+        void push_back(MessageView<T>& view)
+        {
+            ViewMessageItem<T>* p = new ViewMessageItem<T>(view);
+            coll_.push_back(p);
+        }
+
+    // Add the elements array[indices[i]] to the message, without copying them to a separate
+    // container (see IndexedMessageItem).
+        template<typename T>
+        void push_back
+          ( std::vector<T>& array             // the array to gather from, or scatter to
+          , std::vector<Index_t>& indices     // the indices of the elements of array in the message
+          , AllocateSlots_t allocate = nullptr // provides target slots on reading
+          )
+        {
+            IndexedMessageItem<T>* p = new IndexedMessageItem<T>(array, indices, allocate);
+            coll_.push_back(p);
+        }
+
+    // Add a vector, or the elements array[indices[i]] of a vector, with a lossy encoding (see Encoding.h).
+    // T is float, double, or an Eigen vector of these.
+        template<typename T>
+        void push_back
+          ( std::vector<T>& array             // the array to write, or read
+          , Encoding const& encoding
+          );
+        template<typename T>
+        void push_back
+          ( std::vector<T>& array             // the array to gather from, or scatter to
+          , std::vector<Index_t>& indices     // the indices of the elements of array in the message
+          , Encoding const& encoding
+          , AllocateSlots_t allocate = nullptr // provides target slots on reading
+          );
+
+    // Add the elements with the given indices of a set of properties to the message, in the wire
+    // layout of the PropertySet (see PropertySet.h).
+        void push_back
+          ( PropertySet& properties           // the properties to gather from, or scatter to
+          , std::vector<Index_t>& indices     // the indices of the elements in the message
+          , AllocateSlots_t allocate = nullptr // provides target slots on reading
+          );
+
     // Write the message to ptr (=buffer)
         void write(void*& ptr) const;
         
     // Read the message from ptr (=buffer)
         void read (void*& ptr);
 
+    // Idem, but the copies are executed as tasks by pool: small items are grouped in a single task,
+    // large items are split in chunks of chunkSize bytes. Return when the message is written (read).
+    // May be called by a task of pool.
+        void write(void*& ptr, ThreadPool& pool, size_t chunkSize) const;
+        void read (void*& ptr, ThreadPool& pool, size_t chunkSize);
+
     // Compute the size of the message, in bytes.
         size_t messageSize() const;
 
+    // Inform the items of the rank the message is written for, or read from (see MessageItemBase::setPeer()).
+    // The MessageHandlers call this before posting (reading) a message.
+        void setPeer(int peer) const;
+
     // Construct an intelligible string with the message items:
         ::mpi12s::Lines_t debug_text() const;
 
+    // Zero-copy messages (see MessageHandlerBase::postZeroCopyMessage()). All items must support
+    // zero-copy messages and share the same indices.
+    // The number of bytes per index (throws if the message does not support zero-copy messages).
+        size_t indexedElementSize() const;
+    // The IndexedBlocks of the items, for sending the message. Returns the size of the message in bytes.
+        size_t sendBlocks(IndexedBlocks_t& blocks) const;
+    // Provide new target slots for receiving messages of nBytes[m] bytes. The slots of the messages
+    // follow each other in the indices.
+        void provideSlots(std::vector<size_t> const& nBytes);
+    // The IndexedBlocks of the items for receiving the messages of nBytes[m] bytes in the target slots
+    // provided by provideSlots(nBytes), one list of IndexedBlocks per message.
+        void receiveBlocks(std::vector<size_t> const& nBytes, std::vector<IndexedBlocks_t>& blocks) const;
+
     private:
+     // Execute the copies as tasks of pool, in chunks of about chunkSize bytes, and wait for them.
+        static void copy_(CopySegments_t const& segments, ThreadPool& pool, size_t chunkSize);
+     // Execute a single copy
+        static void copySegment_(CopySegment const& segment);
+
         std::vector<MessageItemBase*> coll_;
     };
+ //-------------------------------------------------------------------------------------------------
+    template<typename... Ts>
+    class StaticMessage
+ // A message whose items are known at compile time: a tuple of references to the items, e.g.
+ //     StaticMessage message(n, x, v); // StaticMessage<int,double,std::vector<double>>
+ // As opposed to Message, there is no heap allocation per item, and no virtual call per item. The
+ // size computation, writing and reading are unrolled at compile time. The fixed size items are
+ // copied with sizes known at compile time, so that the compiler can replace consecutive copies
+ // with plain (vector) loads and stores. The layout in the message buffer is the same as that of a
+ // Message with the same items, so a StaticMessage can be read as a Message and vice versa.
+ // Items may also be MessageViews.
+ //-------------------------------------------------------------------------------------------------
+    {
+    public:
+     // Are all items fixed size? 
+        static constexpr bool fixed_size = ( internal::fixed_size_memcpy_able<Ts>::value && ... );
+
+        explicit StaticMessage(Ts&... ts) : items_(ts...) {}
+
+     // Compute the size of the message, in bytes. 
+        size_t messageSize() const
+        {
+            if constexpr(fixed_size)
+                return fixedMessageSize();
+            else
+                return std::apply( [](Ts&... ts) { return ( itemSize_(ts) + ... ); }, items_ );
+        }
+     // The size of the message, in bytes, if all items are fixed size.
+        static constexpr size_t fixedMessageSize()
+        {
+            static_assert(fixed_size, "StaticMessage has variable size items");
+            return ( sizeof(Ts) + ... );
+        }
+
+     // Write the message to ptr (=buffer)
+        void write(void*& ptr) const
+        {
+            std::apply( [&ptr](Ts&... ts) { ( writeItem_(ts, ptr), ... ); }, items_ );
+        }
+
+     // Read the message from ptr (=buffer)
+        void read(void*& ptr)
+        {
+            std::apply( [&ptr](Ts&... ts) { ( readItem_(ts, ptr), ... ); }, items_ );
+        }
+
+     // the items
+        inline std::tuple<Ts&...> const& items() const { return items_; }
+
+    private:
+        template<typename T>
+        static size_t itemSize_(T& t)
+        {
+            if constexpr(!internal::contiguous_memcpy_able<T>::value)
+                return internal::memcpy_traits<T>::messageSize(t);
+            else
+                return internal::memcpy_traits<T>::prefixSize() + internal::memcpy_traits<T>::dataSize(t);
+        }
+        template<typename T>
+        static size_t itemSize_(MessageView<T>& view)
+        {
+            return sizeof(size_t) + view.size() * sizeof(T);
+        }
+
+        template<typename T>
+        static void writeItem_(T& t, void*& ptr)
+        {
+            if constexpr(internal::fixed_size_memcpy_able<T>::value) {
+                memcpy( ptr, &t, sizeof(T) ); // size known at compile time
+                internal::advance_void_ptr( ptr, sizeof(T) );
+            } else if constexpr(!internal::contiguous_memcpy_able<T>::value) {
+                internal::memcpy_traits<T>::write(t, ptr);
+            } else {
+                typedef internal::memcpy_traits<T> traits;
+                traits::writePrefix(t, ptr);
+                internal::advance_void_ptr( ptr, traits::prefixSize() );
+                size_t nBytes = traits::dataSize(t);
+                simd::copy( ptr, traits::data(t), nBytes );
+                internal::advance_void_ptr( ptr, nBytes );
+            }
+        }
+
+        template<typename T>
+        static void writeItem_(MessageView<T>& view, void*& ptr)
+        {
+            ViewMessageItem<T>(view).write(ptr);
+        }
+
+        template<typename T>
+        static void readItem_(T& t, void*& ptr)
+        {
+            if constexpr(internal::fixed_size_memcpy_able<T>::value) {
+                memcpy( static_cast<void*>(&t), ptr, sizeof(T) ); // size known at compile time
+                internal::advance_void_ptr( ptr, sizeof(T) );
+            } else if constexpr(!internal::contiguous_memcpy_able<T>::value) {
+                internal::memcpy_traits<T>::read(t, ptr);
+            } else {
+                typedef internal::memcpy_traits<T> traits;
+                traits::readPrefix(t, ptr);
+                internal::advance_void_ptr( ptr, traits::prefixSize() );
+                size_t nBytes = traits::dataSize(t);
+                simd::copy( traits::data(t), ptr, nBytes );
+                internal::advance_void_ptr( ptr, nBytes );
+            }
+        }
+
+        template<typename T>
+        static void readItem_(MessageView<T>& view, void*& ptr)
+        {
+            ViewMessageItem<T>(view).read(ptr);
+        }
+
+        std::tuple<Ts&...> items_;
+    };
  //-------------------------------------------------------------------------------------------------
 }// namespace mpi12s
 
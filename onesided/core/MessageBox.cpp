@@ -1,6 +1,7 @@
 #include <stdexcept>
 #include <sstream>
 #include <iomanip>
+#include <map>
 
 #include "MessageBox.h"
 #include "MessageHandler.h"
@@ -17,9 +18,13 @@ namespace mpi1s
                           // This defines the size of the header section.
       )
     {
-     // Create an MPI window and allocate memory for it
-        size_t total_size = (1 + max_msgs * ::mpi12s::MessageBuffer::HEADER_SIZE) + bufferSize ;
-                          //(headere section                                    ) + message section
+     // Create an MPI window and allocate memory for it. The window exposes the header table,
+     // followed by the payload arena, which starts at a cache line boundary.
+        size_t header_size = 1 + max_msgs * ::mpi12s::MessageBuffer::HEADER_SIZE;
+        size_t const line = ::mpi12s::MessageBuffer::CACHE_LINE/sizeof(Index_t);
+        payloadOffset_ = ( (header_size + line - 1)/line )*line;
+        size_t total_size = payloadOffset_ + bufferSize ;
+                          //(header table) + payload arena
         Index_t * pWindowBuffer = nullptr;
         
         int success =
@@ -37,7 +42,7 @@ namespace mpi1s
         }
 
      // Initialize the window buffer with the memory allocated by MPI_Win_allocate
-        windowBuffer_.initialize( pWindowBuffer, total_size, max_msgs );
+        windowBuffer_.initialize( pWindowBuffer, max_msgs, pWindowBuffer + payloadOffset_, bufferSize );
 
      // Allocate memory for reading remote headers and initialize it
         readHeaders_.initialize( 0, max_msgs );
@@ -67,33 +72,11 @@ namespace mpi1s
      // loop over all ranks, starting with the left neighbour, and moving to the right:
         int left = ::mpi12s::next_rank(-1);
         for( int i = 0; i < nranks; ++i)
-        {// Clear the readHeaders_ and readBuffer_ buffers:
-            readHeaders_.clear();
-            readBuffer_ .clear();
-
+        {
             int from_rank = (left + i) % nranks;
             if( from_rank != my_rank ) // skip my rank
             {
-                if constexpr(::mpi12s::_debug_) printf("%sMessageBox::getMessages() : from_rank==%d\n", CINFO, from_rank);
-                {   Epoch(*this, 0, "MessageBox::getHeaders_()");
-                 // copy the header section from from_rank into the readHeaders_
-                    getHeaders_(from_rank);
-                }// close the epoch
-                if constexpr(::mpi12s::_debug_) {
-                    printf("%s MessageBox::getMessages() : readHeaders_:\n", CINFO);
-//                    print_lines( readHeaders_.headersToStr() );
-                }
-             // The epoch is closed, so the header is available   
-                {// get all messages in the header which are for me
-                    Epoch(*this, 0, "for(m) { MessageBox::getMessage_(m); }");
-                    for( Index_t m = 0; m < readHeaders_.nMessages(); ++m ) {
-                        if( readHeaders_.messageDestination(m) == my_rank )
-                        {// get the message and store it in the read buffer
-                            getMessage_(m);
-                        }
-                    }
-                }// close the Epoch
-             // The epoch is closed, so the raw messages are available
+                getMessagesFrom_(from_rank);
              // read the messages (by fetching the appropriate MessageHandler)
                 for( Index_t m = 0; m < readBuffer_.nMessages(); ++m )
                     readMessage_(m);
@@ -101,6 +84,66 @@ namespace mpi1s
         }
     }
 
+    void
+    MessageBox::
+    getMessages(::mpi12s::ThreadPool& pool)
+    {
+        int const my_rank = ::mpi12s::rank;
+        int const nranks  = ::mpi12s::size;
+        int left = ::mpi12s::next_rank(-1);
+        for( int i = 0; i < nranks; ++i)
+        {
+            int from_rank = (left + i) % nranks;
+            if( from_rank != my_rank ) // skip my rank
+            {
+                getMessagesFrom_(from_rank);
+             // group the messages by MessageHandler, and read each group in a separate task
+                std::map<::mpi12s::MessageHandlerKey_t,std::vector<Index_t>> groups;
+                for( Index_t m = 0; m < readBuffer_.nMessages(); ++m )
+                    groups[readBuffer_.messageHandlerKey(m)].push_back(m);
+                for( auto& group : groups ) {
+                    std::vector<Index_t>* msgids = &group.second;
+                    pool.submit( [this,msgids]() {
+                        for( Index_t m : *msgids )
+                            readMessage_(m);
+                    });
+                }
+             // readBuffer_ is reused for the next rank
+                pool.wait();
+            }
+        }
+    }
+
+    void
+    MessageBox::
+    getMessagesFrom_(int from_rank)
+    {// Clear the readHeaders_ and readBuffer_ buffers:
+        readHeaders_.clear();
+        readBuffer_ .clear();
+
+        int const my_rank = ::mpi12s::rank;
+        if constexpr(::mpi12s::_debug_) printf("%sMessageBox::getMessages() : from_rank==%d\n", CINFO, from_rank);
+        {   Epoch(*this, 0, "MessageBox::getHeaders_()");
+         // copy the header section from from_rank into the readHeaders_
+            getHeaders_(from_rank);
+        }// close the epoch
+        if constexpr(::mpi12s::_debug_) {
+            printf("%s MessageBox::getMessages() : readHeaders_:\n", CINFO);
+//            print_lines( readHeaders_.headersToStr() );
+        }
+     // The epoch is closed, so the header is available   
+        {// get all messages in the header which are for me
+            Epoch(*this, 0, "for(m) { MessageBox::getMessage_(m); }");
+            for( Index_t m = 0; m < readHeaders_.nMessages(); ++m ) {
+                if( readHeaders_.messageDestination(m) == my_rank )
+                {// get the message and store it in the read buffer
+                    getMessage_(m);
+                }
+            }
+        }// close the Epoch
+     // The epoch is closed, so the raw messages are available
+    }
+
     void
     MessageBox::
     getHeaders_
@@ -109,7 +152,7 @@ namespace mpi1s
     {// copy the header section from from_rank into the readHeaders_
         int success =
         MPI_Get
-          ( readHeaders_.ptr()          // buffer to store the elements to get
+          ( readHeaders_.headersPtr()   // buffer to store the elements to get
           , readHeaders_.headerSize()   // size of that buffer (number of elements)
           , MPI_LONG_LONG_INT           // type of that buffer
           , from_rank                   // process rank to get from (target)
@@ -143,12 +186,13 @@ namespace mpi1s
 
         int success =
         MPI_Get
-            ( readBuffer_.messagePtr (to_msgid)      // buffer to store the elements to get
-            , readBuffer_.messageSize(to_msgid)      // size of that buffer (number of elements0
+            ( readBuffer_.messagePtr  (to_msgid)     // buffer to store the elements to get
+            , readBuffer_.messageWords(to_msgid)     // size of that buffer (number of elements)
             , MPI_LONG_LONG_INT                      // type of that buffer
             , readHeaders_.messageSource(from_msgid) // process rank to get from (target)
-            , readHeaders_.messageBegin (from_msgid) // offset in targets window
-            , readHeaders_.messageSize  (from_msgid) // number of elements to get
+            , payloadOffset_                         // offset in targets window: the payload arena follows
+              + readHeaders_.messageBegin(from_msgid)// the header table, which has the same size on all ranks.
+            , readHeaders_.messageWords(from_msgid)  // number of elements to get
             , MPI_LONG_LONG_INT                      // data type of that buffer
             , window_                                // window
             );
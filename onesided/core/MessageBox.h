@@ -33,8 +33,20 @@ namespace mpi1s
 
      // Get all messages for this rank from all other ranks 
         void getMessages();
+     // Idem, but read the messages using the threads of pool. The messages of different 
+     // MessageHandlers are read concurrently, those of the same MessageHandler in order, as they
+     // are all read into the same MessageHandler::message(). The one-sided MessageHandlers have no
+     // readConcurrency() (cf. mpi2s::MessageHandlerBase): every MessageHandler is read as SERIAL,
+     // there is no REENTRANT or EXCLUSIVE reading. Use getMessages() if a MessageHandler cannot
+     // be read concurrently with the others.
+        void getMessages(::mpi12s::ThreadPool& pool);
 
     private:
+     // Get the headers and the messages for this rank from from_rank into readBuffer_.
+        void getMessagesFrom_
+          ( int from_rank // rank to get the messages from
+          );
+
      // copy the header section from from_rank into the readHeaders_   
         void getHeaders_
           ( int from_rank // rank to get the header section from
@@ -60,6 +72,7 @@ namespace mpi1s
 
     private:
         MPI_Win  window_;
+        size_t   payloadOffset_; // offset of the payload arena in the window, in Index_t words
         ::mpi12s::MessageBuffer windowBuffer_; // its memory is allocated by MPI_Win_allocate
         ;;mpi12s::MessageBuffer readHeaders_;  // its memory is allocated by new Index_t[]
         ::mpi12s::MessageBuffer readBuffer_;   // its memory is allocated by new Index_t[]
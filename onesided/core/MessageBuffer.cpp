@@ -4,6 +4,12 @@
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <chrono>
 
 #define FILL_BUFFER
 
@@ -12,55 +18,147 @@ namespace mpi12s
  //------------------------------------------------------------------------------------------------
  // Implementation of class MessageBuffer       
  //------------------------------------------------------------------------------------------------
+    std::atomic<size_t> MessageBuffer::nextId_(0);
+
     MessageBuffer::
     MessageBuffer()
-      : pBuffer_(nullptr)
-      , bufferSize_(0)
-      , bufferOwned_(false)
+      : pHeaders_(nullptr)
+      , maxmsgs_(0)
+      , headersOwned_(false)
+      , pPayload_(nullptr)
+      , payloadSize_(0)
+      , payloadUsed_(0)
+      , payloadOwned_(false)
       , headersOnly_(false)
+      , payloadAlignment_(CACHE_LINE)
+      , arenaAlignment_(CACHE_LINE)
+      , id_(nextId_++)
+      , exchangeMode_(FLAT)
+      , lastExchangeMode_(FLAT)
+      , ranksPerNode_(0)
+      , payloadWindow_(MPI_WIN_NULL)
+      , windowBase_(nullptr)
+      , windowSize_(0)
+      , transport_(new MpiTransport)
+      , ownedTransport_(transport_)
+      , registry_(&::mpi2s::theMessageHandlerRegistry)
+      , threadPool_(nullptr)
+      , chunkSize_(DEFAULT_CHUNK_SIZE)
+      , broadcastInProgress_(false)
+      , nMessagesMine_(0)
+      , growthFactor_(1.5)
+      , shrinkAfter_(0)
+      , initialMaxmsgs_(0)
+      , initialPayloadSize_(0)
+      , hwmMessages_(0)
+      , hwmPayload_(0)
+      , quietHwmMessages_(0)
+      , quietHwmPayload_(0)
+      , quietSteps_(0)
+      , nSteps_(0)
+      , nGrowHeaders_(0)
+      , nGrowPayload_(0)
+      , nShrinks_(0)
+    {}
+
+    MessageBuffer::
+    MessageBuffer(Transport& transport)
+      : pHeaders_(nullptr)
       , maxmsgs_(0)
+      , headersOwned_(false)
+      , pPayload_(nullptr)
+      , payloadSize_(0)
+      , payloadUsed_(0)
+      , payloadOwned_(false)
+      , headersOnly_(false)
+      , payloadAlignment_(CACHE_LINE)
+      , arenaAlignment_(CACHE_LINE)
+      , id_(nextId_++)
+      , exchangeMode_(FLAT)
+      , lastExchangeMode_(FLAT)
+      , ranksPerNode_(0)
+      , payloadWindow_(MPI_WIN_NULL)
+      , windowBase_(nullptr)
+      , windowSize_(0)
+      , transport_(&transport)
+      , registry_(new ::mpi2s::MessageHandlerRegistry)
+      , ownedRegistry_(registry_)
+      , threadPool_(nullptr)
+      , chunkSize_(DEFAULT_CHUNK_SIZE)
+      , broadcastInProgress_(false)
+      , nMessagesMine_(0)
+      , growthFactor_(1.5)
+      , shrinkAfter_(0)
+      , initialMaxmsgs_(0)
+      , initialPayloadSize_(0)
+      , hwmMessages_(0)
+      , hwmPayload_(0)
+      , quietHwmMessages_(0)
+      , quietHwmPayload_(0)
+      , quietSteps_(0)
+      , nSteps_(0)
+      , nGrowHeaders_(0)
+      , nGrowPayload_(0)
+      , nShrinks_(0)
     {}
 
     MessageBuffer::
     ~MessageBuffer()
     {
         if constexpr(::mpi12s::_verbose_)
-            prdbg( tostr("~MessageBuffer(), pBuffer_=", pBuffer_, ", bufferSize_=", bufferSize_, ", bufferOwned_"
-                        , bufferOwned_, (bufferOwned_ ? " (to be deleted)." : "")
+            prdbg( tostr("~MessageBuffer(), pHeaders_=", pHeaders_, ", maxmsgs_=", maxmsgs_, ", headersOwned_="
+                        , headersOwned_, (headersOwned_ ? " (to be deleted)" : "")
+                        , ", pPayload_=", pPayload_, ", payloadSize_=", payloadSize_, ", payloadOwned_="
+                        , payloadOwned_, (payloadOwned_ ? " (to be deleted)." : "")
                         )
                  );
 
-        if( bufferOwned_ )
-            delete[] pBuffer_;
+     // The window can only be freed as long as MPI is not finalized.
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        if( !finalized && payloadWindow_ != MPI_WIN_NULL )
+            MPI_Win_free(&payloadWindow_);
+
+        if( headersOwned_ )
+            delete[] pHeaders_;
+        if( payloadOwned_ )
+            freePayload_();
     }
 
     void 
     MessageBuffer::
     initialize
-      ( size_t size     // amount to be allocated for the messages, not counting the memory for the header section
-      , size_t max_msgs // maximum number of messages that can be stored.
+      ( size_t size     // initial size of the payload arena, in Index_t words.
+      , size_t max_msgs // initial number of messages that the header table can store.
       )
     {
         headersOnly_ = (size == 0);
-        bufferSize_ = 1 + max_msgs * HEADER_SIZE + size;
-        pBuffer_ = new Index_t[bufferSize_];
-        bufferOwned_ = true;
         maxmsgs_ = max_msgs;
+        pHeaders_ = new Index_t[headerSize()];
+        headersOwned_ = true;
+        payloadSize_ = size;
+        pPayload_ = ( headersOnly_ ? nullptr : allocatePayload_(payloadSize_) );
+        arenaAlignment_ = payloadAlignment_;
+        payloadOwned_ = true;
         initialize_();
     }
 
     void
     MessageBuffer::
     initialize
-      ( Index_t * pBuffer // pointer to pre-allocated memory
-      , size_t size       // amount of pre-allocated memory 
-      , size_t max_msgs   // maximum number of messages that can be stored.
+      ( Index_t * pHeaders // pointer to pre-allocated memory for the header table
+      , size_t max_msgs    // maximum number of messages that can be stored.
+      , Index_t * pPayload // pointer to pre-allocated memory for the payload arena
+      , size_t size        // size of the payload arena, in Index_t words.
       )
-    {
-        pBuffer_ = pBuffer;
-        bufferSize_ = size;
-        bufferOwned_ = false; // buffer is owned by whoever allocated it (typeically MPI_Win_alloc)
+    {// The memory is owned by whoever allocated it (typically MPI_Win_allocate)
+        headersOnly_ = (size == 0);
         maxmsgs_ = max_msgs;
+        pHeaders_ = pHeaders;
+        headersOwned_ = false;
+        payloadSize_ = size;
+        pPayload_ = pPayload;
+        payloadOwned_ = false;
         initialize_();
     }
 
@@ -68,19 +166,191 @@ namespace mpi12s
     MessageBuffer::
     initialize_()
     {
-        pBuffer_[0] = 0; // initially, there are no messages.
-        setMessageBegin( 0, 1 + HEADER_SIZE * maxmsgs_ ); // Begin of the first message, and the size of the message header section.
+        pHeaders_[0] = 0; // initially, there are no messages.
+        payloadUsed_ = 0;
+        ownerThread_ = std::this_thread::get_id();
+        initialMaxmsgs_     = maxmsgs_;
+        initialPayloadSize_ = payloadSize_;
       #ifdef FILL_BUFFER   
-        for( Index_t i = 2; i < bufferSize_; ++i ) {
-            pBuffer_[i] = -1;
+        for( Index_t i = 1; i < headerSize(); ++i ) {
+            pHeaders_[i] = -1;
+        }
+        for( Index_t i = 0; i < payloadSize(); ++i ) {
+            pPayload_[i] = -1;
         }
       #endif
-        // std::cout<<"MessageBuffer()::initialize_()"<<pBuffer_<<'/'<<bufferSize_<<'/'<<bufferOwned_<<std::endl;
     }
 
     void MessageBuffer::clear()
-    {// To clear the MessageBuffer, it suffices to set the number of messages to 0
-        pBuffer_[0] = 0;
+    {// To clear the MessageBuffer, it suffices to set the number of messages to 0, and to mark the
+     // payload arena as unused. The memory is kept for the next exchange.
+     // Clearing also ends a step, which is the moment to decide whether the memory can be shrunk.
+        zeroCopyIndices_.clear();
+        updateHighWaterMarks_();
+        ++nSteps_;
+        if( shrinkAfter_ > 0 )
+        {
+            double const f2 = growthFactor_*growthFactor_;
+            bool quiet = ( nMessages()  *f2 <= maxmsgs_
+                        && payloadUsed_ *f2 <= payloadSize_ );
+            if( quiet ) {
+                ++quietSteps_;
+                quietHwmMessages_ = std::max( quietHwmMessages_, nMessages() );
+                quietHwmPayload_  = std::max( quietHwmPayload_ , payloadUsed_ );
+            } else {
+                quietSteps_ = 0;
+                quietHwmMessages_ = 0;
+                quietHwmPayload_  = 0;
+            }
+            if( quietSteps_ >= shrinkAfter_ )
+            {// Shrink to growthFactor_ times the usage during the quiet steps, but not below the initial size.
+                size_t max_msgs = std::max( initialMaxmsgs_    , (size_t)std::ceil(quietHwmMessages_*growthFactor_) );
+                size_t size     = std::max( initialPayloadSize_, (size_t)std::ceil(quietHwmPayload_ *growthFactor_) );
+                pHeaders_[0] = 0;
+                payloadUsed_ = 0;
+                bool shrunk = false;
+                if( headersOwned_ && max_msgs < maxmsgs_ ) {
+                    reallocateHeaders_(max_msgs);
+                    shrunk = true;
+                }
+                if( payloadOwned_ && size < payloadSize_ ) {
+                    reallocatePayload_(size);
+                    shrunk = true;
+                }
+                if( shrunk ) {
+                    ++nShrinks_;
+                    if constexpr(::mpi12s::_debug_ && _debug_)
+                        prdbg("MessageBuffer::clear() : shrunk", statisticsToStr());
+                }
+                quietSteps_ = 0;
+                quietHwmMessages_ = 0;
+                quietHwmPayload_  = 0;
+            }
+        }
+        pHeaders_[0] = 0;
+        payloadUsed_ = 0;
+    }
+
+    void
+    MessageBuffer::
+    updateHighWaterMarks_()
+    {
+        hwmMessages_ = std::max( hwmMessages_, nMessages() );
+        hwmPayload_  = std::max( hwmPayload_ , payloadUsed_ );
+    }
+
+    void
+    MessageBuffer::
+    reallocateHeaders_(size_t max_msgs)
+    {
+        Index_t const used = headerSizeUsed();
+        maxmsgs_ = max_msgs;
+        Index_t* pHeaders = new Index_t[headerSize()];
+        memcpy( pHeaders, pHeaders_, used*sizeof(Index_t) );
+      #ifdef FILL_BUFFER   
+        for( Index_t i = used; i < headerSize(); ++i ) {
+            pHeaders[i] = -1;
+        }
+      #endif
+        delete[] pHeaders_;
+        pHeaders_ = pHeaders;
+    }
+
+    void
+    MessageBuffer::
+    reallocatePayload_(size_t size)
+    {
+        Index_t* pPayload = allocatePayload_(size);
+        if( pPayload_ )
+            memcpy( pPayload, pPayload_, payloadUsed_*sizeof(Index_t) );
+      #ifdef FILL_BUFFER   
+        for( size_t i = payloadUsed_; i < size; ++i ) {
+            pPayload[i] = -1;
+        }
+      #endif
+        freePayload_();
+        pPayload_ = pPayload;
+        arenaAlignment_ = payloadAlignment_;
+        payloadSize_ = size;
+        headersOnly_ = (size == 0);
+    }
+
+    Index_t*
+    MessageBuffer::
+    allocatePayload_(size_t size)
+    {
+        return static_cast<Index_t*>( ::operator new[]( size*sizeof(Index_t), std::align_val_t(payloadAlignment_) ) );
+    }
+
+    void
+    MessageBuffer::
+    freePayload_()
+    {
+        if( pPayload_ )
+            ::operator delete[]( pPayload_, std::align_val_t(arenaAlignment_) );
+    }
+
+    void
+    MessageBuffer::
+    setPayloadAlignment(size_t nBytes)
+    {
+        if( nBytes < sizeof(Index_t) || ( nBytes & (nBytes - 1) ) != 0 ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::setPayloadAlignment() : the alignment must be a power "
+                                 "of two, and at least sizeof(Index_t) (" + std::to_string(nBytes) + ").";
+            throw std::runtime_error(errmsg);
+        }
+        if( pHeaders_ && nMessages() > 0 ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::setPayloadAlignment() : cannot change the alignment "
+                                 "of a MessageBuffer that contains messages.";
+            throw std::runtime_error(errmsg);
+        }
+        payloadAlignment_ = nBytes;
+        {
+            std::lock_guard<std::mutex> lock(threadBuffersMutex_);
+            for( auto& sub : threadBuffers_ )
+                sub->setPayloadAlignment(nBytes);
+        }
+     // An owned payload arena that is not aligned enough is reallocated.
+        if( payloadOwned_ && pPayload_ && nBytes > arenaAlignment_ )
+            reallocatePayload_(payloadSize_);
+    }
+
+    void
+    MessageBuffer::
+    reserveMessages(size_t n)
+    {
+        if( n <= maxmsgs_ )
+            return;
+        if( !headersOwned_ ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::reserveMessages() : cannot grow a header table that is "
+                                 "not owned by the MessageBuffer (" + std::to_string(n) + " > " + std::to_string(maxmsgs_) + ")."
+                                 " Increase the maximum number of messages (high-water mark: " + std::to_string(hwmMessages_) + ").";
+            throw std::runtime_error(errmsg);
+        }
+     // grow geometrically
+        reallocateHeaders_( std::max( n, (size_t)std::ceil(maxmsgs_*growthFactor_) ) );
+        ++nGrowHeaders_;
+        if constexpr(::mpi12s::_debug_ && _debug_)
+            prdbg("MessageBuffer::reserveMessages() : grown", statisticsToStr());
+    }
+
+    void
+    MessageBuffer::
+    reservePayload(size_t n)
+    {
+        if( n <= payloadSize_ )
+            return;
+        if( !payloadOwned_ ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::reservePayload() : cannot grow a payload arena that is "
+                                 "not owned by the MessageBuffer (" + std::to_string(n) + " > " + std::to_string(payloadSize_) + ")."
+                                 " Increase the buffer size (high-water mark: " + std::to_string(hwmPayload_) + ").";
+            throw std::runtime_error(errmsg);
+        }
+     // grow geometrically
+        reallocatePayload_( std::max( n, (size_t)std::ceil(payloadSize_*growthFactor_) ) );
+        ++nGrowPayload_;
+        if constexpr(::mpi12s::_debug_ && _debug_)
+            prdbg("MessageBuffer::reservePayload() : grown", statisticsToStr());
     }
 
     void*                                 // returns pointer to the reserved memory in the MessageBuffer
@@ -91,33 +361,136 @@ namespace mpi12s
       , int      to_rank                  // the destination of the message
       , ::mpi12s::MessageHandlerKey_t key // the key of the object responsible for reading the message
       , Index_t* the_msgid                // on return contains the id of the allocated message, if provided
+      , Index_t  flags                    // flags of the message
       )
     {
-        // std::cout<<headersToStr(true)<<std::endl; // debugging
-
+        if( broadcastInProgress_ ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::allocateMessage() : cannot post a message while a "
+                                 "broadcast is in progress. Call finishBroadcast() first.";
+            throw std::runtime_error(errmsg);
+        }
         Index_t msgid = nMessages();
         if( the_msgid ) {
             *the_msgid = msgid;
         }
+        Index_t szIndex_t = ( flags & ZERO_COPY ? 0 : (sz + (sizeof(Index_t) - 1))/sizeof(Index_t) );
+     // Make sure there is room for the header and for the payload
+        reserveMessages( msgid + 1 );
+        if( !headersOnly_ )
+            reservePayload( alignWords_(payloadUsed_) + szIndex_t );
+
         incrementNMessages();
         
         setMessageSource     (msgid, from_rank);
         setMessageDestination(msgid, to_rank);
         setMessageHandlerKey (msgid, key);
+        setMessageFlags      (msgid, flags);
+        setMessageLength     (msgid, sz);
 
-     // The begin of the message is already set. Only the end must be set.
-        Index_t szIndex_t = (sz + (sizeof(Index_t) - 1))/sizeof(Index_t);
-        Index_t end = messageBegin(msgid) + szIndex_t;
-        setMessageEnd( msgid, end );
-     // Set the begin of the next message (so that the comment above is remains true).
-     // The begin of the next message is end of this message.
-        setMessageBegin( msgid + 1, end ); 
-
-        // std::cout<<headersToStr(true)<<std::endl; // debugging
+     // The payload is appended to the part of the payload arena that is in use, at the payload alignment.
+        Index_t begin = alignWords_(payloadUsed_);
+        Index_t end   = begin + szIndex_t;
+        setMessageBegin( msgid, begin );
+        setMessageEnd  ( msgid, end );
+        payloadUsed_ = end;
+        updateHighWaterMarks_();
 
         return ( headersOnly_ ? nullptr : messagePtr(msgid) );
     }
 
+    void
+    MessageBuffer::
+    setZeroCopyIndices(Index_t msgid, std::vector<Index_t>&& indices)
+    {
+        if( !transport_->isMpi() ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::setZeroCopyIndices() : zero-copy messages require the MPI transport.";
+            throw std::runtime_error(errmsg);
+        }
+        zeroCopyIndices_[msgid] = std::move(indices);
+    }
+
+    MessageBuffer&
+    MessageBuffer::
+    postingBuffer()
+    {
+        if( std::this_thread::get_id() == ownerThread_ )
+            return *this;
+     // Look up the sub-buffer of this thread in a per-thread cache, so that no synchronization is
+     // needed, except when a thread posts its first message.
+        thread_local std::vector<std::pair<size_t,MessageBuffer*>> cache;
+        for( auto const& entry : cache ) {
+            if( entry.first == id_ )
+                return *entry.second;
+        }
+        std::lock_guard<std::mutex> lock(threadBuffersMutex_);
+        threadBuffers_.emplace_back( new MessageBuffer(*transport_) );
+        MessageBuffer* sub = threadBuffers_.back().get();
+        sub->setPayloadAlignment( payloadAlignment_ );
+        sub->initialize( std::max<size_t>(initialPayloadSize_, 1), initialMaxmsgs_ );
+        sub->setGrowthFactor( growthFactor_ );
+        cache.emplace_back( id_, sub );
+        return *sub;
+    }
+
+    void
+    MessageBuffer::
+    mergeThreadBuffers_()
+    {
+        std::lock_guard<std::mutex> lock(threadBuffersMutex_);
+        for( auto& sub : threadBuffers_ )
+        {
+            Index_t n = sub->nMessages();
+            if( n == 0 )
+                continue;
+            Index_t first  = nMessages();
+            Index_t offset = alignWords_(payloadUsed_); // keeps the payloads of the sub-buffer aligned
+            reserveMessages( first + n );
+            reservePayload ( offset + sub->payloadUsed_ );
+            simd::copy( &pPayload_[offset], sub->pPayload_, sub->payloadUsed_*sizeof(Index_t) );
+            memcpy( &pHeaders_[1 + HEADER_SIZE*first], &sub->pHeaders_[1], n*HEADER_SIZE*sizeof(Index_t) );
+            incrementNMessages(n);
+            payloadUsed_ = offset + sub->payloadUsed_;
+         // The payload locations are relative to the sub-buffer's payload arena:
+            for( Index_t msg_id = first; msg_id < first + n; ++msg_id ) {
+                setMessageBegin( msg_id, messageBegin(msg_id) + offset );
+                setMessageEnd  ( msg_id, messageEnd  (msg_id) + offset );
+            }
+            for( auto& entry : sub->zeroCopyIndices_ )
+                zeroCopyIndices_[first + entry.first] = std::move(entry.second);
+            sub->zeroCopyIndices_.clear();
+            sub->clear();
+        }
+        for( auto& sub : threadBuffers_ ) {
+            compressionStatistics_ += sub->compressionStatistics_;
+            sub->compressionStatistics_ = CompressionStatistics();
+        }
+        updateHighWaterMarks_();
+    }
+
+    Index_t                // returns the id of the header added
+    MessageBuffer::
+    addMessageDestination
+      ( Index_t msgid      // id of the message, as returned by allocateMessage()
+      , int     to_rank    // the additional destination
+      )
+    {
+        Index_t msgid2 = nMessages();
+        reserveMessages( msgid2 + 1 );
+        incrementNMessages();
+
+        setMessageSource     (msgid2, messageSource(msgid));
+        setMessageDestination(msgid2, to_rank);
+        setMessageHandlerKey (msgid2, messageHandlerKey(msgid));
+        setMessageFlags      (msgid2, messageFlags(msgid));
+        setMessageLength     (msgid2, messageLength(msgid));
+     // The payload is shared with message msgid:
+        setMessageBegin      (msgid2, messageBegin(msgid));
+        setMessageEnd        (msgid2, messageEnd  (msgid));
+        updateHighWaterMarks_();
+
+        return msgid2;
+    }
+
     std::vector<std::string> // list of lines
     MessageBuffer::
     headersToStr(bool verbose) const
@@ -144,6 +517,30 @@ namespace mpi12s
         return lines;
     }
 
+    std::vector<std::string> // list of lines
+    MessageBuffer::
+    statisticsToStr() const
+    {
+        std::stringstream ss;
+        std::vector<std::string> lines;
+        lines.push_back("MessageBuffer::statisticsToStr() :");
+
+        ss<<std::setw(20)<<""<<std::setw(20)<<"capacity"<<std::setw(20)<<"in use"<<std::setw(20)<<"high-water mark"<<std::setw(20)<<"#grown";
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<std::setw(20)<<"messages"<<std::setw(20)<<maxmsgs_<<std::setw(20)<<nMessages()<<std::setw(20)<<hwmMessages_<<std::setw(20)<<nGrowHeaders_;
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<std::setw(20)<<"payload (words)"<<std::setw(20)<<payloadSize_<<std::setw(20)<<payloadUsed_<<std::setw(20)<<hwmPayload_<<std::setw(20)<<nGrowPayload_;
+        lines.push_back(ss.str()); ss.str(std::string());
+        ss<<"steps="<<nSteps_<<", quiet steps="<<quietSteps_<<", shrinks="<<nShrinks_
+          <<", growth factor="<<growthFactor_<<", shrink after="<<shrinkAfter_;
+        lines.push_back(ss.str()); ss.str(std::string());
+        if( compressionStatistics_.nCompressed + compressionStatistics_.nIncompressible + compressionStatistics_.nDecompressed > 0 ) {
+            std::vector<std::string> compression = compressionStatistics_.toStr();
+            lines.insert( lines.end(), compression.begin(), compression.end() );
+        }
+        return lines;
+    }
+
     std::vector<std::string> // list of lines
     MessageBuffer::
     messageToStr
@@ -178,16 +575,150 @@ namespace mpi12s
         return lines;
     }
 
+    char const*
+    MessageBuffer::
+    exchangeModeName(ExchangeMode mode)
+    {
+        switch( mode ) {
+            case FLAT        : return "FLAT";
+            case ONESIDED    : return "ONESIDED";
+            case HIERARCHICAL: return "HIERARCHICAL";
+            case AUTO        : return "AUTO";
+        }
+        return "?";
+    }
+
+    void
+    MessageBuffer::
+    setExchangeMode
+      ( ExchangeMode mode
+      , int ranksPerNode
+      )
+    {
+        if( mode != FLAT && !transport_->isMpi() ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::setExchangeMode() : exchange mode "
+                               + exchangeModeName(mode) + " requires the MPI transport.";
+            throw std::runtime_error(errmsg);
+        }
+        exchangeMode_ = mode;
+        ranksPerNode_ = ranksPerNode;
+        if( mode == AUTO ) {
+            tuner_ = ExchangeTuner();
+            for( ExchangeMode candidate : {FLAT, ONESIDED, HIERARCHICAL} )
+                tuner_.addCandidate( candidate, exchangeModeName(candidate) );
+        }
+    }
+
  // Broadcast my headers to all other processes, process the headers and
  // fetch the messages which are for me.
     void
     MessageBuffer::
     broadcast()
+    {
+        mergeThreadBuffers_();
+        if( exchangeMode_ != AUTO ) {
+            broadcast_(exchangeMode_);
+            return;
+        }
+     // Let the tuner decide, based on the global traffic pattern, and on the maximum time over all
+     // processes, so that all processes take the same decision.
+        Index_t traffic[2] = { nMessages(), payloadUsed_ };
+        MPI_Allreduce( MPI_IN_PLACE, traffic, 2, MPI_LONG_LONG_INT, MPI_SUM, MPI_COMM_WORLD );
+        ExchangeMode mode = static_cast<ExchangeMode>( tuner_.next(traffic[0], traffic[1]) );
+        double t0 = MPI_Wtime();
+        broadcast_(mode);
+        double t = MPI_Wtime() - t0;
+        MPI_Allreduce( MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD );
+        tuner_.record(t);
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            prdbg( tostr("MessageBuffer::broadcast() : AUTO used ", exchangeModeName(mode), ", t=", t), tuner_.toStr() );
+        }
+    }
+
+    void
+    MessageBuffer::
+    startBroadcast()
+    {
+        if( exchangeMode_ != FLAT ) {
+            broadcast();
+            return;
+        }
+        mergeThreadBuffers_();
+        lastExchangeMode_ = FLAT;
+        startBroadcastFlat_();
+    }
+
+    bool
+    MessageBuffer::
+    testBroadcast()
+    {
+        if( !broadcastInProgress_ )
+            return true;
+        return transport_->testAll();
+    }
+
+    void
+    MessageBuffer::
+    finishBroadcast()
+    {
+        if( !broadcastInProgress_ )
+            return;
+        transport_->waitAll();
+        broadcastInProgress_ = false;
+        decompressMessages_();
+        updateHighWaterMarks_();
+
+     // print the received messages:
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            for( Index_t msg_id = nMessagesMine_; msg_id < nMessages(); ++msg_id) {
+                if( isIncoming(msg_id) ) {
+                    prdbg( tostr( "MessageBuffer::broadcast() : received message content (msg_id=", msg_id, ", "
+                                , messageSource(msg_id), "->", messageDestination(msg_id), ")"
+                                )
+                         , messageToStr(msg_id)
+                         );
+                }
+            }
+        }
+    }
+
+    void
+    MessageBuffer::
+    broadcast_(ExchangeMode mode)
+    {
+        if( mode != FLAT && !zeroCopyIndices_.empty() ) {
+            std::string errmsg = ::mpi12s::info + "MessageBuffer::broadcast() : zero-copy messages require the FLAT exchange mode.";
+            throw std::runtime_error(errmsg);
+        }
+        lastExchangeMode_ = mode;
+        switch( mode ) {
+            case FLAT:
+                broadcastFlat_();
+                break;
+            case ONESIDED:
+                broadcastOneSided_();
+                decompressMessages_();
+                break;
+            case HIERARCHICAL:
+                broadcastHierarchical_();
+                decompressMessages_();
+                break;
+            case AUTO:
+                throw std::runtime_error("MessageBuffer::broadcast_() : AUTO is not a strategy.");
+        }
+    }
+
+    void
+    MessageBuffer::
+    exchangeHeaders_
+      ( std::vector<Index_t>& nmessages_per_rank // on return, the number of messages of every rank
+      , std::vector<Index_t>& first_msg_of_rank  // on return, the id of the first header of every rank
+      )
     {// broadcast the size of the header section of all processes
-        std::vector<Index_t> nmessages_per_rank(mpi12s::size);
-        nmessages_per_rank[mpi12s::rank] = nMessages();
-        for( int source = 0; source < mpi12s::size; ++source ) {
-            MPI_Bcast(&nmessages_per_rank[source], 1, MPI_LONG_LONG_INT, source, MPI_COMM_WORLD);
+        nmessages_per_rank.assign(nRanks(), 0);
+        nmessages_per_rank[rank()] = nMessages();
+        for( int source = 0; source < nRanks(); ++source ) {
+            transport_->bcast(&nmessages_per_rank[source], 1, source);
         }
      // print the number of messages per rank:
         if constexpr(::mpi12s::_debug_) {
@@ -200,29 +731,35 @@ namespace mpi12s
             prdbg( tostr("broadcast(): numbe of essages in each rank:"), lines );
         }
 
+     // Make sure the header table can hold the headers of all processes
+        Index_t nmessages_total = 0;
+        for( auto n : nmessages_per_rank )
+            nmessages_total += n;
+        reserveMessages( nmessages_total );
+
      // Broadcast the header section of all processes
      // All the headers to appear after each other, therefore the buffer location depends on the proces
      // Also note that we do NOT want to send the first entry of the buffer as this contains the number
      // of messages in the header.
-        for( int source = 0; source < mpi12s::size; ++source ) {
-            if( source == ::mpi12s::rank)
+     // We keep track of the id of the first header of each source, to be able to visit the messages
+     // in the same order on all processes (which is needed for the broadcast messages).
+        first_msg_of_rank.assign(nRanks(), 0);
+        for( int source = 0; source < nRanks(); ++source ) {
+            first_msg_of_rank[source] = ( source == rank() ? 0 : nMessages() );
+            if( source == rank())
             {// this process is the root of the broadcast operation (=sender)
-                MPI_Bcast
-                ( &pBuffer_[1]                           // the headers to be sent start here
+                transport_->bcast
+                ( &pHeaders_[1]                          // the headers to be sent start here
                                                          // this is the source
-                , HEADER_SIZE*nmessages_per_rank[source]              // number of Index_t items to be sent
-                , MPI_LONG_LONG_INT                      // MPI equivalent of Index_t
-                , source                                 // source rank, equals ::mpi12s::rank
-                , MPI_COMM_WORLD
+                , HEADER_SIZE*nmessages_per_rank[source] // number of Index_t items to be sent
+                , source                                 // source rank, equals rank()
                 );
             } else
             {// This process is a listener to the broadcast operation (=receiver)
-                MPI_Bcast
-                ( &pBuffer_[1 + nMessages()*HEADER_SIZE] // this is the destination
-                , HEADER_SIZE*nmessages_per_rank[source]              // number of Index_t items to be received from source rank
-                , MPI_LONG_LONG_INT                      // MPI equivalent of Index_t
+                transport_->bcast
+                ( &pHeaders_[1 + nMessages()*HEADER_SIZE]// this is the destination
+                , HEADER_SIZE*nmessages_per_rank[source] // number of Index_t items to be received from source rank
                 , source                                 // source rank
-                , MPI_COMM_WORLD
                 );
              // We have now received the headers from the source rank. Note that the messageBegin and messageEnd
              // entries in these refer to the begin and end of the message in the messageBuffer of the source rank
@@ -237,22 +774,97 @@ namespace mpi12s
             prdbg("MessageBuffer::broadcast() : headers transferred:", headersToStr());
         }
 
+     // Reserve room in the payload arena for the messages that are for me. The payloads are laid 
+     // out behind the messages of this rank, each at the payload alignment: first the point-to-point
+     // messages, then the broadcast messages. Rounding every message up to the alignment gives room
+     // for them in any order.
+     // The payload arena is grown only once, before any receive is posted, because growing moves
+     // the payload arena.
+        Index_t nmessages_mine = nmessages_per_rank[rank()];
+        Index_t end = alignWords_(payloadUsed_);
+        for( Index_t msg_id = nmessages_mine; msg_id < nMessages(); ++msg_id) {
+            if( isIncoming(msg_id) )
+                end += alignWords_( messageWords(msg_id) );
+        }
+        reservePayload(end);
+    }
+
+    void
+    MessageBuffer::
+    startBroadcastMessages_
+      ( std::vector<Index_t> const& nmessages_per_rank // as returned by exchangeHeaders_()
+      , std::vector<Index_t> const& first_msg_of_rank  // as returned by exchangeHeaders_()
+      )
+    {
+     // Broadcast messages are carried by a non-blocking tree broadcast rooted at their source. Non-blocking
+     // collectives must be started in the same order on all processes: by source rank, and by message id
+     // within the source.
+        for( int source = 0; source < nRanks(); ++source ) {
+            Index_t first = first_msg_of_rank[source];
+            for( Index_t msg_id = first; msg_id < first + nmessages_per_rank[source]; ++msg_id )
+            {
+                if( messageDestination(msg_id) != ALL_RANKS )
+                    continue;
+                if( source != rank() )
+                {// Make room for the message content
+                    Index_t begin = alignWords_(payloadUsed_);
+                    payloadUsed_ = begin + messageWords(msg_id);
+                    setMessageBegin(msg_id, begin);
+                    setMessageEnd  (msg_id, payloadUsed_);
+                }
+                if constexpr(::mpi12s::_debug_ && _debug_) {
+                    prdbg( tostr("MessageBuffer::broadcast() : broadcasting message content from "
+                                , source, ", key=", messageHandlerKey(msg_id))
+                         );
+                }
+                transport_->ibcast
+                  ( static_cast<Index_t*>(messagePtr(msg_id)) // the source on the root, the destination on the other ranks
+                  , messageWords(msg_id)                      // number of Index_t elements to broadcast
+                  , source                                    // root of the broadcast
+                  );
+            }
+        }
+    }
+
+    void
+    MessageBuffer::
+    broadcastFlat_()
+    {
+        startBroadcastFlat_();
+        finishBroadcast();
+    }
+
+    void
+    MessageBuffer::
+    startBroadcastFlat_()
+    {
+        std::vector<Index_t> nmessages_per_rank, first_msg_of_rank;
+        exchangeHeaders_(nmessages_per_rank, first_msg_of_rank);
+        nMessagesMine_ = nmessages_per_rank[rank()];
+
      // Loop over the message headers in this messageBuffer.
      //   If its source is this rank, then send it to its destination: MPI_Isend (non-blocking)
-     //   If its destination is this rank then receive it from this rank: MPI_Recv (blocking)
+     //   If its destination is this rank then receive it from this rank: MPI_Irecv (non-blocking)
      //   update the header if needed to have the correct locations of the begin and end of the message.
      //
      // What do we use as a tag? We need it as there may be several messages between the same rank.
      // Since no process can make two message with the same messageHandlerKey, the latter can be used as a tag.
      // The triplet (source rank, destination rank, messageHandlerKey) is unique.
      //
-     // We first want do all the sends, non-blocking, then all the receives, blocking.
-     // This is automatically satisfied because all the sends are at the beginning of the
-     // messageBuffer.
-        int elements_added = 0;
+     // All the sends and receives are non-blocking, we wait for their completion in finishBroadcast().
+     //
+     // The incoming zero-copy messages are received straight into target slots provided by their
+     // MessageHandler. Providing slots may grow (move) the arrays, which may also be the target of
+     // earlier zero-copy messages, or the source of the zero-copy messages sent by this rank. Hence,
+     // all slots are provided before any datatype is created.
+        std::map<Index_t,MPI_Datatype> zeroCopyReceives = zeroCopyReceiveDatatypes_();
         for( Index_t msg_id = 0; msg_id < nMessages(); ++msg_id)
         {
-            if( messageSource(msg_id) == ::mpi12s::rank )
+            if( messageDestination(msg_id) == ALL_RANKS )
+            {// broadcast messages are treated below
+                continue;
+            }
+            if( messageSource(msg_id) == rank() )
             {// send the message content
                 if constexpr(::mpi12s::_debug_ && _debug_) {
                     prdbg( tostr("MessageBuffer::broadcast() : sending   message content "
@@ -260,19 +872,29 @@ namespace mpi12s
                                 , ", key=", messageHandlerKey(msg_id))
                          );
                 }
-                MPI_Request request;
-                int success =
-                MPI_Isend                                       // non-blocking
-                  ( messagePtr(msg_id)                          // pointer to buffer to send
-                  , messageEnd(msg_id) - messageBegin(msg_id)   // number of Index_t elements to send
-                  , MPI_LONG_LONG_INT                           // MPI type equivalent of Index_t
+                if( isZeroCopy(msg_id) )
+                {// straight from the application's arrays
+                    auto it = zeroCopyIndices_.find(msg_id);
+                    if( it == zeroCopyIndices_.end() ) {
+                        std::string errmsg = ::mpi12s::info + "MessageBuffer::broadcast() : zero-copy message without indices.";
+                        throw std::runtime_error(errmsg);
+                    }
+                    ::mpi2s::MessageHandlerBase& mh = (*registry_)[messageHandlerKey(msg_id)];
+                    MPI_Datatype datatype = mh.zeroCopySendDatatype(it->second);
+                    static_cast<MpiTransport*>(transport_)->isend
+                      ( MPI_BOTTOM, datatype, messageDestination(msg_id), messageHandlerKey(msg_id) );
+                    MPI_Type_free(&datatype);
+                    zeroCopyIndices_.erase(it);
+                    continue;
+                }
+                transport_->isend                               // non-blocking
+                  ( static_cast<Index_t*>(messagePtr(msg_id))   // pointer to buffer to send
+                  , messageWords(msg_id)                        // number of Index_t elements to send
                   , messageDestination(msg_id)                  // the destination
                   , messageHandlerKey(msg_id)                   // the tag
-                  , MPI_COMM_WORLD
-                  , &request
                   );
             } else {
-                if( messageDestination(msg_id) == ::mpi12s::rank )
+                if( messageDestination(msg_id) == rank() )
                 {// recv the message content
                     if constexpr(::mpi12s::_debug_ && _debug_) {
                         prdbg( tostr("MessageBuffer::broadcast() : receiving message content "
@@ -280,67 +902,372 @@ namespace mpi12s
                                     , ", key=", messageHandlerKey(msg_id))
                              );
                     }
-
-                    int elements_to_add =  messageEnd(msg_id) - messageBegin(msg_id); // this number does not change
-                    Index_t begin = messageEnd(msg_id - 1); // first element of the buffer where the message content will be written
-                     // even if this is the first message to be received, the end of the previous message in the buffer is
-                     // correctly set, since that is a message that was constructed on this rank and therefore the end
-                     // of the previous message exists and is correct.
-                    Index_t end   = begin + elements_to_add; // past-the-end element of the buffer where the message content will be written
-
-                    int succes =
-                    MPI_Recv
-                      ( &pBuffer_[begin]            // pointer to buffer where to store the message
-                      , elements_to_add             // number of elements to receive
-                      , MPI_LONG_LONG_INT
-                      , messageSource(msg_id)       // source rank
-                      , messageHandlerKey(msg_id)   // tag
-                      , MPI_COMM_WORLD
-                      , MPI_STATUS_IGNORE
-                      );
+                    if( isZeroCopy(msg_id) )
+                    {// straight into the target slots provided by the MessageHandler
+                        MPI_Datatype datatype = zeroCopyReceives[msg_id];
+                        static_cast<MpiTransport*>(transport_)->irecv
+                          ( MPI_BOTTOM, datatype, messageSource(msg_id), messageHandlerKey(msg_id) );
+                        MPI_Type_free(&datatype);
+                        setMessageBegin(msg_id, payloadUsed_);
+                        setMessageEnd  (msg_id, payloadUsed_);
+                        continue;
+                    }
                  // Update the header of the message, so that the message content can be read afterwards.
+                    Index_t begin = alignWords_(payloadUsed_);
+                    payloadUsed_ = begin + messageWords(msg_id);
                     setMessageBegin(msg_id, begin);
-                    setMessageEnd  (msg_id, end);
+                    setMessageEnd  (msg_id, payloadUsed_);
 
-                 // print the messageBuffer:
-                    if constexpr(::mpi12s::_debug_ && _debug_) {
-                        prdbg( tostr( "MessageBuffer::broadcast() : received message content (msg_id=", msg_id, ", "
-                                    , messageSource(msg_id), "->", messageDestination(msg_id), ")"
-                                    )
-                             , messageToStr(msg_id)
-                             );
-                    }
+                    transport_->irecv
+                      ( static_cast<Index_t*>(messagePtr(msg_id)) // pointer to buffer where to store the message
+                      , messageWords(msg_id)                      // number of elements to receive
+                      , messageSource(msg_id)                     // source rank
+                      , messageHandlerKey(msg_id)                 // tag
+                      );
                 }
                 else {
                     if constexpr(::mpi12s::_debug_ && _debug_) {
                         prdbg( tostr("MessageBuffer::broadcast() : skipping message  "
                                     , messageSource(msg_id), "->", messageDestination(msg_id)
-                                    , " because it it not for this rank (", ::mpi12s::rank, ")"
+                                    , " because it it not for this rank (", rank(), ")"
                                     )
                              );
                     }
                 }
             }
         }
+
+        startBroadcastMessages_(nmessages_per_rank, first_msg_of_rank);
+        broadcastInProgress_ = true;
+    }
+
+    std::map<Index_t,MPI_Datatype> // the datatype of every incoming zero-copy message
+    MessageBuffer::
+    zeroCopyReceiveDatatypes_()
+    {
+     // the incoming zero-copy messages, per MessageHandler, in the order of the headers
+        std::map<Index_t,std::vector<Index_t>> messages;
+        for( Index_t msg_id = 0; msg_id < nMessages(); ++msg_id )
+            if( isZeroCopy(msg_id) && messageSource(msg_id) != rank() && messageDestination(msg_id) == rank() )
+                messages[messageHandlerKey(msg_id)].push_back(msg_id);
+        std::map<Index_t,std::vector<size_t>> nBytes;
+        for( auto const& entry : messages )
+            for( Index_t msg_id : entry.second )
+                nBytes[entry.first].push_back( messageLength(msg_id) );
+     // first provide all target slots,
+        for( auto const& entry : nBytes )
+            (*registry_)[entry.first].provideZeroCopySlots(entry.second);
+     // then create the datatypes
+        std::map<Index_t,MPI_Datatype> datatypes;
+        for( auto const& entry : nBytes ) {
+            std::vector<MPI_Datatype> handlerDatatypes = (*registry_)[entry.first].zeroCopyReceiveDatatypes(entry.second);
+            std::vector<Index_t> const& ids = messages[entry.first];
+            for( size_t m = 0; m < ids.size(); ++m )
+                datatypes[ids[m]] = handlerDatatypes[m];
+        }
+        return datatypes;
+    }
+
+    void
+    MessageBuffer::
+    exposePayload_()
+    {// (Re)create the window if the payload arena of any process has moved or changed size since the
+     // window was created. Creating a window is a collective operation.
+        int changed = ( payloadWindow_ == MPI_WIN_NULL || windowBase_ != pPayload_ || windowSize_ != payloadSize_ );
+        MPI_Allreduce( MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD );
+        if( changed ) {
+            if( payloadWindow_ != MPI_WIN_NULL )
+                MPI_Win_free(&payloadWindow_);
+            MPI_Win_create
+              ( pPayload_                                          // memory exposed through the window
+              , static_cast<MPI_Aint>(payloadSize_*sizeof(Index_t))// its size in bytes
+              , sizeof(Index_t)                                    // displacement unit
+              , MPI_INFO_NULL
+              , MPI_COMM_WORLD
+              , &payloadWindow_
+              );
+            windowBase_ = pPayload_;
+            windowSize_ = payloadSize_;
+        }
+    }
+
+ // One-sided exchange: the headers are broadcast as in the flat exchange, but the point-to-point 
+ // messages are fetched by their destination with MPI_Get from a window on the payload arena of
+ // their source. Broadcast messages are still carried by a tree broadcast.
+    void
+    MessageBuffer::
+    broadcastOneSided_()
+    {
+        std::vector<Index_t> nmessages_per_rank, first_msg_of_rank;
+        exchangeHeaders_(nmessages_per_rank, first_msg_of_rank);
+        Index_t nmessages_mine = nmessages_per_rank[rank()];
+
+     // The payload arena is not moved after this point, so it can be exposed.
+        exposePayload_();
+        MPI_Win_fence(MPI_MODE_NOPRECEDE, payloadWindow_);
+        for( Index_t msg_id = nmessages_mine; msg_id < nMessages(); ++msg_id)
+        {
+            if( messageDestination(msg_id) != rank() )
+                continue;
+         // The location of the message in the payload arena of the source, before it is overwritten
+         // with its location in this MessageBuffer's payload arena.
+            Index_t remote_begin = messageBegin(msg_id);
+            Index_t begin = alignWords_(payloadUsed_);
+            payloadUsed_ = begin + messageWords(msg_id);
+            setMessageBegin(msg_id, begin);
+            setMessageEnd  (msg_id, payloadUsed_);
+            MPI_Get
+              ( messagePtr(msg_id)          // buffer to store the elements to get
+              , messageWords(msg_id)        // number of elements
+              , MPI_LONG_LONG_INT
+              , messageSource(msg_id)       // process rank to get from (target)
+              , remote_begin                // offset in the target's window
+              , messageWords(msg_id)
+              , MPI_LONG_LONG_INT
+              , payloadWindow_
+              );
+        }
+        MPI_Win_fence(MPI_MODE_NOSUCCEED, payloadWindow_);
+
+        startBroadcastMessages_(nmessages_per_rank, first_msg_of_rank);
+        transport_->waitAll();
+        updateHighWaterMarks_();
+
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            prdbg("MessageBuffer::broadcastOneSided_() : headers:", headersToStr());
+        }
+    }
+
+ // Node-aware exchange. The messages travel as records: a header followed by the payload. The
+ // MSG_BGN and MSG_END entries of the header of a record refer to the payload of the record.
+ //  1. every rank gathers its records on its node leader (this stays on the node, MPI uses shared memory),
+ //  2. the node leaders bundle the records per destination node, and exchange the bundles. Broadcast
+ //     messages are sent to every node once,
+ //  3. the node leaders scatter the records they received to the destination ranks on their node,
+ //  4. every rank appends the records it received to its MessageBuffer.
+ // The number of inter-node messages is the number of pairs of nodes, rather than the number of pairs of
+ // ranks on different nodes that have something to say to each other.
+    void
+    MessageBuffer::
+    broadcastHierarchical_()
+    {
+        if( !topology_.initialized() )
+            topology_.initialize(ranksPerNode_);
+        MPI_Comm const nodeComm = topology_.nodeComm();
+
+     // Apply f to all records in a list of records.
+        auto forEachRecord = [](std::vector<Index_t> const& records, auto f)
+        {
+            for( size_t i = 0; i < records.size(); ) {
+                Index_t const* record = &records[i];
+                size_t words = HEADER_SIZE + record[MSG_END] - record[MSG_BGN];
+                f(record, words);
+                i += words;
+            }
+        };
+        auto appendRecord = [](std::vector<Index_t>& records, Index_t const* record, size_t words)
+        {
+            records.insert( records.end(), record, record + words );
+        };
+     // Flatten a list of bundles, and compute counts and displacements for MPI.
+        auto flatten = []( std::vector<std::vector<Index_t>> const& bundles
+                         , std::vector<Index_t>& flat, std::vector<int>& counts, std::vector<int>& displs )
+        {
+            counts.resize(bundles.size());
+            displs.resize(bundles.size());
+            int displ = 0;
+            for( size_t i = 0; i < bundles.size(); ++i ) {
+                counts[i] = static_cast<int>(bundles[i].size());
+                displs[i] = displ;
+                displ += counts[i];
+            }
+            flat.clear();
+            flat.reserve(displ);
+            for( auto const& bundle : bundles )
+                flat.insert( flat.end(), bundle.begin(), bundle.end() );
+        };
+        auto displacements = []( std::vector<int> const& counts, std::vector<int>& displs ) -> int
+        {
+            displs.resize(counts.size());
+            int displ = 0;
+            for( size_t i = 0; i < counts.size(); ++i ) {
+                displs[i] = displ;
+                displ += counts[i];
+            }
+            return displ;
+        };
+
+     // 1. Serialize my messages and gather them on the node leader
+        std::vector<Index_t> records;
+        Index_t const nmessages_mine = nMessages();
+        for( Index_t msg_id = 0; msg_id < nmessages_mine; ++msg_id ) {
+            Index_t const* header = &pHeaders_[1 + HEADER_SIZE*msg_id];
+            size_t first = records.size();
+            records.insert( records.end(), header, header + HEADER_SIZE );
+            records[first + MSG_BGN] = 0;
+            records[first + MSG_END] = messageWords(msg_id);
+            Index_t const* payload = &pPayload_[messageBegin(msg_id)];
+            records.insert( records.end(), payload, payload + messageWords(msg_id) );
+        }
+        int count = static_cast<int>(records.size());
+        std::vector<int> counts, displs;
+        std::vector<Index_t> gathered;
+        if( topology_.isLeader() )
+            counts.resize(topology_.nodeSize());
+        MPI_Gather( &count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, nodeComm );
+        if( topology_.isLeader() )
+            gathered.resize( displacements(counts, displs) );
+        MPI_Gatherv( records.data(), count, MPI_LONG_LONG_INT
+                   , gathered.data(), counts.data(), displs.data(), MPI_LONG_LONG_INT, 0, nodeComm );
+
+        std::vector<Index_t> scattered;
+        std::vector<int> scounts, sdispls;
+        if( topology_.isLeader() )
+        {// 2. Bundle the records per destination node, and exchange the bundles between the node leaders.
+            int const nNodes = topology_.nNodes();
+            std::vector<std::vector<Index_t>> toNode(nNodes);
+            forEachRecord( gathered, [&](Index_t const* record, size_t words)
+            {
+                int dst = static_cast<int>(record[MSG_DST]);
+                if( dst == ALL_RANKS ) {
+                    for( int node = 0; node < nNodes; ++node )
+                        appendRecord( toNode[node], record, words );
+                } else {
+                    appendRecord( toNode[topology_.node(dst)], record, words );
+                }
+            });
+            std::vector<Index_t> sendbuf, recvbuf;
+            std::vector<int> sendcounts, senddispls, recvcounts(nNodes), recvdispls;
+            flatten( toNode, sendbuf, sendcounts, senddispls );
+            MPI_Alltoall( sendcounts.data(), 1, MPI_INT, recvcounts.data(), 1, MPI_INT, topology_.leaderComm() );
+            recvbuf.resize( displacements(recvcounts, recvdispls) );
+            MPI_Alltoallv( sendbuf.data(), sendcounts.data(), senddispls.data(), MPI_LONG_LONG_INT
+                         , recvbuf.data(), recvcounts.data(), recvdispls.data(), MPI_LONG_LONG_INT
+                         , topology_.leaderComm() );
+
+         // 3. Bundle the records per destination rank on this node.
+            std::vector<std::vector<Index_t>> toLocal(topology_.nodeSize());
+            forEachRecord( recvbuf, [&](Index_t const* record, size_t words)
+            {
+                int src = static_cast<int>(record[MSG_SRC]);
+                int dst = static_cast<int>(record[MSG_DST]);
+                if( dst == ALL_RANKS ) {
+                    for( int local = 0; local < topology_.nodeSize(); ++local ) {
+                        if( topology_.node(src) == topology_.node() && topology_.localRank(src) == local )
+                            continue; // the source does not read its own broadcast messages
+                        appendRecord( toLocal[local], record, words );
+                    }
+                } else {
+                    appendRecord( toLocal[topology_.localRank(dst)], record, words );
+                }
+            });
+            flatten( toLocal, scattered, scounts, sdispls );
+        }
+        MPI_Scatter( scounts.data(), 1, MPI_INT, &count, 1, MPI_INT, 0, nodeComm );
+        records.resize(count);
+        MPI_Scatterv( scattered.data(), scounts.data(), sdispls.data(), MPI_LONG_LONG_INT
+                    , records.data(), count, MPI_LONG_LONG_INT, 0, nodeComm );
+
+     // 4. Append the records to this MessageBuffer. The payloads are copied to the payload arena,
+     //    behind the messages of this rank.
+        Index_t nrecords = 0;
+        Index_t end = payloadUsed_;
+        forEachRecord( records, [&](Index_t const* /*record*/, size_t record_words) {
+            ++nrecords;
+            end = alignWords_(end) + record_words - HEADER_SIZE;
+        });
+        reserveMessages( nmessages_mine + nrecords );
+        reservePayload ( end );
+        forEachRecord( records, [&](Index_t const* record, size_t record_words)
+        {
+            Index_t msg_id = nMessages();
+            incrementNMessages();
+            setMessageSource     (msg_id, record[MSG_SRC]);
+            setMessageDestination(msg_id, record[MSG_DST]);
+            setMessageHandlerKey (msg_id, record[MSG_KEY]);
+            setMessageFlags      (msg_id, record[MSG_FLG]);
+            setMessageLength     (msg_id, record[MSG_LEN]);
+            Index_t begin = alignWords_(payloadUsed_);
+            payloadUsed_ = begin + record_words - HEADER_SIZE;
+            setMessageBegin(msg_id, begin);
+            setMessageEnd  (msg_id, payloadUsed_);
+            memcpy( messagePtr(msg_id), record + HEADER_SIZE, (record_words - HEADER_SIZE)*sizeof(Index_t) );
+        });
+        updateHighWaterMarks_();
+
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            prdbg( tostr("MessageBuffer::broadcastHierarchical_() : node ", topology_.node(), "/", topology_.nNodes()
+                        , ", local rank ", topology_.localRank(), "/", topology_.nodeSize()
+                        , ", received ", nrecords, " messages")
+                 , headersToStr() );
+        }
+    }
+
+    void
+    MessageBuffer::
+    setThreadPool(ThreadPool* pool, size_t chunkSize)
+    {
+        threadPool_ = pool;
+        chunkSize_ = std::max<size_t>(chunkSize, 1);
+    }
+
+    void
+    MessageBuffer::
+    decompressMessages_()
+    {// The messages are decompressed behind the messages in the payload arena, and their headers are
+     // updated to refer to the decompressed messages. The MessageHandlers read them as any other message.
+        if( headersOnly_ )
+            return;
+        Index_t end = payloadUsed_;
+        for( Index_t msg_id = 0; msg_id < nMessages(); ++msg_id ) {
+            if( isIncoming(msg_id) && ( messageFlags(msg_id) & COMPRESSED ) )
+                end = alignWords_(end) + ( compression::decompressedSize(messagePtr(msg_id)) + sizeof(Index_t) - 1 )/sizeof(Index_t);
+        }
+        if( end == payloadUsed_ )
+            return;
+     // Grow the payload arena only once, as that moves it.
+        reservePayload(end);
+
+        typedef std::chrono::steady_clock clock;
+        clock::time_point t0 = clock::now();
+        for( Index_t msg_id = 0; msg_id < nMessages(); ++msg_id )
+        {
+            if( !isIncoming(msg_id) || !( messageFlags(msg_id) & COMPRESSED ) )
+                continue;
+            size_t n = compression::decompressedSize( messagePtr(msg_id) );
+            Index_t begin = alignWords_(payloadUsed_);
+            payloadUsed_ = begin + ( n + sizeof(Index_t) - 1 )/sizeof(Index_t);
+            compression::decompress( &pPayload_[begin], messagePtr(msg_id), messageLength(msg_id) );
+            setMessageBegin (msg_id, begin);
+            setMessageEnd   (msg_id, payloadUsed_);
+            setMessageLength(msg_id, n);
+            setMessageFlags (msg_id, messageFlags(msg_id) & ~COMPRESSED);
+            ++compressionStatistics_.nDecompressed;
+            compressionStatistics_.bytesDecompressed += n;
+        }
+        compressionStatistics_.decompressSeconds += std::chrono::duration<double>(clock::now() - t0).count();
+        updateHighWaterMarks_();
     }
 
     void
     MessageBuffer::
     readMessages()
     {
+        if( threadPool_ ) {
+            readMessages(*threadPool_);
+            return;
+        }
      // Loop over all the received messages.
         for(Index_t msg_id = 0; msg_id < nMessages(); ++msg_id)
         {
-            if( messageSource     (msg_id) != ::mpi12s::rank
-             && messageDestination(msg_id) == ::mpi12s::rank
-              ) {
+            if( isIncoming(msg_id) ) {
                 if constexpr(::mpi12s::_debug_ && _debug_)
                     prdbg( tostr( "MessageBuffer::readMessages() : reading message ", msg_id, "/", nMessages(), ", "
                                 , messageSource(msg_id), "->", messageDestination(msg_id)
                                 )
                          );
              // Fetch the MessageHandler:
-                ::mpi2s::MessageHandlerBase& mh = ::mpi2s::theMessageHandlerRegistry[messageHandlerKey(msg_id)];
+                ::mpi2s::MessageHandlerBase& mh = (*registry_)[messageHandlerKey(msg_id)];
              // read the message
                 mh.readMessage(msg_id);
 
@@ -361,6 +1288,61 @@ namespace mpi12s
         }
     }
 
+    void
+    MessageBuffer::
+    readMessages(ThreadPool& pool)
+    {// Split the incoming messages in segments separated by EXCLUSIVE messages. The messages in a
+     // segment are read concurrently: one task per REENTRANT message, one task per SERIAL
+     // MessageHandler. EXCLUSIVE messages are read by this thread, after the preceding segment
+     // is finished.
+        std::vector<Index_t> reentrant;
+        std::map<::mpi2s::MessageHandlerBase*,std::vector<Index_t>> serial;
+
+        auto readSegment = [&]()
+        {
+            for( Index_t msg_id : reentrant ) {
+                ::mpi2s::MessageHandlerBase* mh = &(*registry_)[messageHandlerKey(msg_id)];
+                pool.submit( [mh,msg_id]() { mh->readMessage(msg_id); } );
+            }
+            for( auto& entry : serial ) {
+                ::mpi2s::MessageHandlerBase* mh = entry.first;
+                std::vector<Index_t>* msg_ids = &entry.second;
+                pool.submit( [mh,msg_ids]() {
+                    for( Index_t msg_id : *msg_ids )
+                        mh->readMessage(msg_id);
+                });
+            }
+            pool.wait();
+            reentrant.clear();
+            serial.clear();
+        };
+
+        for(Index_t msg_id = 0; msg_id < nMessages(); ++msg_id)
+        {
+            if( !isIncoming(msg_id) )
+                continue;
+            ::mpi2s::MessageHandlerBase& mh = (*registry_)[messageHandlerKey(msg_id)];
+            switch( mh.readConcurrency() )
+            {
+                case ::mpi2s::MessageHandlerBase::REENTRANT:
+                    reentrant.push_back(msg_id);
+                    break;
+                case ::mpi2s::MessageHandlerBase::SERIAL:
+                    serial[&mh].push_back(msg_id);
+                    break;
+                case ::mpi2s::MessageHandlerBase::EXCLUSIVE:
+                    readSegment();
+                    mh.readMessage(msg_id);
+                    break;
+            }
+        }
+        readSegment();
+
+        if constexpr(::mpi12s::_debug_ && _debug_)
+            prdbg( tostr( "MessageBuffer::readMessages(pool) : read ", nMessages(), " messages using "
+                        , pool.nWorkers(), " worker threads" ) );
+    }
+
  //------------------------------------------------------------------------------------------------
     MessageBuffer theMessageBuffer;
      // needs to be initialized still.
@@ -4,7 +4,22 @@
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <map>
 #include "types.h"
+#include "NodeTopology.h"
+#include "ExchangeTuner.h"
+#include "ThreadPool.h"
+#include "Transport.h"
+#include "Compression.h"
+
+namespace mpi2s
+{
+    class MessageHandlerRegistry; // forward declaration
+}
 
 
 namespace mpi12s
@@ -21,9 +36,16 @@ namespace mpi12s
     }
  //------------------------------------------------------------------------------------------------
     class MessageBuffer
- // This class encapsulates the buffer for reading and writing messages.  
- // A message consists of a header section and a message section. The header section describes 
- // the messages and their location in the message section.
+ // This class encapsulates the buffers for reading and writing messages.
+ // A message consists of a header and a payload. The headers are stored in the header table, the
+ // payloads in the payload arena. Both are sized independently and, if the memory is owned by the
+ // MessageBuffer, they grow independently when needed. Clearing the MessageBuffer does not release
+ // any memory, so that it can be reused in the next exchange.
+ // The header table is laid out as
+ //     [0]                                    : the number of messages
+ //     [1 + HEADER_SIZE*msgid, HEADER_SIZE[   : the header of message msgid (see enum below)
+ // The MSG_BGN and MSG_END entries of a header are offsets in the payload arena, in Index_t words.
+ // The payloads begin at multiples of payloadAlignment() (a cache line, by default).
  // Used for both the window buffer, and the receiving buffer
  //------------------------------------------------------------------------------------------------
     {
@@ -36,27 +58,92 @@ namespace mpi12s
              , MSG_SRC
              , MSG_DST
              , MSG_KEY
+             , MSG_FLG     // flags, see below
+             , MSG_LEN     // the size of the message in bytes
              , HEADER_SIZE // must be last entry.
              };
+     // Flags of a message (MSG_FLG entry of the header).
+        enum { ZERO_COPY = 1 // the message is not in the payload arena, but is sent from and received into
+                             // the application's arrays with an MPI derived datatype (FLAT mode over MPI only,
+                             // see MessageHandlerBase::postZeroCopyMessage()).
+             , COMPRESSED = 2// the payload is compressed (see MessageHandlerBase::setCompression()). The
+                             // incoming messages are decompressed at the end of the exchange.
+             , DELTA_XOR = 4 // the payload is the XOR of the message and the previous message from the same
+                             // MessageHandler and source (see MessageHandlerBase::setDeltaEncoding()),
+             , DELTA_SUBTRACT = 8 // or the difference of their 32 bit words.
+             , KEYFRAME = 16 // the payload is a full message, the receiver keeps it for the next delta.
+             };
+     // Destination of messages that are broadcast to all ranks (MSG_DST entry of the header).
+     // These are carried by a (non-blocking) tree broadcast rooted at the source, instead of
+     // point-to-point messages, and read on every rank but the source.
+        static int const ALL_RANKS = -1;
+     // A MessageBuffer exchanging messages between the MPI processes, with the MessageHandlers
+     // in ::mpi2s::theMessageHandlerRegistry.
          MessageBuffer();
+     // A MessageBuffer exchanging messages through transport (e.g. an InProcessTransport), with
+     // its own MessageHandler registry (The MessageHandlers must be constructed with this MessageBuffer).
+         MessageBuffer(Transport& transport);
         ~MessageBuffer();
      // allocate memory for the buffer:
         void 
         initialize
-          ( size_t size     // amount to be allocated for the messages, not counting the memory for the header section
-          , size_t max_msgs // maximum number of messages that can be stored.
+          ( size_t size     // initial size of the payload arena, in Index_t words.
+          , size_t max_msgs // initial number of messages that the header table can store.
           );
-     // Assign pre-allocated memory for the buffer
+     // Assign pre-allocated memory for the buffer. Pre-allocated memory cannot grow.
         void 
         initialize
-          ( Index_t * pBuffer // pointer to pre-allocated memory
-          , size_t size       // amount of pre-allocated memory 
-          , size_t max_msgs   // maximum number of messages that can be stored.
+          ( Index_t * pHeaders // pointer to pre-allocated memory for the header table,
+                               // must be at least 1 + max_msgs*HEADER_SIZE words.
+          , size_t max_msgs    // maximum number of messages that can be stored.
+          , Index_t * pPayload // pointer to pre-allocated memory for the payload arena
+          , size_t size        // size of the payload arena, in Index_t words.
           );
 
-     // clear the MessageBuffer
+     // clear the MessageBuffer (the memory is kept for reuse)
         void clear();
 
+     // Make sure that the header table can hold at least n messages. Throws if the header
+     // table must grow, but is not owned by the MessageBuffer.
+        void reserveMessages(size_t n);
+
+     // Make sure that the payload arena can hold at least n Index_t words. Throws if the 
+     // payload arena must grow, but is not owned by the MessageBuffer.
+        void reservePayload(size_t n);
+
+     // Adaptive sizing:
+     // When a message does not fit, an owned header table or payload arena grows geometrically, by 
+     // growthFactor(). If shrinkAfter() > 0, owned memory is shrunk (but never below its initial size)
+     // after shrinkAfter() consecutive quiet steps. A step ends when clear() is called. It is quiet if 
+     // its usage would have fitted in the current capacity divided by growthFactor()^2.
+        inline void   setGrowthFactor(double f) { growthFactor_ = f; }
+        inline double growthFactor() const { return growthFactor_; }
+        inline void   setShrinkAfter(size_t nQuietSteps) { shrinkAfter_ = nQuietSteps; }
+        inline size_t shrinkAfter() const { return shrinkAfter_; }
+
+     // Alignment of the payloads, in bytes (a power of two, and a multiple of sizeof(Index_t)). Every
+     // payload begins at a multiple of the alignment from the start of the payload arena, and an owned
+     // payload arena is allocated with (at least) that alignment, so that the MessageHandlers can use
+     // aligned vector loads and stores, and the payloads of different messages do not share cache
+     // lines. Pre-allocated memory (see initialize()) should be aligned by whoever allocates it. The
+     // alignment can only be changed while there are no messages.
+        static size_t const CACHE_LINE = 64;
+        void   setPayloadAlignment(size_t nBytes);
+        inline size_t payloadAlignment() const { return payloadAlignment_; }
+
+     // High-water marks of the number of messages and of the payload arena usage (in Index_t words).
+        inline Index_t hwmMessages() const { return hwmMessages_; }
+        inline Index_t hwmPayload () const { return hwmPayload_; }
+
+     // Compression statistics: the messages compressed by the MessageHandlers posting in this MessageBuffer
+     // (including those posted from other threads, after the next exchange), and the messages decompressed.
+        inline CompressionStatistics const& compressionStatistics() const { return compressionStatistics_; }
+        inline CompressionStatistics      & compressionStatistics()       { return compressionStatistics_; }
+
+     // Intelligible string representation of the sizing (and compression) statistics of the message buffer
+        std::vector<std::string> // list of lines
+        statisticsToStr() const;
+
      // Allocate resources for a message in the MessageBuffer: 
      //   - reserve space for a message of size sz to be posted
      //   - write a header for that message in the buffer
@@ -68,69 +155,172 @@ namespace mpi12s
           , int      to_rank                  // the destination of the message (=MPI rank)
           , ::mpi12s::MessageHandlerKey_t key   // the key of the object responsible for reading the message
           , Index_t* msgid = nullptr          // on return contains the id of the allocated message, if provided
+          , Index_t  flags = 0                // flags of the message, for ZERO_COPY messages no room is reserved
+          );                                  // in the payload arena.
+
+     // Set the indices of the elements of ZERO_COPY message msgid. The MPI derived datatype for sending
+     // it (with buffer MPI_BOTTOM) is created by its MessageHandler when the message is sent (see
+     // MessageHandlerBase::zeroCopySendDatatype()).
+        void setZeroCopyIndices(Index_t msgid, std::vector<Index_t>&& indices);
+
+     // The MessageBuffer to post messages in, from the calling thread.
+     // allocateMessage() and addMessageDestination() are not thread-safe. Threads other than the thread 
+     // that initialized the MessageBuffer get their own sub-buffer, in which they can post messages without
+     // any synchronization. The sub-buffers are merged into this MessageBuffer at the beginning of the
+     // next exchange (broadcast()), which must be called outside the parallel region.
+        MessageBuffer& postingBuffer();
+
+     // Add a destination to an allocated message (multicast). This adds a header for to_rank which
+     // refers to the payload of message msgid, so the payload is stored (and packed) only once, and
+     // the same memory is sent to every destination. The headers of a multicast message thus form 
+     // its destination list.
+        Index_t              // returns the id of the header added
+        addMessageDestination
+          ( Index_t msgid    // id of the message, as returned by allocateMessage()
+          , int     to_rank  // the additional destination (=MPI rank)
           );
 
+     // Strategies for exchanging the messages in broadcast():
+        enum ExchangeMode
+          { FLAT         // broadcast the headers, point-to-point messages between the ranks.
+          , ONESIDED     // broadcast the headers, the destinations MPI_Get the messages from the sources.
+          , HIERARCHICAL // node-aware: the ranks hand their messages to their node leader, the leaders
+                         // exchange one aggregated bundle per pair of nodes, and scatter the messages
+                         // they received to the ranks on their node.
+          , AUTO         // time the strategies above during the first exchanges, and use the fastest
+                         // one, until the traffic pattern shifts (see ExchangeTuner).
+          };
+        static char const* exchangeModeName(ExchangeMode mode);
+        void
+        setExchangeMode
+          ( ExchangeMode mode
+          , int ranksPerNode = 0 // HIERARCHICAL and AUTO only: see NodeTopology::initialize().
+          );                     // Only FLAT is available if the transport is not MPI.
+        inline ExchangeMode exchangeMode() const { return exchangeMode_; }
+     // The strategy used by the last exchange (differs from exchangeMode() if that is AUTO).
+        inline ExchangeMode lastExchangeMode() const { return lastExchangeMode_; }
+     // The tuner used in AUTO mode.
+        inline ExchangeTuner& exchangeTuner() { return tuner_; }
+
+     // The transport, and the rank and number of ranks it connects.
+        inline Transport& transport() { return *transport_; }
+        inline int rank  () const { return transport_->rank(); }
+        inline int nRanks() const { return transport_->size(); }
+     // The registry of the MessageHandlers reading the messages of this MessageBuffer
+        inline ::mpi2s::MessageHandlerRegistry& handlerRegistry() { return *registry_; }
+
      // Broadcast my headers to all other processes, process the headers and
      // fetch the messages which are for me.
      // This function must be called on all processes.
         void broadcast();
 
+     // Non-blocking broadcast: startBroadcast() exchanges the headers (which is blocking, but cheap), and
+     // starts the transfer of the messages. The messages are available after finishBroadcast(). Meanwhile
+     // the application can compute, but not post messages in this MessageBuffer (posting from other 
+     // threads, in their sub-buffers, is fine). The transfer progresses while the application computes only
+     // if it calls testBroadcast() now and then, or if MPI was initialized with a progress thread (see 
+     // ::mpi12s::init()).
+     // Only the FLAT exchange mode is non-blocking, in the other modes startBroadcast() does the entire
+     // broadcast(), and finishBroadcast() has nothing left to do.
+     // These functions must be called on all processes.
+        void startBroadcast();
+        bool testBroadcast(); // true if the transfer is complete (finishBroadcast() must still be called).
+        void finishBroadcast();
+        inline bool broadcastInProgress() const { return broadcastInProgress_; }
+
      // Read all the messages (to be called after broadcast()).
         void readMessages();
+     // Read all the messages, using the threads of pool, as far as the ReadConcurrency of the 
+     // MessageHandlers allows (see MessageHandlerBase::readConcurrency()). EXCLUSIVE messages
+     // are read in order with respect to all other messages, SERIAL messages in order with respect
+     // to the other messages of their MessageHandler, REENTRANT messages in any order.
+        void readMessages(ThreadPool& pool);
+
+     // Pack and unpack in parallel: if a ThreadPool is set, readMessages() reads the messages as
+     // readMessages(*pool), and the MessageHandlers pack and unpack their messages in chunks of
+     // chunkSize bytes, executed by pool (see Message::write(ptr, pool, chunkSize)). Messages may
+     // then also be posted by tasks of pool. Pass nullptr to switch this off.
+        static size_t const DEFAULT_CHUNK_SIZE = 1<<16;
+        void setThreadPool(ThreadPool* pool, size_t chunkSize = DEFAULT_CHUNK_SIZE);
+        inline ThreadPool* threadPool() const { return threadPool_; }
+        inline size_t chunkSize() const { return chunkSize_; }
 
      // Member functions for reading message headers from a buffer (getters).
      // This can be the buffer in the MPI window of this MessageBox, or a buffer 
      // read from other processes' MPI window. (see member functions getHeaderFromRank
      // and getHeaderFromAllRanks below).
      // Getters:
-        inline Index_t   nMessages() const { return  pBuffer_[0]; }
+        inline Index_t   nMessages() const { return  pHeaders_[0]; }
         inline Index_t maxMessages() const { return maxmsgs_; }
-        inline Index_t headerSize () const { return (pBuffer_[1]); }
-         // pBuffer_[1] contains the location of the begin of the first message. For that reason it
-         // is equal to the size of the header section. It is, however, NOT the size of the part of
-         // the header section that is in used.
-         inline Index_t headerSizeUsed() const { return 1 + nMessages()*HEADER_SIZE; }
-
-        inline Index_t messageBegin       (Index_t msgid) const { return pBuffer_[1 + HEADER_SIZE * msgid + MSG_BGN]; }
-        inline Index_t messageEnd         (Index_t msgid) const { return pBuffer_[1 + HEADER_SIZE * msgid + MSG_END]; }
-        inline int     messageDestination (Index_t msgid) const { return pBuffer_[1 + HEADER_SIZE * msgid + MSG_DST]; }
-        inline int     messageSource      (Index_t msgid) const { return pBuffer_[1 + HEADER_SIZE * msgid + MSG_SRC]; }
-        inline Index_t messageHandlerKey  (Index_t msgid) const { return pBuffer_[1 + HEADER_SIZE * msgid + MSG_KEY]; }
-
-        inline Index_t messageSize  (Index_t msgid) const { return (messageEnd(msgid) - messageBegin(msgid))*sizeof(Index_t); } // in bytes
-        inline void*   messagePtr   (Index_t msgid) const { return &pBuffer_[messageBegin(msgid)]; }
-        inline void*   messagePtrEnd(Index_t msgid) const { return &pBuffer_[messageEnd  (msgid)]; }
+     // Size of the header table, in Index_t words. This is NOT the size of the part of the header
+     // table that is in use.
+        inline Index_t headerSize () const { return 1 + maxmsgs_*HEADER_SIZE; }
+        inline Index_t headerSizeUsed() const { return 1 + nMessages()*HEADER_SIZE; }
+     // Size of the payload arena, in Index_t words, and the part of it that is in use.
+        inline Index_t payloadSize    () const { return payloadSize_; }
+        inline Index_t payloadSizeUsed() const { return payloadUsed_; }
+
+        inline Index_t messageBegin       (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_BGN]; }
+        inline Index_t messageEnd         (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_END]; }
+        inline int     messageDestination (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_DST]; }
+        inline int     messageSource      (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_SRC]; }
+        inline Index_t messageHandlerKey  (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_KEY]; }
+        inline Index_t messageFlags       (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_FLG]; }
+        inline Index_t messageLength      (Index_t msgid) const { return pHeaders_[1 + HEADER_SIZE * msgid + MSG_LEN]; } // in bytes
+        inline bool    isZeroCopy         (Index_t msgid) const { return messageFlags(msgid) & ZERO_COPY; }
+
+        inline Index_t messageSize  (Index_t msgid) const { return messageWords(msgid)*sizeof(Index_t); } // in bytes
+        inline Index_t messageWords (Index_t msgid) const { return messageEnd(msgid) - messageBegin(msgid); } // in Index_t words
+     // Is message msgid a message from another rank for this rank (point-to-point or broadcast)?
+        inline bool    isIncoming   (Index_t msgid) const {
+            return messageSource(msgid) != rank()
+               && ( messageDestination(msgid) == rank() || messageDestination(msgid) == ALL_RANKS );
+        }
+        inline void*   messagePtr   (Index_t msgid) const { return &pPayload_[messageBegin(msgid)]; }
+        inline void*   messagePtrEnd(Index_t msgid) const { return &pPayload_[messageEnd  (msgid)]; }
 
      // The setters work only on the buffer in the MPI window
         inline void
         setMessageBegin(Index_t msgid, Index_t messageBegin) { 
-            pBuffer_[1 + HEADER_SIZE * msgid + MSG_BGN] = messageBegin;
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_BGN] = messageBegin;
         }
         inline void 
         setMessageEnd(Index_t msgid, Index_t messageEnd) {
-            pBuffer_[1 + HEADER_SIZE *  msgid    + MSG_END] = messageEnd;
-            pBuffer_[1 + HEADER_SIZE * (msgid+1) + MSG_BGN] = messageEnd; // end of message is begin of next message.
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_END] = messageEnd;
         }
         inline void 
         setMessageDestination(Index_t msgid, Index_t messageDest) {
-            pBuffer_[1 + HEADER_SIZE * msgid + MSG_DST] = messageDest;
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_DST] = messageDest;
         }
         inline void 
         setMessageSource(Index_t msgid, Index_t messageDest) {
-            pBuffer_[1 + HEADER_SIZE * msgid + MSG_SRC] = messageDest;
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_SRC] = messageDest;
         }
         inline void 
         setMessageHandlerKey(Index_t msgid, Index_t key) {
-            pBuffer_[1 + HEADER_SIZE * msgid + MSG_KEY] = key;
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_KEY] = key;
+        }
+        inline void
+        setMessageFlags(Index_t msgid, Index_t flags) {
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_FLG] = flags;
+        }
+        inline void
+        setMessageLength(Index_t msgid, Index_t length) {
+            pHeaders_[1 + HEADER_SIZE * msgid + MSG_LEN] = length;
         }
         inline void
         incrementNMessages(Index_t inc = 1) {
-            pBuffer_[0] += inc;
+            pHeaders_[0] += inc;
+        }
+     // pointer to the raw header table
+        inline Index_t* 
+        headersPtr() const {
+            return pHeaders_;
         }
-     // pointer to the raw buffer 
+     // pointer to the raw payload arena
         inline Index_t* 
-        ptr() const {
-            return pBuffer_;
+        payloadPtr() const {
+            return pPayload_;
         }
          
      // Intelligible string representation of the header section of the message buffer
@@ -150,14 +340,100 @@ namespace mpi12s
 
     private:
         void initialize_();
+     // Append the messages posted by other threads to this MessageBuffer, and clear their sub-buffers.
+        void mergeThreadBuffers_();
+     // The implementations of broadcast() for the different exchange modes.
+        void broadcast_(ExchangeMode mode);
+        void broadcastFlat_();
+        void startBroadcastFlat_();
+        void broadcastOneSided_();
+        void broadcastHierarchical_();
+     // Helpers for the exchange modes that broadcast the headers (FLAT and ONESIDED)
+        void exchangeHeaders_
+          ( std::vector<Index_t>& nmessages_per_rank
+          , std::vector<Index_t>& first_msg_of_rank
+          );
+     // Start the (non-blocking) broadcasts of the ALL_RANKS messages, completed by transport_->waitAll().
+        void startBroadcastMessages_
+          ( std::vector<Index_t> const& nmessages_per_rank
+          , std::vector<Index_t> const& first_msg_of_rank
+          );
+     // (Re)create the MPI window on the payload arena (ONESIDED), collective.
+        void exposePayload_();
+     // Update the high-water marks with the current usage.
+        void updateHighWaterMarks_();
+     // Reallocate the owned header table or payload arena, preserving the part in use.
+        void reallocateHeaders_(size_t max_msgs);
+        void reallocatePayload_(size_t size);
+     // Allocate and free an owned payload arena, with the payload alignment.
+        Index_t* allocatePayload_(size_t size);
+        void freePayload_();
+     // n Index_t words rounded up to the payload alignment.
+        inline Index_t alignWords_(Index_t n) const {
+            Index_t const a = payloadAlignment_/sizeof(Index_t);
+            return ( (n + a - 1)/a )*a;
+        }
 
-    public:
-        Index_t *pBuffer_;
     private:
-        size_t bufferSize_;
-        bool bufferOwned_;
-        bool headersOnly_;
-        size_t maxmsgs_;
+        Index_t *pHeaders_;   // the header table
+        size_t   maxmsgs_;    // number of messages the header table can hold
+        bool     headersOwned_;
+        Index_t *pPayload_;   // the payload arena
+        size_t   payloadSize_;// size of the payload arena, in Index_t words
+        Index_t  payloadUsed_;// number of Index_t words in use in the payload arena
+        bool     payloadOwned_;
+        bool     headersOnly_;
+        size_t   payloadAlignment_; // in bytes
+        size_t   arenaAlignment_;   // the alignment with which the owned payload arena was allocated
+     // posting from multiple threads
+        size_t          id_;          // unique id, identifies the MessageBuffer in the per-thread caches
+        std::thread::id ownerThread_; // the thread that initialized the MessageBuffer
+        std::mutex      threadBuffersMutex_;
+        std::vector<std::unique_ptr<MessageBuffer>> threadBuffers_; // the sub-buffers of the other threads
+        static std::atomic<size_t> nextId_;
+     // exchange mode
+        ExchangeMode exchangeMode_;
+        ExchangeMode lastExchangeMode_;
+        int          ranksPerNode_;
+        NodeTopology topology_;
+        ExchangeTuner tuner_;
+        MPI_Win      payloadWindow_; // window on the payload arena (ONESIDED)
+        Index_t     *windowBase_;    // the payload arena exposed by payloadWindow_
+        size_t       windowSize_;
+     // transport
+        Transport*   transport_;
+        std::unique_ptr<Transport> ownedTransport_;
+        ::mpi2s::MessageHandlerRegistry* registry_;
+        std::unique_ptr<::mpi2s::MessageHandlerRegistry> ownedRegistry_;
+     // parallel packing and unpacking
+        ThreadPool*  threadPool_;
+        size_t       chunkSize_;
+     // non-blocking broadcast
+        bool         broadcastInProgress_;
+        Index_t      nMessagesMine_; // the number of messages posted by this rank in the current broadcast
+     // zero-copy messages
+        std::map<Index_t,std::vector<Index_t>> zeroCopyIndices_; // the indices of the ZERO_COPY messages to send
+     // Provide the target slots for the incoming ZERO_COPY messages, and create their datatypes.
+        std::map<Index_t,MPI_Datatype> zeroCopyReceiveDatatypes_();
+     // compression
+        CompressionStatistics compressionStatistics_;
+     // Decompress the incoming COMPRESSED messages (at the end of the exchange).
+        void decompressMessages_();
+     // adaptive sizing
+        double   growthFactor_;
+        size_t   shrinkAfter_;
+        size_t   initialMaxmsgs_;
+        size_t   initialPayloadSize_;
+     // statistics
+        Index_t  hwmMessages_;     // high-water mark of the number of messages
+        Index_t  hwmPayload_;      // high-water mark of the payload arena usage
+        Index_t  quietHwmMessages_;// high-water marks during the current sequence of quiet steps
+        Index_t  quietHwmPayload_;
+        size_t   quietSteps_;      // number of consecutive quiet steps
+        size_t   nSteps_;
+        size_t   nGrowHeaders_;
+        size_t   nGrowPayload_;
+        size_t   nShrinks_;
      };
  //------------------------------------------------------------------------------------------------
     extern MessageBuffer theMessageBuffer;
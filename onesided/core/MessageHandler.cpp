@@ -1,5 +1,7 @@
 #include "MessageHandler.h"
 
+#include <chrono>
+
 namespace mpi1s
 {
  //------------------------------------------------------------------------------------------------
@@ -88,9 +90,18 @@ namespace mpi2s
  // MessageHandlerRegistry implementation
  //------------------------------------------------------------------------------------------------
     MessageHandlerBase::
-    MessageHandlerBase()
+    MessageHandlerBase
+      ( ::mpi12s::MessageBuffer& messageBuffer
+      )
+      : messageBuffer_(messageBuffer)
+      , compressionThreshold_(0)
+      , compressionTypeSize_(sizeof(float))
+      , deltaEncoding_(NO_DELTA)
+      , keyframeInterval_(16)
+      , nKeyframesPosted_(0)
+      , nDeltasPosted_(0)
     {
-        theMessageHandlerRegistry.registerMessageHandler(this);
+        messageBuffer_.handlerRegistry().registerMessageHandler(this);
     }
 
     MessageHandlerBase::
@@ -103,27 +114,360 @@ namespace mpi2s
     void
     MessageHandlerBase::
     postMessage(int to_rank)
+    {
+        postMessage( message_, to_rank );
+    }
+
+    void
+    MessageHandlerBase::
+    postMessage
+      ( ::mpi12s::Message const& message
+      , int to_rank
+      )
     {// construct the message, and put the message in the messageBuffer
-     // compute the length of the message:
-        Index_t sz = ::mpi12s::convertSizeInBytes<sizeof(Index_t)>(message_.messageSize());
+     // compute the length of the message (which may depend on the destination):
+        message.setPeer(to_rank);
+        Index_t sz = ::mpi12s::convertSizeInBytes<sizeof(Index_t)>(message.messageSize());
+        if( deltaEncoding_ != NO_DELTA ) {
+            postDelta_( message, sz, to_rank );
+            return;
+        }
+        if( compress_(sz) ) {
+            postCompressed_( sz, to_rank, [this, &message](void*& ptr) { write_(message, ptr); } );
+            return;
+        }
      // allocate memory space for the message in the message buffer, and write the header
-     // for the message in the message buffer
-        int const from_rank = ::mpi12s::rank;
+     // for the message in the message buffer. (The message buffer of the calling thread.)
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        int const from_rank = messageBuffer_.rank();
         Index_t msg_id = -1;
-        void* ptr = ::mpi12s::theMessageBuffer.allocateMessage( sz, from_rank, to_rank, key_, &msg_id );
+        void* ptr = messageBuffer.allocateMessage( sz, from_rank, to_rank, key_, &msg_id );
      // Write the message in the message buffer
-        message_.write(ptr);
+        write_(message, ptr);
 
         if constexpr(::mpi12s::_debug_ && _debug_) {
             ::mpi12s::prdbg
               ( ::mpi12s::tostr("MessageHandlerBase::postMessage() : headers (current msg_id=", msg_id, ")")
-              , ::mpi12s::theMessageBuffer.headersToStr()
+              , messageBuffer.headersToStr()
               );
             ::mpi12s::prdbg
               ( ::mpi12s::tostr("MessageHandlerBase::postMessage() : message (current msg_id=", msg_id, ")")
-              , ::mpi12s::theMessageBuffer.messageToStr(msg_id)
+              , messageBuffer.messageToStr(msg_id)
+              );
+        }
+    }
+
+    void*
+    MessageHandlerBase::
+    allocateMessage_(size_t nBytes, int to_rank)
+    {
+        Index_t sz = ::mpi12s::convertSizeInBytes<sizeof(Index_t)>(nBytes);
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        Index_t msg_id = -1;
+        void* ptr = messageBuffer.allocateMessage( sz, messageBuffer_.rank(), to_rank, key_, &msg_id );
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            ::mpi12s::prdbg
+              ( ::mpi12s::tostr("MessageHandlerBase::allocateMessage_() : headers (current msg_id=", msg_id, ")")
+              , messageBuffer.headersToStr()
+              );
+        }
+        return ptr;
+    }
+
+    void
+    MessageHandlerBase::
+    postMessage(std::span<const int> to_ranks)
+    {// construct the message once, and put it in the messageBuffer for all destinations
+        if( to_ranks.empty() )
+            return;
+        message_.setPeer(::mpi12s::MessageBuffer::ALL_RANKS); // the same message for all destinations
+        Index_t sz = ::mpi12s::convertSizeInBytes<sizeof(Index_t)>(message_.messageSize());
+        int const from_rank = messageBuffer_.rank();
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        Index_t msg_id = -1;
+        if( compress_(sz) )
+            msg_id = postCompressed_( sz, to_ranks[0], [this](void*& ptr) { write_(message_, ptr); } );
+        else {
+            void* ptr = messageBuffer.allocateMessage( sz, from_rank, to_ranks[0], key_, &msg_id );
+            write_(message_, ptr);
+        }
+     // The other destinations share the payload:
+        for( size_t i = 1; i < to_ranks.size(); ++i )
+            messageBuffer.addMessageDestination( msg_id, to_ranks[i] );
+
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            ::mpi12s::prdbg
+              ( ::mpi12s::tostr("MessageHandlerBase::postMessage(to_ranks) : headers (current msg_id=", msg_id, ", ", to_ranks.size(), " destinations)")
+              , messageBuffer.headersToStr()
+              );
+        }
+    }
+
+    void
+    MessageHandlerBase::
+    write_(::mpi12s::Message const& message, void*& ptr)
+    {
+        if( ::mpi12s::ThreadPool* pool = messageBuffer_.threadPool() )
+            message.write( ptr, *pool, messageBuffer_.chunkSize() );
+        else
+            message.write(ptr);
+    }
+
+    void
+    MessageHandlerBase::
+    setCompression(size_t threshold, size_t typeSize)
+    {
+        compressionThreshold_ = threshold;
+        compressionTypeSize_ = std::max<size_t>(typeSize, 1);
+    }
+
+    Index_t
+    MessageHandlerBase::
+    postCompressed_(size_t sz, int to_rank, std::function<void(void*& ptr)> const& write, Index_t flags)
+    {// scratch buffers, per thread, as messages may be posted concurrently.
+        thread_local std::vector<Index_t> uncompressed, compressed;
+        uncompressed.resize( ( sz + sizeof(Index_t) - 1 )/sizeof(Index_t) );
+        compressed  .resize( ( ::mpi12s::compression::compressBound(sz) + sizeof(Index_t) - 1 )/sizeof(Index_t) );
+        if( !uncompressed.empty() )
+            uncompressed.back() = 0; // sz may be rounded up to a whole number of words
+        void* ptr = uncompressed.data();
+        write(ptr);
+
+        typedef std::chrono::steady_clock clock;
+        clock::time_point t0 = clock::now();
+        size_t csz = ::mpi12s::compression::compress( compressed.data(), uncompressed.data(), sz, compressionTypeSize_ );
+        double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        ::mpi12s::CompressionStatistics& statistics = messageBuffer.compressionStatistics();
+        statistics.compressSeconds += seconds;
+        Index_t msg_id = -1;
+        if( csz > 0 ) {
+            void* dst = messageBuffer.allocateMessage( csz, messageBuffer_.rank(), to_rank, key_, &msg_id
+                                                     , ::mpi12s::MessageBuffer::COMPRESSED | flags );
+            ::mpi12s::simd::copy( dst, compressed.data(), csz );
+            ++statistics.nCompressed;
+            statistics.bytesIn  += sz;
+            statistics.bytesOut += csz;
+        } else {
+            void* dst = messageBuffer.allocateMessage( sz, messageBuffer_.rank(), to_rank, key_, &msg_id, flags );
+            ::mpi12s::simd::copy( dst, uncompressed.data(), sz );
+            ++statistics.nIncompressible;
+        }
+        if constexpr(::mpi12s::_debug_ && _debug_) {
+            ::mpi12s::prdbg
+              ( ::mpi12s::tostr("MessageHandlerBase::postCompressed_() : ", sz, " -> ", csz, " bytes (current msg_id=", msg_id, ")")
+              , messageBuffer.headersToStr()
               );
         }
+        return msg_id;
+    }
+
+    namespace
+    {// The delta kernels, on whole words (the messages are a whole number of Index_t words).
+        void xorWords(Index_t* dst, Index_t const* a, Index_t const* b, size_t nWords)
+        {
+            for( size_t i = 0; i < nWords; ++i )
+                dst[i] = a[i] ^ b[i];
+        }
+     // dst = a - b (sign = -1), or a + b (sign = +1), per 32 bit word
+        void addWords32(Index_t* dst, Index_t const* a, Index_t const* b, size_t nWords, int sign)
+        {
+            uint32_t* d = reinterpret_cast<uint32_t*>(dst);
+            uint32_t const* x = reinterpret_cast<uint32_t const*>(a);
+            uint32_t const* y = reinterpret_cast<uint32_t const*>(b);
+            size_t n = nWords*sizeof(Index_t)/sizeof(uint32_t);
+            if( sign < 0 )
+                for( size_t i = 0; i < n; ++i )
+                    d[i] = x[i] - y[i];
+            else
+                for( size_t i = 0; i < n; ++i )
+                    d[i] = x[i] + y[i];
+        }
+    }
+
+    void
+    MessageHandlerBase::
+    setDeltaEncoding(DeltaEncoding deltaEncoding, size_t keyframeInterval)
+    {
+        std::lock_guard<std::mutex> lock(deltaMutex_);
+        deltaEncoding_ = deltaEncoding;
+        keyframeInterval_ = std::max<size_t>(keyframeInterval, 1);
+        deltaSent_.clear();
+    }
+
+    void
+    MessageHandlerBase::
+    resetDeltaEncoding()
+    {
+        std::lock_guard<std::mutex> lock(deltaMutex_);
+        deltaSent_.clear();
+    }
+
+    void
+    MessageHandlerBase::
+    postDelta_(::mpi12s::Message const& message, size_t sz, int to_rank)
+    {// scratch buffers, per thread, as messages may be posted concurrently (to different destinations).
+        thread_local std::vector<Index_t> current, delta;
+        size_t nWords = sz/sizeof(Index_t);
+        current.resize(nWords);
+        if( nWords )
+            current.back() = 0; // the message may not fill the last word
+        void* ptr = current.data();
+        write_(message, ptr);
+
+        Index_t flags = ::mpi12s::MessageBuffer::KEYFRAME;
+        Index_t const* payload = current.data();
+        {
+            std::lock_guard<std::mutex> lock(deltaMutex_);
+            DeltaCache_t& cache = deltaSent_[to_rank];
+            if( cache.count > 0 && cache.count < keyframeInterval_ && cache.previous.size() == nWords )
+            {
+                delta.resize(nWords);
+                if( deltaEncoding_ == XOR_DELTA ) {
+                    xorWords( delta.data(), current.data(), cache.previous.data(), nWords );
+                    flags = ::mpi12s::MessageBuffer::DELTA_XOR;
+                } else {
+                    addWords32( delta.data(), current.data(), cache.previous.data(), nWords, -1 );
+                    flags = ::mpi12s::MessageBuffer::DELTA_SUBTRACT;
+                }
+                payload = delta.data();
+                ++cache.count;
+                ++nDeltasPosted_;
+            } else {
+                cache.count = 1;
+                ++nKeyframesPosted_;
+            }
+            cache.previous.assign( current.begin(), current.end() );
+        }
+
+        if( compress_(sz) ) {
+            postCompressed_( sz, to_rank, [payload, sz](void*& ptr) { memcpy(ptr, payload, sz); }, flags );
+            return;
+        }
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        Index_t msg_id = -1;
+        void* dst = messageBuffer.allocateMessage( sz, messageBuffer_.rank(), to_rank, key_, &msg_id, flags );
+        ::mpi12s::simd::copy( dst, payload, sz );
+    }
+
+    void
+    MessageHandlerBase::
+    undoDelta_(Index_t msg_id)
+    {
+        Index_t flags = messageBuffer_.messageFlags(msg_id);
+        Index_t const DELTA = ::mpi12s::MessageBuffer::DELTA_XOR | ::mpi12s::MessageBuffer::DELTA_SUBTRACT;
+        if( !( flags & ( DELTA | ::mpi12s::MessageBuffer::KEYFRAME ) ) )
+            return;
+        Index_t* ptr = static_cast<Index_t*>( messageBuffer_.messagePtr(msg_id) );
+        size_t nWords = messageBuffer_.messageWords(msg_id);
+        std::lock_guard<std::mutex> lock(deltaMutex_);
+        DeltaCache_t& cache = deltaReceived_[ { messageBuffer_.messageSource(msg_id), messageBuffer_.messageDestination(msg_id) } ];
+        if( flags & DELTA )
+        {
+            if( cache.previous.size() != nWords ) {
+                std::string errmsg = ::mpi12s::info + "MessageHandlerBase::undoDelta_() : delta message without matching keyframe.";
+                throw std::runtime_error(errmsg);
+            }
+            if( flags & ::mpi12s::MessageBuffer::DELTA_XOR )
+                xorWords( ptr, ptr, cache.previous.data(), nWords );
+            else
+                addWords32( ptr, ptr, cache.previous.data(), nWords, +1 );
+         // A message is only reconstructed once
+            messageBuffer_.setMessageFlags( msg_id, ( flags & ~DELTA ) & ~::mpi12s::MessageBuffer::KEYFRAME );
+        } else
+            messageBuffer_.setMessageFlags( msg_id, flags & ~::mpi12s::MessageBuffer::KEYFRAME );
+        cache.previous.assign( ptr, ptr + nWords );
+    }
+
+    void
+    MessageHandlerBase::
+    postMessageToAll()
+    {
+        postMessage( ::mpi12s::MessageBuffer::ALL_RANKS );
+    }
+
+    namespace
+    {// Create an MPI derived datatype for the indexed blocks, with absolute addresses (use MPI_BOTTOM
+     // as buffer). Every block is an MPI_Type_create_indexed_block of its indices, with the element
+     // as a contiguous type of elementSize bytes, and the blocks are combined by MPI_Type_create_struct.
+        MPI_Datatype
+        createIndexedDatatype(::mpi12s::IndexedBlocks_t const& blocks)
+        {
+            int const nblocks = static_cast<int>(blocks.size());
+            std::vector<MPI_Datatype> types(nblocks);
+            std::vector<MPI_Aint> addresses(nblocks);
+            std::vector<int> blocklengths(nblocks, 1);
+            std::vector<int> displacements;
+            for( int b = 0; b < nblocks; ++b )
+            {
+                ::mpi12s::IndexedBlock const& block = blocks[b];
+                MPI_Datatype element;
+                MPI_Type_contiguous( static_cast<int>(block.elementSize), MPI_BYTE, &element );
+                displacements.assign( block.indices, block.indices + block.n );
+                MPI_Type_create_indexed_block
+                  ( static_cast<int>(displacements.size()), 1, displacements.data(), element, &types[b] );
+                MPI_Type_free(&element);
+                MPI_Get_address( block.array, &addresses[b] );
+            }
+            MPI_Datatype datatype;
+            MPI_Type_create_struct( nblocks, blocklengths.data(), addresses.data(), types.data(), &datatype );
+            MPI_Type_commit(&datatype);
+            for( MPI_Datatype& type : types )
+                MPI_Type_free(&type);
+            return datatype;
+        }
+    }
+
+    void
+    MessageHandlerBase::
+    postZeroCopyMessage(int to_rank)
+    {
+        if( !messageBuffer_.transport().isMpi() || messageBuffer_.exchangeMode() != ::mpi12s::MessageBuffer::FLAT ) {
+            std::string errmsg = ::mpi12s::info + "MessageHandlerBase::postZeroCopyMessage() : zero-copy messages "
+                                 "require the FLAT exchange mode over MPI.";
+            throw std::runtime_error(errmsg);
+        }
+        ::mpi12s::IndexedBlocks_t blocks;
+        size_t nBytes = message_.sendBlocks(blocks);
+        ::mpi12s::MessageBuffer& messageBuffer = messageBuffer_.postingBuffer();
+        Index_t msg_id = -1;
+        messageBuffer.allocateMessage( nBytes, messageBuffer_.rank(), to_rank, key_, &msg_id
+                                     , ::mpi12s::MessageBuffer::ZERO_COPY );
+     // The datatype is created when the message is sent, the arrays may still move until then.
+        messageBuffer.setZeroCopyIndices( msg_id, std::vector<Index_t>( blocks[0].indices, blocks[0].indices + blocks[0].n ) );
+    }
+
+    MPI_Datatype
+    MessageHandlerBase::
+    zeroCopySendDatatype(std::vector<Index_t> const& indices)
+    {
+        ::mpi12s::IndexedBlocks_t blocks;
+        message_.sendBlocks(blocks);
+        for( ::mpi12s::IndexedBlock& block : blocks ) {
+            block.indices = indices.data();
+            block.n = indices.size();
+        }
+        return createIndexedDatatype(blocks);
+    }
+
+    void
+    MessageHandlerBase::
+    provideZeroCopySlots(std::vector<size_t> const& nBytes)
+    {
+        message_.provideSlots(nBytes);
+    }
+
+    std::vector<MPI_Datatype>
+    MessageHandlerBase::
+    zeroCopyReceiveDatatypes(std::vector<size_t> const& nBytes)
+    {
+        std::vector<::mpi12s::IndexedBlocks_t> blocks;
+        message_.receiveBlocks(nBytes, blocks);
+        std::vector<MPI_Datatype> datatypes;
+        for( ::mpi12s::IndexedBlocks_t const& message_blocks : blocks )
+            datatypes.push_back( createIndexedDatatype(message_blocks) );
+        return datatypes;
     }
 
     bool               // true if the MessageHandlerKey value in the message header
@@ -134,13 +478,32 @@ namespace mpi2s
     readMessage
       ( Index_t msg_id // the message id identifies the message header
       )
+    {
+        return readMessage( message_, msg_id );
+    }
+
+    bool
+    MessageHandlerBase::
+    readMessage
+      ( ::mpi12s::Message& message
+      , Index_t msg_id
+      )
     {// Verify that this is the correct MessageHandler for this message
-        if( ::mpi12s::theMessageBuffer.messageHandlerKey(msg_id) != key_)
+        if( static_cast<key_type>(messageBuffer_.messageHandlerKey(msg_id)) != key_ )
             return false;
+     // Zero-copy messages are received in place
+        if( messageBuffer_.isZeroCopy(msg_id) )
+            return true;
+     // Delta encoded messages are reconstructed first
+        undoDelta_(msg_id);
 
      // Read
-        void* ptr = ::mpi12s::theMessageBuffer.messagePtr(msg_id);
-        message_.read(ptr);
+        message.setPeer( messageBuffer_.messageSource(msg_id) );
+        void* ptr = messageBuffer_.messagePtr(msg_id);
+        if( ::mpi12s::ThreadPool* pool = messageBuffer_.threadPool() )
+            message.read( ptr, *pool, messageBuffer_.chunkSize() );
+        else
+            message.read(ptr);
 
         return true;
     }
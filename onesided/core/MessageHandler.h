@@ -2,9 +2,14 @@
 #define MESSAGEHANDLER_H
 
 #include <map>
+#include <mutex>
+#include <span>
 #include "types.h"
 //#include "MessageBox.h"
 #include "Message.h"
+#include "PropertySet.h"
+#include "Encoding.h"
+#include "MessageBuffer.h"
 
 namespace mpi1s
 {
@@ -117,7 +122,11 @@ namespace mpi2s
 
      // the MessageHandler typically lives as long as a simulation. It is practical to store a
      // reference to it.
-        MessageHandlerBase();
+     // The MessageHandler posts its messages in messageBuffer, and is registered in the
+     // registry of messageBuffer.
+        MessageHandlerBase
+          ( ::mpi12s::MessageBuffer& messageBuffer = ::mpi12s::theMessageBuffer
+          );
         virtual ~MessageHandlerBase();
 
      // Post the message in the messageBuffer
@@ -126,6 +135,98 @@ namespace mpi2s
           ( int to_rank // destination of the message (some MPI rank).
           );
 
+     // Post a message other than message() in the messageBuffer. This is meant for posting from several
+     // threads concurrently (message() is shared by all threads). Each thread must use its own message.
+        void postMessage
+          ( ::mpi12s::Message const& message // the message to post.
+          , int to_rank                      // destination of the message (some MPI rank).
+          );
+
+     // Post a StaticMessage in the messageBuffer. Thread-safe, as postMessage(message, to_rank) above.
+        template<typename... Ts>
+        void postMessage
+          ( ::mpi12s::StaticMessage<Ts...> const& message // the message to post.
+          , int to_rank                                   // destination of the message (some MPI rank).
+          )
+        {
+            if( compress_(message.messageSize()) ) {
+                postCompressed_( message.messageSize(), to_rank, [&message](void*& ptr) { message.write(ptr); } );
+                return;
+            }
+            void* ptr = allocateMessage_( message.messageSize(), to_rank );
+            message.write(ptr);
+        }
+
+     // Post the message in the messageBuffer for several destinations (multicast). The message is
+     // packed and stored only once, and the same payload is sent to each destination.
+        void postMessage
+          ( std::span<const int> to_ranks // destinations of the message (MPI ranks).
+          );
+
+     // Post the message in the messageBuffer for all other ranks. The message is carried by a 
+     // tree broadcast, and read by this MessageHandler on every other rank.
+        void postMessageToAll();
+
+     // Post the message as a zero-copy message: rather than being packed in the messageBuffer, the
+     // elements are described by an MPI derived datatype (MPI_Type_create_indexed_block for every
+     // array, combined with MPI_Type_create_struct), and sent straight from the arrays. On the
+     // receiving side they are received straight into new target slots, see zeroCopyReceiveDatatypes().
+     // The items of message() must all refer to indexed elements with the same indices (see
+     // IndexedMessageItem and PropertySet). The indices are copied, but the datatype is created when
+     // the exchange starts, after the target slots for the incoming zero-copy messages were provided
+     // (which may grow the arrays). From then on, the arrays must not be modified (nor grow) until the
+     // exchange is finished. Zero-copy messages are only exchanged in the FLAT exchange mode over MPI.
+        void postZeroCopyMessage
+          ( int to_rank // destination of the message (some MPI rank).
+          );
+
+     // Compress the messages of at least threshold bytes posted by this MessageHandler (lossless, see
+     // Compression.h). threshold=0 (the default) switches compression off. typeSize is the element size
+     // for the byte shuffle, e.g. sizeof(float) for messages with mainly float data. A message that does
+     // not get smaller is posted uncompressed. The messages are decompressed at the end of the exchange,
+     // readMessage() sees the decompressed message. Zero-copy messages are never compressed. The
+     // compression ratio and throughput are recorded in messageBuffer().compressionStatistics().
+        void setCompression(size_t threshold, size_t typeSize = sizeof(float));
+        inline size_t compressionThreshold() const { return compressionThreshold_; }
+
+     // Delta encoding of messages that are posted repeatedly to the same destination, e.g. the ghost
+     // particles of a persistent ghost list: the message is sent as its difference with the previous
+     // message of this MessageHandler to the same destination, which is mostly zeros if the values changed
+     // only slightly. Combined with setCompression() this reduces the traffic considerably.
+     //   - XOR_DELTA     : the XOR of the bytes of the messages,
+     //   - SUBTRACT_DELTA: the difference of the 32 bit words of the messages (for float data, small
+     //                     changes of the values give small differences of the words).
+     // Every keyframeInterval-th message to a destination is sent in full (a keyframe), as well as the
+     // messages whose size differs from the previous one. ALL_RANKS (postMessageToAll()) counts as a
+     // destination of its own. The receiving MessageHandler keeps the last message from every source,
+     // for messages to this rank and to ALL_RANKS separately, and reconstructs the message before
+     // reading it. Hence, the messages to a destination must be posted by one thread, and be read in
+     // order (readConcurrency() must not be REENTRANT). Only messages posted by postMessage(to_rank)
+     // and postMessage(message, to_rank) are delta encoded. NO_DELTA (the default) switches delta
+     // encoding off.
+        enum DeltaEncoding { NO_DELTA, XOR_DELTA, SUBTRACT_DELTA };
+        void setDeltaEncoding(DeltaEncoding deltaEncoding, size_t keyframeInterval = 16);
+        inline DeltaEncoding deltaEncoding() const { return deltaEncoding_; }
+     // Send keyframes to all destinations next time, e.g. after the ghost lists were rebuilt.
+        void resetDeltaEncoding();
+     // The number of keyframes and deltas posted by this MessageHandler.
+        inline size_t nKeyframesPosted() const { return nKeyframesPosted_; }
+        inline size_t nDeltasPosted   () const { return nDeltasPosted_; }
+
+     // Receiving zero-copy messages is done in two steps, when the exchange starts (the receives are
+     // posted right away), rather than when the messages are read. First, the messageBuffer calls
+     // provideZeroCopySlots() for every MessageHandler with incoming zero-copy messages, of nBytes[m]
+     // bytes. Then, when all target slots are provided and the arrays will no longer move, it creates
+     // the MPI derived datatypes for receiving the messages with zeroCopyReceiveDatatypes(), one per
+     // message. The default implementations obtain new target slots from the items of message(), for
+     // all the messages at once, the slots of the messages follow each other in the indices. The
+     // messageBuffer frees the datatypes.
+        virtual void provideZeroCopySlots(std::vector<size_t> const& nBytes);
+        virtual std::vector<MPI_Datatype> zeroCopyReceiveDatatypes(std::vector<size_t> const& nBytes);
+     // Create the MPI derived datatype for sending a zero-copy message with the given indices (called
+     // by the messageBuffer when the message is sent).
+        virtual MPI_Datatype zeroCopySendDatatype(std::vector<Index_t> const& indices);
+
      // Read a message in the messageBuffer, i.e. the inverse of postMessagge().
      //     message <- messageBuffer
      // Reading the message is generally the responsability of the messageBuffer, which
@@ -141,13 +242,85 @@ namespace mpi2s
           ( Index_t msg_id // the message id identifies the message header
           );
 
+     // Read a message in the messageBuffer into a message other than message(). This is meant for
+     // REENTRANT MessageHandlers (see below), whose readMessage(msg_id) cannot use the shared message().
+     // A zero-copy message has been received in its target slots already, and is not read again.
+        bool
+        readMessage
+          ( ::mpi12s::Message& message // the message to read into.
+          , Index_t msg_id             // the message id identifies the message header
+          );
+
+     // Read a message in the messageBuffer into a StaticMessage.
+        template<typename... Ts>
+        bool
+        readMessage
+          ( ::mpi12s::StaticMessage<Ts...>& message // the message to read into.
+          , Index_t msg_id                          // the message id identifies the message header
+          )
+        {
+            if( static_cast<key_type>(messageBuffer_.messageHandlerKey(msg_id)) != key_ )
+                return false;
+            undoDelta_(msg_id);
+            void* ptr = messageBuffer_.messagePtr(msg_id);
+            message.read(ptr);
+            return true;
+        }
+
+     // How MessageBuffer::readMessages(ThreadPool&) may call readMessage() of this MessageHandler
+     // concurrently:
+        enum ReadConcurrency
+          { REENTRANT // readMessage() may be called concurrently for different messages of this
+                      // MessageHandler, and concurrently with other MessageHandlers.
+          , SERIAL    // the messages of this MessageHandler are read one at a time, in order, but
+                      // concurrently with the messages of other MessageHandlers.
+          , EXCLUSIVE // the messages of this MessageHandler are read while no other message is read.
+          };
+     // The default is EXCLUSIVE, which is always safe. Override this if readMessage() only touches
+     // data owned by this MessageHandler (SERIAL), or is also safe against itself (REENTRANT).
+        virtual ReadConcurrency readConcurrency() const { return EXCLUSIVE; }
+
      // data member access
         inline ::mpi12s::Message& message() { return message_; }
         inline key_type key() const { return key_; }
+        inline ::mpi12s::MessageBuffer& messageBuffer() { return messageBuffer_; }
 
     protected:
+     // Allocate a message of nBytes bytes from this MessageHandler to to_rank in the message buffer of
+     // the calling thread, and return a pointer to it.
+        void* allocateMessage_(size_t nBytes, int to_rank);
+
+     // Write message to ptr, in parallel if the messageBuffer has a ThreadPool.
+        void write_(::mpi12s::Message const& message, void*& ptr);
+     // Must a message of sz bytes be compressed?
+        inline bool compress_(size_t sz) const { return compressionThreshold_ > 0 && sz >= compressionThreshold_; }
+     // Post a compressed message of sz bytes (uncompressed) from this MessageHandler to to_rank in the
+     // message buffer of the calling thread. The message is written by write(ptr) to a scratch buffer
+     // first. If it does not compress, it is posted uncompressed. Returns the id of the message.
+        Index_t postCompressed_(size_t sz, int to_rank, std::function<void(void*& ptr)> const& write, Index_t flags = 0);
+     // Post message (of sz bytes) as a delta with the previous message to to_rank, or as a keyframe.
+        void postDelta_(::mpi12s::Message const& message, size_t sz, int to_rank);
+     // Reconstruct an incoming delta message msg_id in place, and keep the message (if a keyframe or delta).
+        void undoDelta_(Index_t msg_id);
+
+        ::mpi12s::MessageBuffer& messageBuffer_;
         ::mpi12s::Message message_;
         key_type key_;
+        size_t compressionThreshold_;
+        size_t compressionTypeSize_;
+
+        struct DeltaCache_t {
+            std::vector<Index_t> previous; // the last message, uncompressed and not delta encoded
+            size_t count = 0;              // the number of messages since the last keyframe
+        };
+        DeltaEncoding deltaEncoding_;
+        size_t keyframeInterval_;
+        std::map<int,DeltaCache_t> deltaSent_;     // per destination (a rank, or ALL_RANKS)
+     // per (source, destination): the messages of a source to this rank and to ALL_RANKS are separate streams
+        std::map<std::pair<int,int>,DeltaCache_t> deltaReceived_;
+        std::mutex deltaMutex_;
+        size_t nKeyframesPosted_;
+        size_t nDeltasPosted_;
     };
  //------------------------------------------------------------------------------------------------
 }// namespace mpi2s
@@ -0,0 +1,60 @@
+#include "NodeTopology.h"
+#include "mpi12s.h"
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class NodeTopology
+ //------------------------------------------------------------------------------------------------
+    NodeTopology::
+    NodeTopology()
+      : initialized_(false)
+      , nodeComm_(MPI_COMM_NULL)
+      , leaderComm_(MPI_COMM_NULL)
+      , nNodes_(0)
+      , nodeSize_(0)
+      , localRank_(-1)
+      , node_(-1)
+    {}
+
+    NodeTopology::
+    ~NodeTopology()
+    {// The communicators can only be freed as long as MPI is not finalized.
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        if( !finalized ) {
+            if( nodeComm_   != MPI_COMM_NULL ) MPI_Comm_free(&nodeComm_);
+            if( leaderComm_ != MPI_COMM_NULL ) MPI_Comm_free(&leaderComm_);
+        }
+    }
+
+    void
+    NodeTopology::
+    initialize(int ranksPerNode)
+    {
+        if( ranksPerNode > 0 )
+            MPI_Comm_split( MPI_COMM_WORLD, ::mpi12s::rank / ranksPerNode, ::mpi12s::rank, &nodeComm_ );
+        else
+            MPI_Comm_split_type( MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, ::mpi12s::rank, MPI_INFO_NULL, &nodeComm_ );
+        MPI_Comm_rank( nodeComm_, &localRank_ );
+        MPI_Comm_size( nodeComm_, &nodeSize_ );
+
+     // The node leaders get their own communicator, the rank in it is the node index.
+        MPI_Comm_split( MPI_COMM_WORLD, ( isLeader() ? 0 : MPI_UNDEFINED ), ::mpi12s::rank, &leaderComm_ );
+        if( isLeader() ) {
+            MPI_Comm_rank( leaderComm_, &node_ );
+            MPI_Comm_size( leaderComm_, &nNodes_ );
+        }
+        MPI_Bcast( &node_  , 1, MPI_INT, 0, nodeComm_ );
+        MPI_Bcast( &nNodes_, 1, MPI_INT, 0, nodeComm_ );
+
+     // Every rank needs to know the node and the local rank of every other rank.
+        nodeOfRank_     .resize(::mpi12s::size);
+        localRankOfRank_.resize(::mpi12s::size);
+        MPI_Allgather( &node_     , 1, MPI_INT, nodeOfRank_     .data(), 1, MPI_INT, MPI_COMM_WORLD );
+        MPI_Allgather( &localRank_, 1, MPI_INT, localRankOfRank_.data(), 1, MPI_INT, MPI_COMM_WORLD );
+
+        initialized_ = true;
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,58 @@
+#ifndef NODETOPOLOGY_H
+#define NODETOPOLOGY_H
+
+#include <mpi.h>
+#include <vector>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+    class NodeTopology
+ // This class describes how the MPI ranks are distributed over the (shared memory) nodes. It
+ // provides a communicator for the ranks on the same node and a communicator for the node leaders
+ // (the ranks with local rank 0), which are used for node-aware (hierarchical) communication.
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+         NodeTopology();
+        ~NodeTopology();
+
+     // Set up the communicators. This must be called on all processes, after mpi12s::init().
+        void
+        initialize
+          ( int ranksPerNode = 0 // if 0, the nodes are determined by MPI (MPI_COMM_TYPE_SHARED), otherwise,
+                                 // consecutive ranks are grouped in "virtual nodes" of ranksPerNode ranks,
+                                 // which is useful for testing on a single node.
+          );
+        inline bool initialized() const { return initialized_; }
+
+     // Communicator of the ranks on this node.
+        inline MPI_Comm nodeComm  () const { return nodeComm_; }
+     // Communicator of the node leaders, MPI_COMM_NULL if this rank is not a node leader.
+        inline MPI_Comm leaderComm() const { return leaderComm_; }
+
+        inline int  nNodes   () const { return nNodes_; }
+        inline int  nodeSize () const { return nodeSize_; }   // number of ranks on this node
+        inline int  localRank() const { return localRank_; }  // rank in nodeComm()
+        inline bool isLeader () const { return localRank_ == 0; }
+        inline int  node     () const { return node_; }       // node of this rank, also its rank in leaderComm()
+
+     // The node of a world rank, and its local rank on that node.
+        inline int node     (int world_rank) const { return nodeOfRank_     [world_rank]; }
+        inline int localRank(int world_rank) const { return localRankOfRank_[world_rank]; }
+
+    private:
+        bool     initialized_;
+        MPI_Comm nodeComm_;
+        MPI_Comm leaderComm_;
+        int      nNodes_;
+        int      nodeSize_;
+        int      localRank_;
+        int      node_;
+        std::vector<int> nodeOfRank_;
+        std::vector<int> localRankOfRank_;
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // NODETOPOLOGY_H
@@ -0,0 +1,374 @@
+#include "PropertySet.h"
+
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+namespace mpi12s
+{
+    std::string toStr(WireLayout layout)
+    {
+        switch(layout) {
+            case AOS  : return "AOS";
+            case SOA  : return "SOA";
+            case AOSOA: return "AOSOA";
+        }
+        return "?";
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // Implementation of class PropertySet
+ //-------------------------------------------------------------------------------------------------
+    void
+    PropertySet::
+    setWireLayout(WireLayout layout, size_t blockSize)
+    {
+        if( blockSize == 0 ) {
+            std::string errmsg = ::mpi12s::info + "PropertySet::setWireLayout() : blockSize must be > 0.";
+            throw std::runtime_error(errmsg);
+        }
+        layout_ = layout;
+        blockSize_ = blockSize;
+    }
+
+    void
+    PropertySet::
+    setChangeTracking(bool on)
+    {
+        if( on && properties_.size() > MAX_TRACKED_PROPERTIES ) {
+            std::string errmsg = ::mpi12s::info + "PropertySet::setChangeTracking() : too many properties for change tracking.";
+            throw std::runtime_error(errmsg);
+        }
+        changeTracking_ = on;
+        sent_.clear();
+    }
+
+    void
+    PropertySet::
+    touch()
+    {
+        for( Property_& property : properties_ )
+            ++property.version;
+    }
+
+    namespace
+    {// Is property p one of columns? (Without change tracking there may be more properties than bits.)
+        inline bool hasColumn(PropertySet::Columns_t columns, size_t p) {
+            return p >= PropertySet::MAX_TRACKED_PROPERTIES || ( ( columns >> p ) & 1 );
+        }
+    }
+
+    size_t
+    PropertySet::
+    elementSize(Columns_t columns) const
+    {
+        size_t sz = 0;
+        for( size_t p = 0; p < properties_.size(); ++p )
+            if( hasColumn(columns, p) )
+                sz += properties_[p].elementSize;
+        return sz;
+    }
+
+    namespace
+    {// Copy one element of N bytes (N known at compile time) between the wire and a property.
+        template<bool Pack, size_t N>
+        inline void copyElement(char* wire, char* element)
+        {
+            if constexpr(Pack) memcpy(wire, element, N);
+            else               memcpy(element, wire, N);
+        }
+
+        template<bool Pack>
+        inline void copyElement(char* wire, char* element, size_t n)
+        {
+            if constexpr(Pack) memcpy(wire, element, n);
+            else               memcpy(element, wire, n);
+        }
+
+        typedef void (*CopyElement_t)(char* wire, char* element);
+
+     // A copy function with the element size known at compile time, or nullptr.
+        template<bool Pack>
+        CopyElement_t copyElementFunction(size_t n)
+        {
+            switch(n) {
+                case  4: return &copyElement<Pack, 4>;
+                case  8: return &copyElement<Pack, 8>;
+                case 12: return &copyElement<Pack,12>;
+                case 16: return &copyElement<Pack,16>;
+                case 24: return &copyElement<Pack,24>;
+                default: return nullptr;
+            }
+        }
+
+     // Copy the elements array[indices[i]], i in [begin,end[, to/from consecutive positions in wire,
+     // with the gather and scatter kernels in SimdKernels.h.
+        template<bool Pack>
+        void copyProperty(char* wire, char* array, size_t arraySize, size_t n, Index_t const* begin, Index_t const* end)
+        {
+            if constexpr(Pack) simd::gather ( wire, array, arraySize, n, begin, end - begin );
+            else               simd::scatter( array, arraySize, wire, n, begin, end - begin );
+        }
+    }
+
+    template<bool Pack>
+    void
+    PropertySet::
+    transfer_(char* wire, std::vector<Index_t> const& indices, WireLayout layout, size_t blockSize, Columns_t columns) const
+    {
+        size_t const n = indices.size();
+        Index_t const* idx = indices.data();
+        std::vector<char*> arrays;
+        std::vector<size_t> sizes;
+        std::vector<CopyElement_t> copies;
+        for( Property_ const& property : properties_ ) {
+            arrays.push_back( property.data(property.array) );
+            sizes.push_back( property.size(property.array) );
+            copies.push_back( copyElementFunction<Pack>(property.elementSize) );
+        }
+
+        switch(layout)
+        {
+            case AOS:
+             // a single loop over the indices
+                for( size_t i = 0; i < n; ++i ) {
+                    for( size_t p = 0; p < properties_.size(); ++p ) {
+                        if( !hasColumn(columns, p) )
+                            continue;
+                        size_t es = properties_[p].elementSize;
+                        if( copies[p] )
+                            copies[p]( wire, arrays[p] + idx[i]*es );
+                        else
+                            copyElement<Pack>( wire, arrays[p] + idx[i]*es, es );
+                        wire += es;
+                    }
+                }
+                break;
+            case SOA:
+                for( size_t p = 0; p < properties_.size(); ++p ) {
+                    if( !hasColumn(columns, p) )
+                        continue;
+                    size_t es = properties_[p].elementSize;
+                    copyProperty<Pack>( wire, arrays[p], sizes[p], es, idx, idx + n );
+                    wire += n*es;
+                }
+                break;
+            case AOSOA:
+                for( size_t begin = 0; begin < n; begin += blockSize ) {
+                    size_t end = std::min(begin + blockSize, n);
+                    for( size_t p = 0; p < properties_.size(); ++p ) {
+                        if( !hasColumn(columns, p) )
+                            continue;
+                        size_t es = properties_[p].elementSize;
+                        copyProperty<Pack>( wire, arrays[p], sizes[p], es, idx + begin, idx + end );
+                        wire += (end - begin)*es;
+                    }
+                }
+                break;
+        }
+    }
+
+    void
+    PropertySet::
+    indexedBlocks(std::vector<Index_t> const* indices, IndexedBlocks_t& blocks) const
+    {
+        for( Property_ const& property : properties_ )
+            blocks.push_back( IndexedBlock{property.data(property.array), property.elementSize, indices->data(), indices->size()} );
+    }
+
+    void
+    PropertySet::
+    pack(void* dst, std::vector<Index_t> const& indices, WireLayout layout, size_t blockSize, Columns_t columns) const
+    {
+        transfer_<true>( static_cast<char*>(dst), indices, layout, blockSize, columns );
+    }
+
+    void
+    PropertySet::
+    unpack(void const* src, std::vector<Index_t> const& indices, WireLayout layout, size_t blockSize, Columns_t columns)
+    {
+        transfer_<false>( const_cast<char*>(static_cast<char const*>(src)), indices, layout, blockSize, columns );
+    }
+
+    void
+    PropertySet::
+    setPeer_(int peer, std::vector<Index_t> const& indices)
+    {
+        peer_ = peer;
+        columns_ = ~Columns_t(0);
+        if( !changeTracking_ || peer < 0 )
+            return;
+        std::map<int,Sent_>::const_iterator iter = sent_.find(peer);
+        if( iter == sent_.end() || iter->second.indices != indices )
+            return; // nothing sent yet, or other elements: send everything
+        columns_ = 0;
+        for( size_t p = 0; p < properties_.size(); ++p )
+            if( properties_[p].version != iter->second.versions[p] )
+                columns_ |= Columns_t(1) << p;
+    }
+
+    void
+    PropertySet::
+    recordSent_(std::vector<Index_t> const& indices)
+    {
+        Sent_& sent = sent_[peer_];
+        sent.versions.resize( properties_.size() );
+        for( size_t p = 0; p < properties_.size(); ++p )
+            sent.versions[p] = properties_[p].version;
+        sent.indices = indices;
+    }
+
+    void
+    PropertySet::
+    fillReceived_(std::vector<Index_t> const& indices, Columns_t columns)
+    {
+        if( peer_ < 0 ) {
+            std::string errmsg = ::mpi12s::info + "PropertySet::fillReceived_() : change tracking message read from an unknown source.";
+            throw std::runtime_error(errmsg);
+        }
+        size_t const n = indices.size();
+        Received_& received = received_[peer_];
+        if( columns != allColumns() && ( received.n != n || received.columns.size() != properties_.size() ) ) {
+            std::string errmsg = ::mpi12s::info + "PropertySet::fillReceived_() : incomplete message without matching cached columns.";
+            throw std::runtime_error(errmsg);
+        }
+        received.n = n;
+        received.columns.resize( properties_.size() );
+     // keep the columns received, restore the others
+        for( size_t p = 0; p < properties_.size(); ++p )
+        {
+            Property_ const& property = properties_[p];
+            char* array = property.data(property.array);
+            size_t arraySize = property.size(property.array);
+            std::vector<char>& column = received.columns[p];
+            if( hasColumn(columns, p) ) {
+                column.resize( n*property.elementSize );
+                simd::gather ( column.data(), array, arraySize, property.elementSize, indices.data(), n );
+            } else
+                simd::scatter( array, arraySize, column.data(), property.elementSize, indices.data(), n );
+        }
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // Implementation of class PropertySetMessageItem
+ //-------------------------------------------------------------------------------------------------
+    void
+    PropertySetMessageItem::
+    write(void*& ptr) const
+    {
+        PropertySet::Columns_t columns = properties_->columns_ & properties_->allColumns();
+        size_t tracked = ( properties_->changeTracking_ && properties_->peer_ >= 0 );
+        size_t prefix[5] = { indices_->size(), size_t(properties_->wireLayout()), properties_->blockSize(), columns, tracked };
+        memcpy( ptr, prefix, PREFIX_SIZE );
+        internal::advance_void_ptr( ptr, PREFIX_SIZE );
+        properties_->pack( ptr, *indices_, properties_->wireLayout(), properties_->blockSize(), columns );
+        internal::advance_void_ptr( ptr, indices_->size() * properties_->elementSize(columns) );
+        if( tracked )
+            properties_->recordSent_(*indices_);
+     // the next message is for an unknown destination, unless setPeer() is called again
+        properties_->setPeer_(-1, *indices_);
+    }
+
+    void
+    PropertySetMessageItem::
+    read(void*& ptr)
+    {
+        size_t prefix[5];
+        memcpy( prefix, ptr, PREFIX_SIZE );
+        internal::advance_void_ptr( ptr, PREFIX_SIZE );
+        size_t n = prefix[0];
+        PropertySet::Columns_t columns = prefix[3];
+        provideSlots(n);
+        properties_->unpack( ptr, *indices_, WireLayout(prefix[1]), prefix[2], columns );
+        internal::advance_void_ptr( ptr, n * properties_->elementSize(columns) );
+        if( prefix[4] )
+            properties_->fillReceived_(*indices_, columns);
+        properties_->peer_ = -1;
+    }
+
+    void
+    PropertySetMessageItem::
+    provideSlots(size_t n)
+    {
+        if( indices_->size() == n )
+            return;
+        if( !allocate_ ) {
+            std::string errmsg = ::mpi12s::info + "PropertySetMessageItem::provideSlots() : wrong number of target slots, and no allocator.";
+            throw std::runtime_error(errmsg);
+        }
+        allocate_(n, *indices_);
+        if( indices_->size() != n ) {
+            std::string errmsg = ::mpi12s::info + "PropertySetMessageItem::provideSlots() : allocator provided the wrong number of target slots.";
+            throw std::runtime_error(errmsg);
+        }
+    }
+
+    size_t
+    PropertySetMessageItem::
+    messageSize() const
+    {
+        return PREFIX_SIZE + indices_->size() * properties_->elementSize(properties_->columns_);
+    }
+
+    Lines_t
+    PropertySetMessageItem::
+    debug_text() const
+    {
+        Lines_t lines;
+        lines.push_back
+          ( tostr( "(size=", indices_->size(), ", properties=", properties_->nProperties()
+                 , ", layout=", toStr(properties_->wireLayout()), ", blockSize=", properties_->blockSize(), ")" )
+          );
+        return lines;
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // Message::push_back for PropertySets
+ //-------------------------------------------------------------------------------------------------
+    void
+    Message::
+    push_back(PropertySet& properties, std::vector<Index_t>& indices, AllocateSlots_t allocate)
+    {
+        coll_.push_back( new PropertySetMessageItem(properties, indices, allocate) );
+    }
+
+ //-------------------------------------------------------------------------------------------------
+ // Wire layout benchmark
+ //-------------------------------------------------------------------------------------------------
+    std::vector<WireLayoutTiming>
+    benchmarkWireLayouts
+      ( PropertySet& properties
+      , std::vector<Index_t> const& indices
+      , std::vector<size_t> const& blockSizes
+      , int nRepeat
+      )
+    {
+        std::vector<WireLayoutTiming> timings;
+        timings.push_back( WireLayoutTiming{AOS, 0, 0, 0} );
+        timings.push_back( WireLayoutTiming{SOA, 0, 0, 0} );
+        for( size_t blockSize : blockSizes )
+            timings.push_back( WireLayoutTiming{AOSOA, blockSize, 0, 0} );
+
+        std::vector<char> wire( indices.size() * properties.elementSize() );
+        typedef std::chrono::steady_clock clock;
+        for( WireLayoutTiming& timing : timings )
+        {
+            size_t blockSize = std::max<size_t>(timing.blockSize, 1);
+            timing.packSeconds   = std::numeric_limits<double>::max();
+            timing.unpackSeconds = std::numeric_limits<double>::max();
+            for( int r = 0; r < nRepeat; ++r )
+            {
+                clock::time_point t0 = clock::now();
+                properties.pack( wire.data(), indices, timing.layout, blockSize );
+                clock::time_point t1 = clock::now();
+                properties.unpack( wire.data(), indices, timing.layout, blockSize );
+                clock::time_point t2 = clock::now();
+                timing.packSeconds   = std::min( timing.packSeconds  , std::chrono::duration<double>(t1 - t0).count() );
+                timing.unpackSeconds = std::min( timing.unpackSeconds, std::chrono::duration<double>(t2 - t1).count() );
+            }
+        }
+        return timings;
+    }
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,241 @@
+#ifndef PROPERTYSET_H
+#define PROPERTYSET_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdint>
+#include "Message.h"
+
+namespace mpi12s
+{
+ //-------------------------------------------------------------------------------------------------
+ // The layout of the elements of a PropertySet in a message, e.g. for properties x, m and n particles:
+ //   AOS  : particle by particle  x[i0] m[i0] x[i1] m[i1] ...
+ //   SOA  : property by property  x[i0] x[i1] ... m[i0] m[i1] ...
+ //   AOSOA: blocks of blockSize particles, property by property within a block
+    enum WireLayout { AOS, SOA, AOSOA };
+
+    std::string toStr(WireLayout layout);
+
+ //-------------------------------------------------------------------------------------------------
+    class PropertySet
+ // A set of particle properties, i.e. arrays of fixed size elements which all use the same indices,
+ // as in a structure of arrays. Declare the properties once, and choose the wire layout by policy:
+ //
+ //     PropertySet properties;
+ //     properties.push_back(pc.x);
+ //     properties.push_back(pc.m);
+ //     properties.setWireLayout(AOSOA, 32);
+ //     message().push_back(properties, indices_, allocate);
+ //
+ // The elements are gathered directly into the message buffer, and scattered directly into the
+ // target slots (as for IndexedMessageItem). The receiving side uses the layout of the sender.
+ //
+ // Change tracking: properties that rarely change (mass, radius, species, ...) need not be resent
+ // at every exchange. Every property (column) has a version counter, incremented by touch(). With
+ // setChangeTracking(true), a message to a destination only contains the columns that were touched
+ // since the last message to that destination (with the same indices), and a mask of the columns
+ // it contains. The receiving PropertySet keeps the columns of the last message from every source,
+ // and fills the missing columns from it:
+ //
+ //     properties.setChangeTracking(true);
+ //     ...                      // modify pc.x
+ //     properties.touch(pc.x);  // only pc.x is sent next time
+ //
+ // A message from a PropertySet with change tracking must be posted by one thread at a time, and
+ // read by one thread at a time (readConcurrency() must not be REENTRANT).
+ //-------------------------------------------------------------------------------------------------
+    {
+        friend class PropertySetMessageItem;
+    public:
+        enum { DEFAULT_BLOCK_SIZE = 64 };
+        enum { MAX_TRACKED_PROPERTIES = 64 }; // the number of bits of the column mask
+        typedef uint64_t Columns_t; // a mask of properties, bit p for property p
+
+        PropertySet()
+          : layout_(AOS), blockSize_(DEFAULT_BLOCK_SIZE), elementSize_(0)
+          , changeTracking_(false), peer_(-1), columns_(~Columns_t(0))
+        {}
+
+     // Add a property
+        template<typename T>
+        void push_back(std::vector<T>& array)
+        {
+            static_assert(internal::fixed_size_memcpy_able<T>::value, "T is not fixed size memcpy-able.");
+            if( changeTracking_ && properties_.size() == MAX_TRACKED_PROPERTIES ) {
+                std::string errmsg = ::mpi12s::info + "PropertySet::push_back() : too many properties for change tracking.";
+                throw std::runtime_error(errmsg);
+            }
+            properties_.push_back( Property_{&array, sizeof(T), &data_<T>, &size_<T>, 0} );
+            elementSize_ += sizeof(T);
+        }
+
+     // Change tracking (see above). Switching it on or off forgets what was sent.
+        void setChangeTracking(bool on);
+        inline bool changeTracking() const { return changeTracking_; }
+     // Mark property array as modified (throws if array is not a property of this PropertySet).
+        template<typename T>
+        void touch(std::vector<T>& array)
+        {
+            for( Property_& property : properties_ )
+                if( property.array == &array ) {
+                    ++property.version;
+                    return;
+                }
+            std::string errmsg = ::mpi12s::info + "PropertySet::touch() : not a property of this PropertySet.";
+            throw std::runtime_error(errmsg);
+        }
+     // Mark all properties as modified.
+        void touch();
+        inline size_t version(size_t p) const { return properties_[p].version; }
+     // All properties
+        inline Columns_t allColumns() const {
+            return properties_.size() >= MAX_TRACKED_PROPERTIES ? ~Columns_t(0) : ( Columns_t(1) << properties_.size() ) - 1;
+        }
+     // The number of bytes per particle of the given columns
+        size_t elementSize(Columns_t columns) const;
+
+     // Set the wire layout used for writing messages. blockSize is only used by AOSOA.
+        void setWireLayout(WireLayout layout, size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+     // Copy the elements with the given indices to dst (pack), or from src to the elements with the
+     // given indices (unpack), in the given wire layout.
+        void pack
+          ( void* dst                            // the wire buffer, n*elementSize(columns) bytes
+          , std::vector<Index_t> const& indices  // the indices of the elements (n=indices.size())
+          , WireLayout layout
+          , size_t blockSize
+          , Columns_t columns = ~Columns_t(0)    // the properties to pack
+          ) const;
+        void unpack
+          ( void const* src                      // the wire buffer, n*elementSize(columns) bytes
+          , std::vector<Index_t> const& indices  // the indices of the elements (n=indices.size())
+          , WireLayout layout
+          , size_t blockSize
+          , Columns_t columns = ~Columns_t(0)    // the properties to unpack
+          );
+
+     // Append an IndexedBlock for every property to blocks (for zero-copy messages, which have the
+     // SOA layout).
+        void indexedBlocks(std::vector<Index_t> const* indices, IndexedBlocks_t& blocks) const;
+
+    public: // data member accessors
+        inline WireLayout wireLayout() const { return layout_; }
+        inline size_t blockSize() const { return blockSize_; }
+     // number of bytes per particle
+        inline size_t elementSize() const { return elementSize_; }
+        inline size_t nProperties() const { return properties_.size(); }
+
+    private:
+        struct Property_
+        {
+            void*  array;        // a std::vector<T>
+            size_t elementSize;  // sizeof(T)
+            char* (*data)(void* array);
+            size_t (*size)(void* array);
+            size_t version;      // incremented by touch()
+        };
+        template<typename T>
+        static char* data_(void* array) {
+            return reinterpret_cast<char*>( static_cast<std::vector<T>*>(array)->data() );
+        }
+        template<typename T>
+        static size_t size_(void* array) {
+            return static_cast<std::vector<T>*>(array)->size();
+        }
+     // The pack and unpack kernels, Pack==true copies from the properties to wire.
+        template<bool Pack>
+        void transfer_(char* wire, std::vector<Index_t> const& indices, WireLayout layout, size_t blockSize, Columns_t columns) const;
+
+     // Change tracking, used by PropertySetMessageItem:
+     // set the peer of the next message, and compute the columns to send to it.
+        void setPeer_(int peer, std::vector<Index_t> const& indices);
+     // record the versions and indices sent to peer_ (after writing a message).
+        void recordSent_(std::vector<Index_t> const& indices);
+     // update the cached columns of peer_, and fill the missing columns from them (after reading a message).
+        void fillReceived_(std::vector<Index_t> const& indices, Columns_t columns);
+
+        std::vector<Property_> properties_;
+        WireLayout layout_;
+        size_t blockSize_;
+        size_t elementSize_;
+
+        bool changeTracking_;
+        int peer_;           // the peer of the message being written or read (<0 if unknown)
+        Columns_t columns_;  // the columns of the message being written (~0 for all)
+        struct Sent_ {
+            std::vector<size_t> versions;  // the versions of the properties last sent to a destination
+            std::vector<Index_t> indices;  // and their indices
+        };
+        struct Received_ {
+            size_t n = 0;                          // the number of elements
+            std::vector<std::vector<char>> columns; // the elements of every property
+        };
+        std::map<int,Sent_> sent_;         // per destination
+        std::map<int,Received_> received_; // per source
+    };
+
+ //-------------------------------------------------------------------------------------------------
+    class PropertySetMessageItem : public MessageItemBase
+ // A message item for the elements of a PropertySet with the given indices. The message contains
+ // the number of elements, the wire layout and the block size, followed by the elements. As for
+ // IndexedMessageItem, if the number of indices differs from the number of elements in the
+ // message, the target slots are obtained from allocate(n, indices).
+ //-------------------------------------------------------------------------------------------------
+    {
+    public:
+        PropertySetMessageItem
+          ( PropertySet& properties
+          , std::vector<Index_t>& indices
+          , AllocateSlots_t allocate = nullptr
+          )
+          : properties_(&properties), indices_(&indices), allocate_(allocate)
+        {}
+
+        virtual void write(void*& ptr) const;
+        virtual void read (void*& ptr);
+        virtual size_t messageSize() const;
+     // The elements are not contiguous, so they are packed (unpacked) right away.
+        virtual void writeSegments(void*& ptr, CopySegments_t& /*segments*/) const { write(ptr); }
+        virtual void readSegments (void*& ptr, CopySegments_t& /*segments*/)       { read (ptr); }
+        virtual Lines_t debug_text() const;
+     // Zero-copy messages
+        virtual std::vector<Index_t>* indices() const { return indices_; }
+        virtual size_t indexedElementSize() const { return properties_->elementSize(); }
+        virtual void provideSlots(size_t n);
+        virtual void indexedBlocks(IndexedBlocks_t& blocks) const { properties_->indexedBlocks(indices_, blocks); }
+     // Change tracking
+        virtual void setPeer(int peer) const { properties_->setPeer_(peer, *indices_); }
+
+    private:
+     // number of elements, wire layout, block size, columns, tracked (change tracking for a known destination)
+        enum { PREFIX_SIZE = 5*sizeof(size_t) };
+        PropertySet* properties_;
+        std::vector<Index_t>* indices_;
+        AllocateSlots_t allocate_;
+    };
+
+ //-------------------------------------------------------------------------------------------------
+ // Timing of pack and unpack of a PropertySet in a given wire layout
+    struct WireLayoutTiming
+    {
+        WireLayout layout;
+        size_t blockSize;
+        double packSeconds;   // per pack
+        double unpackSeconds; // per unpack
+    };
+
+ // Measure the time to pack and unpack the elements with the given indices of properties, for
+ // AOS, SOA and AOSOA with each of the given block sizes.
+    std::vector<WireLayoutTiming>
+    benchmarkWireLayouts
+      ( PropertySet& properties
+      , std::vector<Index_t> const& indices
+      , std::vector<size_t> const& blockSizes
+      , int nRepeat                // number of repetitions, the best time is retained
+      );
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // PROPERTYSET_H
@@ -0,0 +1,65 @@
+#ifndef RAGGEDARRAY_H
+#define RAGGEDARRAY_H
+
+#include <vector>
+#include <span>
+#include <cstddef>
+
+namespace mpi12s
+{
+ //-------------------------------------------------------------------------------------------------
+    template<typename T>
+    class RaggedArray
+ // A ragged array in compressed sparse row (CSR) format: the rows (e.g. the neighbour list, or the
+ // bonded interactions of every particle) are stored one after the other in a single data array,
+ // and row i is data()[offsets()[i] .. offsets()[i+1][. In a message it has the same representation
+ // as a std::vector<std::vector<T>> (the number of rows, the offsets, and the data), but it is
+ // written and read with two copies, rather than one per row.
+ //-------------------------------------------------------------------------------------------------
+    {
+    public:
+        typedef T value_type;
+
+        RaggedArray() : offsets_(1, 0) {}
+
+     // The number of rows
+        inline size_t size() const { return offsets_.size() - 1; }
+        inline bool empty() const { return size() == 0; }
+     // The total number of elements
+        inline size_t nElements() const { return data_.size(); }
+
+     // Row i
+        inline std::span<T>       operator[](size_t i)       { return std::span<T>      ( data_.data() + offsets_[i], data_.data() + offsets_[i + 1] ); }
+        inline std::span<T const> operator[](size_t i) const { return std::span<T const>( data_.data() + offsets_[i], data_.data() + offsets_[i + 1] ); }
+        inline size_t rowSize(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+
+     // Append a row
+        template<typename Iterator>
+        void push_back(Iterator first, Iterator last)
+        {
+            data_.insert( data_.end(), first, last );
+            offsets_.push_back( data_.size() );
+        }
+        template<typename Row>
+        void push_back(Row const& row) { push_back( row.begin(), row.end() ); }
+
+        void clear()
+        {
+            offsets_.assign(1, 0);
+            data_.clear();
+        }
+
+     // The underlying arrays, offsets().size() == size() + 1, and offsets()[0] == 0.
+        inline std::vector<size_t>      & offsets()       { return offsets_; }
+        inline std::vector<size_t> const& offsets() const { return offsets_; }
+        inline std::vector<T>      & data()       { return data_; }
+        inline std::vector<T> const& data() const { return data_; }
+
+    private:
+        std::vector<size_t> offsets_;
+        std::vector<T> data_;
+    };
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // RAGGEDARRAY_H
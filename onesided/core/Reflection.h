@@ -0,0 +1,177 @@
+#ifndef REFLECTION_H
+#define REFLECTION_H
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+namespace mpi12s
+{
+ //-------------------------------------------------------------------------------------------------
+ // Compile time reflection of aggregates (structs without constructors, base classes, or private
+ // members), e.g.
+ //
+ //     struct Atom { int id; Eigen::Vector3f x; std::vector<int> bonds; };
+ //
+ // fieldCount<Atom>() is 3, and fields(atom) is a std::tuple<int&, Eigen::Vector3f&, std::vector<int>&>
+ // referring to the fields of atom. The number of fields is the largest number of initializers that
+ // the aggregate accepts, and the fields are obtained with a structured binding.
+ //-------------------------------------------------------------------------------------------------
+    namespace reflection
+    {
+        enum { MAX_FIELDS = 12 }; // the maximum number of fields supported
+
+        namespace internal
+        {// A type that converts to anything, for counting the initializers an aggregate accepts.
+            struct AnyField
+            {
+                template<typename T>
+                operator T&() const;
+                template<typename T>
+                operator T&&() const;
+            };
+
+            template<typename T, size_t... I>
+            constexpr bool isInitializableWith(std::index_sequence<I...>) {
+                return requires { T{ ( void(I), AnyField{} )... }; };
+            }
+
+            template<typename T, size_t N>
+            constexpr size_t fieldCount()
+            {
+                if constexpr( N == 0 )
+                    return 0;
+                else if constexpr( isInitializableWith<T>(std::make_index_sequence<N>{}) )
+                    return N;
+                else
+                    return fieldCount<T, N - 1>();
+            }
+
+         // Can T be initialized with N braced initializers {}? A braced initializer always initializes a
+         // whole field, whereas an AnyField initializer may initialize a single element of a C-array
+         // field (brace elision), so that fieldCount over-counts aggregates with C-array fields.
+            template<typename T, size_t N>
+            constexpr bool isInitializableWithBraces()
+            {
+                if constexpr( N == 0 )
+                    return requires { T{}; };
+                else if constexpr( N == 1 )
+                    return requires { T{ {} }; };
+                else if constexpr( N == 2 )
+                    return requires { T{ {}, {} }; };
+                else if constexpr( N == 3 )
+                    return requires { T{ {}, {}, {} }; };
+                else if constexpr( N == 4 )
+                    return requires { T{ {}, {}, {}, {} }; };
+                else if constexpr( N == 5 )
+                    return requires { T{ {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 6 )
+                    return requires { T{ {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 7 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 8 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 9 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 10 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 11 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} }; };
+                else if constexpr( N == 12 )
+                    return requires { T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} }; };
+                else
+                    return false;
+            }
+        }
+
+     // Is T an aggregate class that can be reflected? Its number of fields must be counted exactly, so
+     // aggregates with more than MAX_FIELDS fields, or with fields that cannot be initialized with {}
+     // (C-arrays, which are over-counted, references, ...) are not reflectable.
+        template<typename T>
+        constexpr bool isReflectable()
+        {
+            if constexpr( !std::is_aggregate_v<T> || !std::is_class_v<T> || std::is_union_v<T> )
+                return false;
+            else {
+                constexpr size_t N = internal::fieldCount<T, MAX_FIELDS + 1>();
+                return N <= MAX_FIELDS && internal::isInitializableWithBraces<T, N>();
+            }
+        }
+
+     // The number of fields of aggregate T
+        template<typename T>
+        constexpr size_t fieldCount() {
+            static_assert( isReflectable<T>(), "T is not a reflectable aggregate class.");
+            return internal::fieldCount<T, MAX_FIELDS>();
+        }
+
+     // A tuple of references to the fields of aggregate t
+        template<typename T>
+        auto fields(T& t)
+        {
+            constexpr size_t N = fieldCount<T>();
+            if constexpr( N == 0 ) {
+                return std::tuple<>();
+            } else if constexpr( N == 1 ) {
+                auto& [f0] = t;
+                return std::tie(f0);
+            } else if constexpr( N == 2 ) {
+                auto& [f0, f1] = t;
+                return std::tie(f0, f1);
+            } else if constexpr( N == 3 ) {
+                auto& [f0, f1, f2] = t;
+                return std::tie(f0, f1, f2);
+            } else if constexpr( N == 4 ) {
+                auto& [f0, f1, f2, f3] = t;
+                return std::tie(f0, f1, f2, f3);
+            } else if constexpr( N == 5 ) {
+                auto& [f0, f1, f2, f3, f4] = t;
+                return std::tie(f0, f1, f2, f3, f4);
+            } else if constexpr( N == 6 ) {
+                auto& [f0, f1, f2, f3, f4, f5] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5);
+            } else if constexpr( N == 7 ) {
+                auto& [f0, f1, f2, f3, f4, f5, f6] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6);
+            } else if constexpr( N == 8 ) {
+                auto& [f0, f1, f2, f3, f4, f5, f6, f7] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6, f7);
+            } else if constexpr( N == 9 ) {
+                auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8);
+            } else if constexpr( N == 10 ) {
+                auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9);
+            } else if constexpr( N == 11 ) {
+                auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10);
+            } else {
+                auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = t;
+                return std::tie(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11);
+            }
+        }
+
+     // The tuple of the field types of aggregate T
+        template<typename T>
+        struct FieldTypes;
+        template<typename... Fs>
+        struct FieldTypes<std::tuple<Fs&...>> {
+            typedef std::tuple<Fs...> type;
+        };
+        template<typename T>
+        using fieldTypes_t = typename FieldTypes<decltype(fields(std::declval<T&>()))>::type;
+
+     // Do all fields of aggregate T satisfy Trait?
+        template<typename T, template<typename> class Trait>
+        constexpr bool allFields()
+        {
+            return []<typename... Fs>(std::tuple<Fs...>*) {
+                return ( Trait<Fs>::value && ... );
+            }( static_cast<fieldTypes_t<T>*>(nullptr) );
+        }
+    }// namespace reflection
+ //-------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // REFLECTION_H
@@ -0,0 +1,462 @@
+#include "SimdKernels.h"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define MPI12S_X86 1
+#  include <immintrin.h>
+#else
+#  define MPI12S_X86 0
+#endif
+
+namespace mpi12s
+{
+    namespace simd
+    {
+        namespace
+        {
+         //----------------------------------------------------------------------------------------
+         // scalar kernels, with the element size known at compile time for the common sizes
+            template<size_t N>
+            void gatherN(char* dst, char const* array, Index_t const* indices, size_t n)
+            {
+                for( size_t i = 0; i < n; ++i, dst += N )
+                    memcpy( dst, array + indices[i]*N, N );
+            }
+            template<size_t N>
+            void scatterN(char* array, char const* src, Index_t const* indices, size_t n)
+            {
+                for( size_t i = 0; i < n; ++i, src += N )
+                    memcpy( array + indices[i]*N, src, N );
+            }
+
+            void gatherScalar(char* dst, char const* array, size_t elementSize, Index_t const* indices, size_t n)
+            {
+                switch(elementSize) {
+                    case  4: gatherN< 4>(dst, array, indices, n); break;
+                    case  8: gatherN< 8>(dst, array, indices, n); break;
+                    case 12: gatherN<12>(dst, array, indices, n); break;
+                    case 16: gatherN<16>(dst, array, indices, n); break;
+                    case 24: gatherN<24>(dst, array, indices, n); break;
+                    default:
+                        for( size_t i = 0; i < n; ++i, dst += elementSize )
+                            memcpy( dst, array + indices[i]*elementSize, elementSize );
+                }
+            }
+            void scatterScalar(char* array, char const* src, size_t elementSize, Index_t const* indices, size_t n)
+            {
+                switch(elementSize) {
+                    case  4: scatterN< 4>(array, src, indices, n); break;
+                    case  8: scatterN< 8>(array, src, indices, n); break;
+                    case 12: scatterN<12>(array, src, indices, n); break;
+                    case 16: scatterN<16>(array, src, indices, n); break;
+                    case 24: scatterN<24>(array, src, indices, n); break;
+                    default:
+                        for( size_t i = 0; i < n; ++i, src += elementSize )
+                            memcpy( array + indices[i]*elementSize, src, elementSize );
+                }
+            }
+
+#if MPI12S_X86
+         //----------------------------------------------------------------------------------------
+         // 12 byte elements: a 16 byte load and store per element. The load may not read beyond the
+         // array, the store may overwrite the first 4 bytes of the next element in dst, which is
+         // written in the next iteration. The last element is copied by the scalar kernel.
+         // (Scattering this way would overwrite neighbouring elements in the array, which may be
+         // written concurrently by other threads, so scattering 12 byte elements remains scalar.)
+            size_t // the number of elements gathered
+            gather12(char* dst, char const* array, size_t arraySize, Index_t const* indices, size_t n)
+            {
+                if( n == 0 )
+                    return 0;
+                for( size_t i = 0; i < n - 1; ++i, dst += 12 ) {
+                    Index_t index = indices[i];
+                    if( size_t(index) + 1 < arraySize )
+                        _mm_storeu_si128( (__m128i*)dst, _mm_loadu_si128( (__m128i const*)(array + index*12) ) );
+                    else
+                        memcpy( dst, array + index*12, 12 );
+                }
+                return n - 1;
+            }
+
+         //----------------------------------------------------------------------------------------
+         // AVX2: gathers of 4 elements of 4 or 8 bytes (64 bit indices). There are no scatter instructions.
+            __attribute__((target("avx2")))
+            size_t // the number of elements gathered
+            gatherAvx2(char* dst, char const* array, size_t arraySize, size_t elementSize, Index_t const* indices, size_t n)
+            {
+                size_t i = 0;
+                switch(elementSize) {
+                    case 4:
+                        for( ; i + 4 <= n; i += 4 ) {
+                            __m256i vi = _mm256_loadu_si256( (__m256i const*)(indices + i) );
+                            __m128i v  = _mm256_i64gather_epi32( (int const*)array, vi, 4 );
+                            _mm_storeu_si128( (__m128i*)(dst + i*4), v );
+                        }
+                        break;
+                    case 8:
+                        for( ; i + 4 <= n; i += 4 ) {
+                            __m256i vi = _mm256_loadu_si256( (__m256i const*)(indices + i) );
+                            __m256i v  = _mm256_i64gather_epi64( (long long const*)array, vi, 8 );
+                            _mm256_storeu_si256( (__m256i*)(dst + i*8), v );
+                        }
+                        break;
+                    case 12:
+                        i = gather12(dst, array, arraySize, indices, n);
+                        break;
+                }
+                return i;
+            }
+
+         //----------------------------------------------------------------------------------------
+         // AVX-512: gathers and scatters of 8 elements of 4 or 8 bytes (64 bit indices). The scatter
+         // instructions write the lanes in order, so that duplicate indices behave as in the scalar kernel.
+            __attribute__((target("avx512f")))
+            size_t // the number of elements gathered
+            gatherAvx512(char* dst, char const* array, size_t arraySize, size_t elementSize, Index_t const* indices, size_t n)
+            {
+                size_t i = 0;
+                switch(elementSize) {
+                    case 4:
+                        for( ; i + 8 <= n; i += 8 ) {
+                            __m512i vi = _mm512_loadu_si512( (void const*)(indices + i) );
+                            __m256i v  = _mm512_mask_i64gather_epi32( _mm256_setzero_si256(), 0xff, vi, (void const*)array, 4 );
+                            _mm256_storeu_si256( (__m256i*)(dst + i*4), v );
+                        }
+                        break;
+                    case 8:
+                        for( ; i + 8 <= n; i += 8 ) {
+                            __m512i vi = _mm512_loadu_si512( (void const*)(indices + i) );
+                            __m512i v  = _mm512_mask_i64gather_epi64( _mm512_setzero_si512(), 0xff, vi, (void const*)array, 8 );
+                            _mm512_storeu_si512( (void*)(dst + i*8), v );
+                        }
+                        break;
+                    case 12:
+                        i = gather12(dst, array, arraySize, indices, n);
+                        break;
+                }
+                return i;
+            }
+
+            __attribute__((target("avx512f")))
+            size_t // the number of elements scattered
+            scatterAvx512(char* array, char const* src, size_t elementSize, Index_t const* indices, size_t n)
+            {
+                size_t i = 0;
+                switch(elementSize) {
+                    case 4:
+                        for( ; i + 8 <= n; i += 8 ) {
+                            __m512i vi = _mm512_loadu_si512( (void const*)(indices + i) );
+                            __m256i v  = _mm256_loadu_si256( (__m256i const*)(src + i*4) );
+                            _mm512_i64scatter_epi32( (void*)array, vi, v, 4 );
+                        }
+                        break;
+                    case 8:
+                        for( ; i + 8 <= n; i += 8 ) {
+                            __m512i vi = _mm512_loadu_si512( (void const*)(indices + i) );
+                            __m512i v  = _mm512_loadu_si512( (void const*)(src + i*8) );
+                            _mm512_i64scatter_epi64( (void*)array, vi, v, 8 );
+                        }
+                        break;
+                }
+                return i;
+            }
+
+         //----------------------------------------------------------------------------------------
+         // F16C: conversion of 8 floats to float16 and back
+            __attribute__((target("f16c,avx")))
+            size_t // the number of elements converted
+            floatToHalfF16c(uint16_t* dst, float const* src, size_t n)
+            {
+                size_t i = 0;
+                for( ; i + 8 <= n; i += 8 )
+                    _mm_storeu_si128( (__m128i*)(dst + i), _mm256_cvtps_ph( _mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT ) );
+                return i;
+            }
+
+            __attribute__((target("f16c,avx")))
+            size_t // the number of elements converted
+            halfToFloatF16c(float* dst, uint16_t const* src, size_t n)
+            {
+                size_t i = 0;
+                for( ; i + 8 <= n; i += 8 )
+                    _mm256_storeu_ps( dst + i, _mm256_cvtph_ps( _mm_loadu_si128( (__m128i const*)(src + i) ) ) );
+                return i;
+            }
+
+         //----------------------------------------------------------------------------------------
+         // Streaming copies: unaligned loads, and non-temporal stores to the dst, once dst is aligned
+         // to the vector width. The head and the tail are copied with memcpy. The stores are weakly
+         // ordered, hence the sfence.
+            size_t // the number of bytes copied with memcpy to align dst
+            alignHead(char* dst, char const* src, size_t n, size_t width)
+            {
+                size_t head = ( width - reinterpret_cast<uintptr_t>(dst) % width ) % width;
+                head = std::min(head, n);
+                memcpy( dst, src, head );
+                return head;
+            }
+
+            void streamCopySse2(char* dst, char const* src, size_t n)
+            {
+                size_t i = alignHead(dst, src, n, 16);
+                for( ; i + 64 <= n; i += 64 ) {
+                    __m128i a = _mm_loadu_si128( (__m128i const*)(src + i     ) );
+                    __m128i b = _mm_loadu_si128( (__m128i const*)(src + i + 16) );
+                    __m128i c = _mm_loadu_si128( (__m128i const*)(src + i + 32) );
+                    __m128i d = _mm_loadu_si128( (__m128i const*)(src + i + 48) );
+                    _mm_stream_si128( (__m128i*)(dst + i     ), a );
+                    _mm_stream_si128( (__m128i*)(dst + i + 16), b );
+                    _mm_stream_si128( (__m128i*)(dst + i + 32), c );
+                    _mm_stream_si128( (__m128i*)(dst + i + 48), d );
+                }
+                for( ; i + 16 <= n; i += 16 )
+                    _mm_stream_si128( (__m128i*)(dst + i), _mm_loadu_si128( (__m128i const*)(src + i) ) );
+                _mm_sfence();
+                memcpy( dst + i, src + i, n - i );
+            }
+
+            __attribute__((target("avx")))
+            void streamCopyAvx(char* dst, char const* src, size_t n)
+            {
+                size_t i = alignHead(dst, src, n, 32);
+                for( ; i + 64 <= n; i += 64 ) {
+                    __m256i a = _mm256_loadu_si256( (__m256i const*)(src + i     ) );
+                    __m256i b = _mm256_loadu_si256( (__m256i const*)(src + i + 32) );
+                    _mm256_stream_si256( (__m256i*)(dst + i     ), a );
+                    _mm256_stream_si256( (__m256i*)(dst + i + 32), b );
+                }
+                for( ; i + 32 <= n; i += 32 )
+                    _mm256_stream_si256( (__m256i*)(dst + i), _mm256_loadu_si256( (__m256i const*)(src + i) ) );
+                _mm_sfence();
+                memcpy( dst + i, src + i, n - i );
+            }
+
+            __attribute__((target("avx512f")))
+            void streamCopyAvx512(char* dst, char const* src, size_t n)
+            {
+                size_t i = alignHead(dst, src, n, 64);
+                for( ; i + 128 <= n; i += 128 ) {
+                    __m512i a = _mm512_loadu_si512( src + i      );
+                    __m512i b = _mm512_loadu_si512( src + i + 64 );
+                    _mm512_stream_si512( (__m512i*)(dst + i     ), a );
+                    _mm512_stream_si512( (__m512i*)(dst + i + 64), b );
+                }
+                for( ; i + 64 <= n; i += 64 )
+                    _mm512_stream_si512( (__m512i*)(dst + i), _mm512_loadu_si512( src + i ) );
+                _mm_sfence();
+                memcpy( dst + i, src + i, n - i );
+            }
+#endif
+         //----------------------------------------------------------------------------------------
+            size_t& currentStreamingThreshold()
+            {
+                static size_t threshold = 1 << 20;
+                return threshold;
+            }
+
+            bool hasF16c()
+            {
+#if MPI12S_X86
+                __builtin_cpu_init();
+                static bool const f16c = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+                return f16c;
+#else
+                return false;
+#endif
+            }
+
+            Isa supportedIsa()
+            {
+#if MPI12S_X86
+                __builtin_cpu_init();
+                if( __builtin_cpu_supports("avx512f") )
+                    return AVX512;
+                if( __builtin_cpu_supports("avx2") )
+                    return AVX2;
+#endif
+                return SCALAR;
+            }
+
+            Isa& currentIsa()
+            {
+                static Isa isa = supportedIsa();
+                return isa;
+            }
+        }// anonymous namespace
+
+        Isa isa()
+        {
+            return currentIsa();
+        }
+
+        Isa setIsa(Isa isa)
+        {
+            Isa supported = supportedIsa();
+            currentIsa() = ( isa <= supported ? isa : supported );
+            return currentIsa();
+        }
+
+        char const* isaName(Isa isa)
+        {
+            switch(isa) {
+                case SCALAR: return "SCALAR";
+                case AVX2  : return "AVX2";
+                case AVX512: return "AVX512";
+            }
+            return "?";
+        }
+
+        void
+        gather(void* dst, void const* array, size_t arraySize, size_t elementSize, Index_t const* indices, size_t n)
+        {
+            char*       d = static_cast<char*>(dst);
+            char const* a = static_cast<char const*>(array);
+            size_t i = 0;
+#if MPI12S_X86
+            switch( currentIsa() ) {
+                case AVX512: i = gatherAvx512(d, a, arraySize, elementSize, indices, n); break;
+                case AVX2  : i = gatherAvx2  (d, a, arraySize, elementSize, indices, n); break;
+                case SCALAR: break;
+            }
+#endif
+         // the remainder
+            gatherScalar( d + i*elementSize, a, elementSize, indices + i, n - i );
+        }
+
+        void
+        scatter(void* array, size_t /*arraySize*/, void const* src, size_t elementSize, Index_t const* indices, size_t n)
+        {
+            char*       a = static_cast<char*>(array);
+            char const* s = static_cast<char const*>(src);
+            size_t i = 0;
+#if MPI12S_X86
+            if( currentIsa() == AVX512 )
+                i = scatterAvx512(a, s, elementSize, indices, n);
+#endif
+         // the remainder
+            scatterScalar( a, s + i*elementSize, elementSize, indices + i, n - i );
+        }
+
+     //--------------------------------------------------------------------------------------------
+     // float16 conversions, after F. Giesen, https://gist.github.com/rygorous/2156668
+        uint16_t floatToHalf(float f)
+        {
+            uint32_t const f32infty = 255u << 23;
+            uint32_t const f16max   = (127u + 16) << 23;
+            uint32_t const denormMagicBits = ((127u - 15) + (23 - 10) + 1) << 23;
+            float denormMagic;
+            memcpy( &denormMagic, &denormMagicBits, sizeof(float) );
+
+            uint32_t bits;
+            memcpy( &bits, &f, sizeof(float) );
+            uint32_t sign = bits & 0x80000000u;
+            bits ^= sign;
+            uint16_t h;
+            if( bits >= f16max )                 // overflow, inf or nan
+                h = ( bits > f32infty ? 0x7e00 : 0x7c00 );
+            else if( bits < (113u << 23) )       // subnormal or zero: let the fpu do the rounding
+            {
+                float g;
+                memcpy( &g, &bits, sizeof(float) );
+                g += denormMagic;
+                uint32_t gbits;
+                memcpy( &gbits, &g, sizeof(float) );
+                h = uint16_t(gbits - denormMagicBits);
+            } else {                             // normal: rebias the exponent and round to nearest even
+                uint32_t mantissaOdd = (bits >> 13) & 1;
+                bits += (uint32_t(15 - 127) << 23) + 0xfff;
+                bits += mantissaOdd;
+                h = uint16_t(bits >> 13);
+            }
+            return h | uint16_t(sign >> 16);
+        }
+
+        float halfToFloat(uint16_t h)
+        {
+            uint32_t const magicBits = 113u << 23;
+            uint32_t const shiftedExp = 0x7c00u << 13; // exponent mask after shift
+            float magic;
+            memcpy( &magic, &magicBits, sizeof(float) );
+
+            uint32_t bits = uint32_t(h & 0x7fff) << 13;
+            uint32_t exp = shiftedExp & bits;
+            bits += (127u - 15) << 23;                 // rebias the exponent
+            if( exp == shiftedExp )                    // inf or nan
+                bits += (128u - 16) << 23;
+            else if( exp == 0 ) {                      // zero or subnormal: renormalize
+                bits += 1u << 23;
+                float f;
+                memcpy( &f, &bits, sizeof(float) );
+                f -= magic;
+                memcpy( &bits, &f, sizeof(float) );
+            }
+            bits |= uint32_t(h & 0x8000) << 16;
+            float f;
+            memcpy( &f, &bits, sizeof(float) );
+            return f;
+        }
+
+        void
+        floatToHalf(uint16_t* dst, float const* src, size_t n)
+        {
+            size_t i = 0;
+#if MPI12S_X86
+            if( currentIsa() != SCALAR && hasF16c() )
+                i = floatToHalfF16c(dst, src, n);
+#endif
+         // the remainder
+            for( ; i < n; ++i )
+                dst[i] = floatToHalf(src[i]);
+        }
+
+        void
+        halfToFloat(float* dst, uint16_t const* src, size_t n)
+        {
+            size_t i = 0;
+#if MPI12S_X86
+            if( currentIsa() != SCALAR && hasF16c() )
+                i = halfToFloatF16c(dst, src, n);
+#endif
+            for( ; i < n; ++i )
+                dst[i] = halfToFloat(src[i]);
+        }
+
+     //--------------------------------------------------------------------------------------------
+        void
+        streamCopy(void* dst, void const* src, size_t n)
+        {
+#if MPI12S_X86
+            char*       d = static_cast<char*>(dst);
+            char const* s = static_cast<char const*>(src);
+            switch( currentIsa() ) {
+                case AVX512: streamCopyAvx512(d, s, n); break;
+                case AVX2  : streamCopyAvx   (d, s, n); break;
+                case SCALAR: streamCopySse2  (d, s, n); break;
+            }
+#else
+            memcpy( dst, src, n );
+#endif
+        }
+
+        void
+        copy(void* dst, void const* src, size_t n)
+        {
+            if( n >= currentStreamingThreshold() )
+                streamCopy(dst, src, n);
+            else
+                memcpy( dst, src, n );
+        }
+
+        size_t streamingThreshold()
+        {
+            return currentStreamingThreshold();
+        }
+
+        void setStreamingThreshold(size_t nBytes)
+        {
+            currentStreamingThreshold() = nBytes;
+        }
+    }// namespace simd
+}// namespace mpi12s
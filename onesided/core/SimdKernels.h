@@ -0,0 +1,72 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "types.h"
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Gather and scatter kernels for the indexed elements of an array, as used for packing and unpacking
+ // particle properties (IndexedMessageItem, PropertySet):
+ //     gather : dst[i]            = array[indices[i]], i = 0..n-1
+ //     scatter: array[indices[i]] = src[i]           , i = 0..n-1
+ // The elements are elementSize bytes, the dst and src buffers are contiguous. On x86, the instruction
+ // set is selected at run time (__builtin_cpu_supports):
+ //   - 4 and 8 byte elements (float, int, double, ...): AVX-512 and AVX2 gather instructions, and
+ //     AVX-512 scatter instructions,
+ //   - 12 byte elements (Eigen::Matrix<float,3,1,DontAlign>): overlapping 16 byte loads and stores,
+ //     where they stay within the array and the buffer,
+ // with a scalar fallback for the other sizes and on other architectures.
+ //------------------------------------------------------------------------------------------------
+    namespace simd
+    {
+        enum Isa { SCALAR, AVX2, AVX512 };
+
+     // The instruction set used by gather() and scatter(), the best one supported by the cpu, unless
+     // set by setIsa() (for testing and benchmarking). setIsa() does not go beyond what the cpu supports.
+        Isa isa();
+        Isa setIsa(Isa isa); // returns the instruction set that will be used
+        char const* isaName(Isa isa);
+
+        void gather
+          ( void* dst                 // the contiguous buffer, n*elementSize bytes
+          , void const* array         // the array to gather from
+          , size_t arraySize          // the number of elements in array
+          , size_t elementSize        // in bytes
+          , Index_t const* indices
+          , size_t n                  // the number of indices
+          );
+        void scatter
+          ( void* array               // the array to scatter to
+          , size_t arraySize          // the number of elements in array
+          , void const* src           // the contiguous buffer, n*elementSize bytes
+          , size_t elementSize        // in bytes
+          , Index_t const* indices
+          , size_t n                  // the number of indices
+          );
+
+     // Conversion of floats to IEEE 754 half precision floats (float16, round to nearest even) and back.
+     // Uses the F16C instructions if the cpu supports them, unless setIsa(SCALAR) was called.
+        void floatToHalf(uint16_t* dst, float const* src, size_t n);
+        void halfToFloat(float* dst, uint16_t const* src, size_t n);
+     // the scalar conversions
+        uint16_t floatToHalf(float f);
+        float    halfToFloat(uint16_t h);
+
+     // Copy n bytes from src to dst, as memcpy. Copies of at least streamingThreshold() bytes use
+     // non-temporal (streaming) stores, which bypass the cache: packing or unpacking a large message
+     // then does not evict the working set of the computation with data that it will not touch. The
+     // stores use the widest vectors allowed by isa(), SSE2 for SCALAR. Other architectures use memcpy.
+        void copy(void* dst, void const* src, size_t n);
+     // Copy n bytes with streaming stores, irrespective of the threshold.
+        void streamCopy(void* dst, void const* src, size_t n);
+     // The threshold, in bytes, for streaming stores in copy() (default 1 MiB). SIZE_MAX disables them.
+        size_t streamingThreshold();
+        void setStreamingThreshold(size_t nBytes);
+    }// namespace simd
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // SIMDKERNELS_H
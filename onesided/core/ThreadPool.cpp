@@ -0,0 +1,186 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class ThreadPool
+ //------------------------------------------------------------------------------------------------
+    namespace
+    {// The ThreadPool the calling thread is a worker of, if any, and the index of its queue.
+        thread_local ThreadPool* workerOf = nullptr;
+        thread_local size_t      workerIndex = 0;
+    }
+
+    ThreadPool::
+    ThreadPool(size_t nWorkers)
+      : nQueued_(0)
+      , nextQueue_(0)
+      , nSteals_(0)
+      , stop_(false)
+    {
+        for( size_t i = 0; i <= nWorkers; ++i )
+            queues_.emplace_back( new Queue );
+        for( size_t i = 0; i < nWorkers; ++i )
+            workers_.emplace_back( [this,i]() { work_(i); } );
+    }
+
+    size_t
+    ThreadPool::
+    defaultNWorkers()
+    {
+        size_t n = std::thread::hardware_concurrency();
+        return ( n > 1 ? n - 1 : 0 );
+    }
+
+    ThreadPool::
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        wakeUp_.notify_all();
+        for( auto& worker : workers_ )
+            worker.join();
+    }
+
+    void
+    ThreadPool::
+    notifySleepers_()
+    {// Lock, so that a thread about to sleep does not miss the notification.
+        { std::lock_guard<std::mutex> lock(sleepMutex_); }
+        wakeUp_.notify_all();
+    }
+
+    void
+    ThreadPool::
+    submit(Task_t task)
+    {
+        submit(defaultGroup_, std::move(task));
+    }
+
+    void
+    ThreadPool::
+    submit(TaskGroup& group, Task_t task)
+    {
+        ++group.nPending_;
+        size_t q = ( workerOf == this ? workerIndex : nextQueue_++ % queues_.size() );
+        ++nQueued_; // before the push, so that nQueued_ never underflows.
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex_);
+            queues_[q]->entries_.push_back( Entry{std::move(task), &group} );
+        }
+        notifySleepers_();
+    }
+
+    bool
+    ThreadPool::
+    get_(Entry& entry, TaskGroup const* group)
+    {
+        if( nQueued_ == 0 )
+            return false;
+        size_t const nQueues = queues_.size();
+        size_t const self = ( workerOf == this ? workerIndex : nQueues - 1 );
+        auto ofGroup = [group](Entry const& e) { return !group || e.group == group; };
+     // my own queue, most recent task first
+        {
+            Queue& queue = *queues_[self];
+            std::lock_guard<std::mutex> lock(queue.mutex_);
+            auto found = std::find_if( queue.entries_.rbegin(), queue.entries_.rend(), ofGroup );
+            if( found != queue.entries_.rend() ) {
+                entry = std::move(*found);
+                queue.entries_.erase( std::next(found).base() );
+                --nQueued_;
+                return true;
+            }
+        }
+     // steal the oldest task of another queue
+        for( size_t i = 1; i < nQueues; ++i )
+        {
+            Queue& queue = *queues_[(self + i) % nQueues];
+            std::lock_guard<std::mutex> lock(queue.mutex_);
+            auto found = std::find_if( queue.entries_.begin(), queue.entries_.end(), ofGroup );
+            if( found != queue.entries_.end() ) {
+                entry = std::move(*found);
+                queue.entries_.erase(found);
+                --nQueued_;
+                ++nSteals_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void
+    ThreadPool::
+    execute_(Entry& entry)
+    {
+        TaskGroup& group = *entry.group;
+        try {
+            entry.task();
+        } catch(...) {
+            std::lock_guard<std::mutex> lock(group.mutex_);
+            if( !group.exception_ )
+                group.exception_ = std::current_exception();
+        }
+        entry.task = nullptr; // release the resources of the task before the group is finished
+        if( --group.nPending_ == 0 )
+            notifySleepers_();
+    }
+
+    void
+    ThreadPool::
+    work_(size_t index)
+    {
+        workerOf = this;
+        workerIndex = index;
+        for(;;)
+        {
+            Entry entry;
+            if( get_(entry) ) {
+                execute_(entry);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wakeUp_.wait( lock, [this]() { return stop_ || nQueued_ > 0; } );
+            if( stop_ && nQueued_ == 0 )
+                return;
+        }
+    }
+
+    void
+    ThreadPool::
+    wait()
+    {
+        wait(defaultGroup_);
+    }
+
+    void
+    ThreadPool::
+    wait(TaskGroup& group)
+    {// help executing the tasks of the group until it is finished. Executing tasks of other groups
+     // here could modify the state of the waiting task, e.g. the MessageBuffer it is packing into.
+        while( group.nPending_ > 0 )
+        {
+            Entry entry;
+            if( get_(entry, &group) ) {
+                execute_(entry);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wakeUp_.wait_for( lock, std::chrono::microseconds(100)
+                            , [&group]() { return group.nPending_ == 0; } );
+        }
+        std::lock_guard<std::mutex> lock(group.mutex_);
+        if( group.exception_ ) {
+            std::exception_ptr e = group.exception_;
+            group.exception_ = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,103 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <memory>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+    class ThreadPool
+ // A work-stealing scheduler: a fixed set of worker threads, each with its own task queue. A worker 
+ // executes the tasks in its own queue, most recent first, and when that is empty, it steals the 
+ // oldest tasks of the other queues. Tasks submitted by a worker go to its own queue, tasks submitted
+ // by other threads are distributed over the queues.
+ // Tasks belong to a TaskGroup. Waiting for a group does not block the thread, it executes the tasks
+ // of the group until the group is finished. Hence, tasks may submit tasks and wait for them, e.g.
+ // to split a large copy in chunks. A ThreadPool without worker threads executes the tasks serially
+ // in wait().
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        typedef std::function<void()> Task_t;
+
+        class TaskGroup
+        {
+            friend class ThreadPool;
+        public:
+            TaskGroup() : nPending_(0) {}
+        private:
+            std::atomic<size_t> nPending_; // tasks submitted, but not yet finished.
+            std::mutex          mutex_;
+            std::exception_ptr  exception_;
+        };
+
+        ThreadPool
+          ( size_t nWorkers = defaultNWorkers() // number of worker threads
+          );
+        ~ThreadPool();
+
+     // Add a task to the default group.
+        void submit(Task_t task);
+     // Add a task to group.
+        void submit(TaskGroup& group, Task_t task);
+
+     // Wait until all tasks of the default group are finished. If a task threw an exception, the first
+     // exception thrown is rethrown here. A task must not wait for the default group.
+        void wait();
+     // Wait until all tasks of group are finished.
+        void wait(TaskGroup& group);
+
+     // number of worker threads
+        inline size_t nWorkers() const { return workers_.size(); }
+     // number of tasks that were stolen from another queue than the queue of the executing thread.
+        inline size_t nSteals() const { return nSteals_; }
+
+     // One worker less than the number of hardware threads, as the thread calling wait() also works. 
+        static size_t defaultNWorkers();
+
+    private:
+        ThreadPool(ThreadPool const&); // prevent object copy
+
+        struct Entry
+        {
+            Task_t     task;
+            TaskGroup* group;
+        };
+        struct Queue
+        {
+            std::mutex        mutex_;
+            std::deque<Entry> entries_;
+        };
+
+     // The loop executed by the worker threads
+        void work_(size_t index);
+     // Get a task (of group, if not nullptr): from the own queue of the calling thread (if it is a worker),
+     // or stolen from another queue.
+        bool get_(Entry& entry, TaskGroup const* group = nullptr);
+     // Execute a task, and record its exception, if any. 
+        void execute_(Entry& entry);
+     // Wake up the sleeping threads (workers or waiting threads).
+        void notifySleepers_();
+
+        std::vector<std::unique_ptr<Queue>> queues_; // one per worker, plus one for the other threads
+        std::vector<std::thread> workers_;
+        std::mutex               sleepMutex_;
+        std::condition_variable  wakeUp_;
+        std::atomic<size_t>      nQueued_;
+        std::atomic<size_t>      nextQueue_; // round robin distribution of the tasks of other threads
+        std::atomic<size_t>      nSteals_;
+        bool                     stop_;
+        TaskGroup                defaultGroup_;
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // THREADPOOL_H
@@ -0,0 +1,243 @@
+#include "Transport.h"
+
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <cstring>
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class MpiTransport
+ //------------------------------------------------------------------------------------------------
+    void
+    MpiTransport::
+    bcast(Index_t* buffer, Index_t nwords, int root)
+    {
+        MPI_Bcast( buffer, nwords, MPI_LONG_LONG_INT, root, MPI_COMM_WORLD );
+    }
+
+    void
+    MpiTransport::
+    isend(Index_t const* buffer, Index_t nwords, int destination, int tag)
+    {
+        requests_.push_back(MPI_REQUEST_NULL);
+        MPI_Isend( buffer, nwords, MPI_LONG_LONG_INT, destination, tag, MPI_COMM_WORLD, &requests_.back() );
+    }
+
+    void
+    MpiTransport::
+    irecv(Index_t* buffer, Index_t nwords, int source, int tag)
+    {
+        requests_.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv( buffer, nwords, MPI_LONG_LONG_INT, source, tag, MPI_COMM_WORLD, &requests_.back() );
+    }
+
+    void
+    MpiTransport::
+    ibcast(Index_t* buffer, Index_t nwords, int root)
+    {
+        requests_.push_back(MPI_REQUEST_NULL);
+        MPI_Ibcast( buffer, nwords, MPI_LONG_LONG_INT, root, MPI_COMM_WORLD, &requests_.back() );
+    }
+
+    void
+    MpiTransport::
+    isend(void const* buffer, MPI_Datatype datatype, int destination, int tag)
+    {
+        requests_.push_back(MPI_REQUEST_NULL);
+        MPI_Isend( buffer, 1, datatype, destination, tag, MPI_COMM_WORLD, &requests_.back() );
+    }
+
+    void
+    MpiTransport::
+    irecv(void* buffer, MPI_Datatype datatype, int source, int tag)
+    {
+        requests_.push_back(MPI_REQUEST_NULL);
+        MPI_Irecv( buffer, 1, datatype, source, tag, MPI_COMM_WORLD, &requests_.back() );
+    }
+
+    bool
+    MpiTransport::
+    testAll()
+    {
+        int flag = 0;
+        MPI_Testall( static_cast<int>(requests_.size()), requests_.data(), &flag, MPI_STATUSES_IGNORE );
+        return flag;
+    }
+
+    void
+    MpiTransport::
+    waitAll()
+    {
+        MPI_Waitall( static_cast<int>(requests_.size()), requests_.data(), MPI_STATUSES_IGNORE );
+        requests_.clear();
+    }
+
+ //------------------------------------------------------------------------------------------------
+ // Implementation of class InProcessTransport
+ //------------------------------------------------------------------------------------------------
+    struct InProcessTransport::Shared
+    {
+        int                     size;
+        std::mutex              mutex_;
+        std::condition_variable changed_;
+     // point-to-point messages, by (source, destination, tag), in the order they were sent
+        std::map<std::tuple<int,int,int>,std::deque<Outgoing*>> mailboxes_;
+     // broadcasts, by (root, sequence number)
+        std::map<std::pair<int,size_t>,Outgoing*> bcasts_;
+    };
+
+    void
+    InProcessTransport::
+    run
+      ( int nranks
+      , std::function<void(InProcessTransport&)> body
+      )
+    {
+        Shared shared;
+        shared.size = nranks;
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> exceptions(nranks);
+        for( int r = 0; r < nranks; ++r )
+            threads.emplace_back( [&shared,&body,&exceptions,r]()
+            {
+                InProcessTransport transport(shared, r);
+                try {
+                    body(transport);
+                } catch(...) {
+                    exceptions[r] = std::current_exception();
+                }
+            });
+        for( auto& thread : threads )
+            thread.join();
+        for( auto& e : exceptions )
+            if( e ) std::rethrow_exception(e);
+    }
+
+    InProcessTransport::
+    InProcessTransport(Shared& shared, int rank)
+      : shared_(shared)
+      , rank_(rank)
+      , nBcasts_(shared.size, 0)
+    {}
+
+    int
+    InProcessTransport::
+    size() const
+    {
+        return shared_.size;
+    }
+
+    void
+    InProcessTransport::
+    bcast(Index_t* buffer, Index_t nwords, int root)
+    {
+        ibcast(buffer, nwords, root);
+        waitAll();
+    }
+
+    void
+    InProcessTransport::
+    isend(Index_t const* buffer, Index_t nwords, int destination, int tag)
+    {
+        std::lock_guard<std::mutex> lock(shared_.mutex_);
+        outgoing_.push_back( Outgoing{buffer, nwords, 1} );
+        shared_.mailboxes_[std::make_tuple(rank_, destination, tag)].push_back( &outgoing_.back() );
+        shared_.changed_.notify_all();
+    }
+
+    void
+    InProcessTransport::
+    irecv(Index_t* buffer, Index_t nwords, int source, int tag)
+    {
+        incoming_.push_back( Incoming{buffer, nwords, source, tag, 0, nullptr} );
+    }
+
+    void
+    InProcessTransport::
+    ibcast(Index_t* buffer, Index_t nwords, int root)
+    {
+        size_t sequence = nBcasts_[root]++;
+        if( root == rank_ ) {
+            if( shared_.size == 1 )
+                return;
+            std::lock_guard<std::mutex> lock(shared_.mutex_);
+            outgoing_.push_back( Outgoing{buffer, nwords, shared_.size - 1} );
+            shared_.bcasts_[std::make_pair(root, sequence)] = &outgoing_.back();
+            shared_.changed_.notify_all();
+        } else {
+            incoming_.push_back( Incoming{buffer, nwords, root, -1, sequence, nullptr} );
+        }
+    }
+
+    bool
+    InProcessTransport::
+    progress_(std::unique_lock<std::mutex>& lock)
+    {// Claim the outgoing buffers for my incoming buffers
+        std::vector<Incoming*> matched;
+        for( Incoming& in : incoming_ )
+        {
+            if( in.from )
+                continue;
+            if( in.tag == -1 ) {
+                auto found = shared_.bcasts_.find( std::make_pair(in.source, in.sequence) );
+                if( found != shared_.bcasts_.end() )
+                    in.from = found->second;
+            } else {
+                auto found = shared_.mailboxes_.find( std::make_tuple(in.source, rank_, in.tag) );
+                if( found != shared_.mailboxes_.end() && !found->second.empty() ) {
+                    in.from = found->second.front();
+                    found->second.pop_front();
+                }
+            }
+            if( in.from ) {
+                if( in.from->nwords != in.nwords ) {
+                    std::string errmsg = "InProcessTransport : rank " + std::to_string(rank_) + " expects "
+                                       + std::to_string(in.nwords) + " words from rank " + std::to_string(in.source)
+                                       + ", but " + std::to_string(in.from->nwords) + " words were sent.";
+                    throw std::runtime_error(errmsg);
+                }
+                matched.push_back(&in);
+            }
+        }
+        if( !matched.empty() )
+        {// Copy without holding the lock, the outgoing buffers remain valid until their readers are done.
+            lock.unlock();
+            for( Incoming* in : matched )
+                memcpy( in->buffer, in->from->buffer, in->nwords*sizeof(Index_t) );
+            lock.lock();
+            for( Incoming* in : matched ) {
+                if( --in->from->nReaders == 0 && in->tag == -1 )
+                    shared_.bcasts_.erase( std::make_pair(in->source, in->sequence) );
+            }
+            shared_.changed_.notify_all();
+        }
+     // complete?
+        for( Incoming const& in : incoming_ )
+            if( !in.from ) return false;
+        for( Outgoing const& out : outgoing_ )
+            if( out.nReaders > 0 ) return false;
+        return true;
+    }
+
+    bool
+    InProcessTransport::
+    testAll()
+    {
+        std::unique_lock<std::mutex> lock(shared_.mutex_);
+        return progress_(lock);
+    }
+
+    void
+    InProcessTransport::
+    waitAll()
+    {
+        std::unique_lock<std::mutex> lock(shared_.mutex_);
+        while( !progress_(lock) )
+            shared_.changed_.wait(lock);
+        incoming_.clear();
+        outgoing_.clear();
+    }
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
@@ -0,0 +1,150 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <mpi.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "types.h"
+#include "mpi12s.h"
+
+namespace mpi12s
+{
+ //------------------------------------------------------------------------------------------------
+    class Transport
+ // The communication primitives used by the (FLAT) exchange of a MessageBuffer. All buffers are
+ // arrays of Index_t words. The non-blocking operations are completed by waitAll(), which must be
+ // called before their buffers are touched again.
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        virtual ~Transport() {}
+
+        virtual int rank() const = 0;
+        virtual int size() const = 0;
+     // Is this the MPI transport? The other exchange modes than FLAT, and the mpi1s MessageBox,
+     // use MPI directly.
+        virtual bool isMpi() const { return false; }
+
+     // Broadcast nwords words from root to all ranks. Collective, blocking.
+        virtual void bcast(Index_t* buffer, Index_t nwords, int root) = 0;
+     // Non-blocking send, receive and broadcast. The broadcasts must be started in the same order
+     // on all ranks. Messages between the same source and destination with the same tag are
+     // matched in the order they were sent.
+        virtual void isend(Index_t const* buffer, Index_t nwords, int destination, int tag) = 0;
+        virtual void irecv(Index_t* buffer, Index_t nwords, int source, int tag) = 0;
+        virtual void ibcast(Index_t* buffer, Index_t nwords, int root) = 0;
+     // Test whether the pending non-blocking operations are complete (waitAll() must still be called).
+        virtual bool testAll() = 0;
+     // Complete the pending non-blocking operations.
+        virtual void waitAll() = 0;
+    };
+
+ //------------------------------------------------------------------------------------------------
+    class MpiTransport : public Transport
+ // Transport between the processes of MPI_COMM_WORLD.
+ //------------------------------------------------------------------------------------------------
+    {
+    public:
+        virtual int rank() const { return ::mpi12s::rank; }
+        virtual int size() const { return ::mpi12s::size; }
+        virtual bool isMpi() const { return true; }
+
+        virtual void bcast(Index_t* buffer, Index_t nwords, int root);
+        virtual void isend(Index_t const* buffer, Index_t nwords, int destination, int tag);
+        virtual void irecv(Index_t* buffer, Index_t nwords, int source, int tag);
+        virtual void ibcast(Index_t* buffer, Index_t nwords, int root);
+        virtual bool testAll();
+        virtual void waitAll();
+     // Non-blocking send and receive of one element of an MPI derived datatype (e.g. with absolute
+     // addresses and buffer=MPI_BOTTOM), completed by waitAll(). The datatype may be freed as soon
+     // as these return.
+        void isend(void const* buffer, MPI_Datatype datatype, int destination, int tag);
+        void irecv(void*       buffer, MPI_Datatype datatype, int source     , int tag);
+
+    private:
+        std::vector<MPI_Request> requests_;
+    };
+
+ //------------------------------------------------------------------------------------------------
+    class InProcessTransport : public Transport
+ // Transport between ranks that are threads of this process, through shared-memory mailboxes.
+ // A message is copied once, from the sender's buffer into the receiver's buffer, by the receiver.
+ // No MPI is needed (nor an MPI launcher). Typical use:
+ //
+ //     InProcessTransport::run( 4, [](InProcessTransport& transport)
+ //     {// this is executed by 4 threads, with transport.rank() = 0,1,2,3
+ //         MessageBuffer messageBuffer(transport);
+ //         messageBuffer.initialize(1000,10);
+ //         MyMessageHandler mh(messageBuffer);
+ //         ...
+ //         mh.postMessage(to_rank);
+ //         messageBuffer.broadcast();
+ //         messageBuffer.readMessages();
+ //         messageBuffer.clear();
+ //     });
+ //
+ // The globals ::mpi12s::rank, ::mpi12s::size and ::mpi12s::theMessageBuffer belong to the process,
+ // the ranks must use transport.rank(), transport.size() and their own MessageBuffer instead.
+ //------------------------------------------------------------------------------------------------
+    {
+        struct Shared; // the mailboxes shared by all the ranks
+    public:
+     // Run body on nranks threads, each with its own InProcessTransport, and wait for them to
+     // finish. An exception thrown by body is rethrown here (the first one, if several ranks throw).
+        static void run
+          ( int nranks
+          , std::function<void(InProcessTransport&)> body
+          );
+
+        virtual int rank() const { return rank_; }
+        virtual int size() const;
+
+        virtual void bcast(Index_t* buffer, Index_t nwords, int root);
+        virtual void isend(Index_t const* buffer, Index_t nwords, int destination, int tag);
+        virtual void irecv(Index_t* buffer, Index_t nwords, int source, int tag);
+        virtual void ibcast(Index_t* buffer, Index_t nwords, int root);
+        virtual bool testAll();
+        virtual void waitAll();
+
+    private:
+        InProcessTransport(Shared& shared, int rank);
+        InProcessTransport(InProcessTransport const&); // prevent object copy
+
+     // A buffer made available to other ranks by isend() or ibcast(). It is complete when nReaders
+     // reached 0.
+        struct Outgoing
+        {
+            Index_t const* buffer;
+            Index_t        nwords;
+            int            nReaders;
+        };
+     // A buffer waiting for the contents of an Outgoing.
+        struct Incoming
+        {
+            Index_t*  buffer;
+            Index_t   nwords;
+            int       source;
+            int       tag;
+            size_t    sequence; // broadcasts only
+            Outgoing* from;     // set when matched
+        };
+     // Match the incoming buffers with the available outgoing buffers, and copy. Returns true if all
+     // pending operations of this rank are complete. shared_.mutex_ must be locked by lock.
+        bool progress_(std::unique_lock<std::mutex>& lock);
+
+        Shared&               shared_;
+        int                   rank_;
+        std::deque<Outgoing>  outgoing_; // a deque, because the mailboxes keep pointers to its elements
+        std::vector<Incoming> incoming_;
+        std::vector<size_t>   nBcasts_;  // number of broadcasts started, per root
+    };
+ //------------------------------------------------------------------------------------------------
+}// namespace mpi12s
+
+#endif // TRANSPORT_H
@@ -12,12 +12,28 @@
 namespace py = pybind11;
 
 #include "mpi12s.cpp"
+#include "NodeTopology.cpp"
+#include "ExchangeTuner.cpp"
+#include "ThreadPool.cpp"
+#include "SimdKernels.cpp"
+#include "Compression.cpp"
+#include "Transport.cpp"
 #include "MessageBuffer.cpp"
 #include "MessageBox.cpp"
 #include "Message.cpp"
+#include "PropertySet.cpp"
+#include "Encoding.cpp"
 #include "MessageHandler.cpp"
+#include "Coroutine.cpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <map>
+#include <random>
 
 
 using namespace mpi12s;
@@ -838,6 +854,2357 @@ namespace test6
  //---------------------------------------------------------------------------------------------------------------------
 }// namespace test6
 
+namespace test7
+{//---------------------------------------------------------------------------------------------------------------------
+ // Adaptive sizing of theMessageBuffer: start with a buffer that is far too small, and verify
+ // that it grows when messages are posted and received, and that it shrinks after quiet steps.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        std::vector<int> a_;
+    public:
+        MessageHandler()
+        {
+            message().push_back(a_);
+        }
+
+        void postMessage(int n, int to_rank)
+        {
+            a_.resize(n);
+            for( int i = 0; i < n; ++i )
+                a_[i] = 1000*rank + i;
+            MessageHandlerBase::postMessage(to_rank);
+            a_.clear();
+        }
+
+        bool verify(int n)
+        {
+            int const from_rank = next_rank(-1);
+            bool ok = (a_.size() == static_cast<size_t>(n));
+            for( int i = 0; ok && i < n; ++i )
+                ok &= (a_[i] == 1000*from_rank + i);
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+     // Deliberately too small: room for 1 message of 4 words.
+        ::mpi12s::theMessageBuffer.initialize(4, 1);
+        ::mpi12s::theMessageBuffer.setShrinkAfter(2);
+
+        bool ok = true;
+        MessageHandler mh0, mh1;
+        int const n = 200;
+        mh0.postMessage(n  , next_rank());
+        mh1.postMessage(n/2, next_rank());
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+        ok &= mh0.verify(n);
+        ok &= mh1.verify(n/2);
+        prdbg("test7 after exchange", ::mpi12s::theMessageBuffer.statisticsToStr());
+
+     // The buffer must have grown to hold the 2 messages posted and (at least) the 2 messages received.
+        ok &= ::mpi12s::theMessageBuffer.hwmMessages() >= 4;
+        ok &= ::mpi12s::theMessageBuffer.hwmPayload()  >= 2*(1 + n/2 + 1 + n/4);
+        ok &= ::mpi12s::theMessageBuffer.payloadSize() >= ::mpi12s::theMessageBuffer.hwmPayload();
+        ::mpi12s::theMessageBuffer.clear();
+
+     // Two quiet steps (no messages) shrink the buffer back to its initial size.
+        Index_t grown = ::mpi12s::theMessageBuffer.payloadSize();
+        for( int step = 0; step < 2; ++step ) {
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+        }
+        prdbg("test7 after quiet steps", ::mpi12s::theMessageBuffer.statisticsToStr());
+        ok &= ::mpi12s::theMessageBuffer.payloadSize() < grown;
+        ok &= ::mpi12s::theMessageBuffer.payloadSize() == 4;
+
+        std::cout<<::mpi12s::info<<" done"<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test7
+
+namespace test8
+{//---------------------------------------------------------------------------------------------------------------------
+ // Multicast: every rank posts one message to all other ranks. The payload is stored only once.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        std::vector<int> a_;
+    public:
+        std::vector<int> received_from_;
+        bool ok_ = true;
+
+        MessageHandler()
+        {
+            message().push_back(a_);
+        }
+
+        void postMessage(std::vector<int> const& to_ranks)
+        {
+            a_ = {rank, rank, rank};
+            MessageHandlerBase::postMessage(to_ranks);
+            a_.clear();
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            if(ok)
+            {
+                int from_rank = ::mpi12s::theMessageBuffer.messageSource(msg_id);
+                received_from_.push_back(from_rank);
+                ok_ &= (a_.size() == 3);
+                for( auto ai : a_ )
+                    ok_ &= (ai == from_rank);
+            }
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+
+        MessageHandler mh;
+        std::vector<int> to_ranks;
+        for( int r = 0; r < ::mpi12s::size; ++r )
+            if( r != rank ) to_ranks.push_back(r);
+        mh.postMessage(to_ranks);
+
+        bool ok = true;
+     // one header per destination, but only one payload: (1 size_t + 3 ints) -> 3 words
+        ok &= (::mpi12s::theMessageBuffer.nMessages() == (Index_t)to_ranks.size());
+        ok &= (::mpi12s::theMessageBuffer.payloadSizeUsed() == 3);
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        ok &= mh.ok_;
+        ok &= (mh.received_from_ == to_ranks);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test8
+
+namespace test9
+{//---------------------------------------------------------------------------------------------------------------------
+ // Broadcast messages: every rank broadcasts its "domain boundaries" to all other ranks, and
+ // rank 0 also broadcasts a global parameter. A point-to-point message is exchanged as well.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        std::vector<double> bounds_;
+    public:
+        std::vector<int> received_from_;
+        bool ok_ = true;
+
+        MessageHandler()
+        {
+            message().push_back(bounds_);
+        }
+
+        void postMessageToAll()
+        {
+            bounds_ = {1.0*rank, rank + 1.0};
+            MessageHandlerBase::postMessageToAll();
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            if(ok)
+            {
+                int from_rank = ::mpi12s::theMessageBuffer.messageSource(msg_id);
+                received_from_.push_back(from_rank);
+                ok_ &= (bounds_.size() == 2) && (bounds_[0] == from_rank) && (bounds_[1] == from_rank + 1);
+            }
+            return ok;
+        }
+    };
+
+    class ParameterHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        double dt = 0;
+        ParameterHandler()
+        {
+            message().push_back(dt);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+
+        MessageHandler mh;
+        ParameterHandler ph;
+        test6::ParticleContainer pc(8);
+        test6::MessageHandler pch(pc);
+
+        mh.postMessageToAll();
+        if( rank == 0 ) {
+            ph.dt = 0.125;
+            ph.postMessageToAll();
+        }
+        std::vector<int> indices = {1,3,5,7};
+        pch.postMessage(indices, next_rank());
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        bool ok = mh.ok_;
+        std::vector<int> expected;
+        for( int r = 0; r < ::mpi12s::size; ++r )
+            if( r != rank ) expected.push_back(r);
+        std::sort(mh.received_from_.begin(), mh.received_from_.end());
+        ok &= (mh.received_from_ == expected);
+        ok &= (ph.dt == 0.125);
+     // the point-to-point message was received as well:
+        int const prev_rank = next_rank(-1);
+        for( int i = 1; i < 8; i += 2 ) {
+            ok &= pc.is_alive(i) && (pc.r[i] == 100*prev_rank + i);
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test9
+
+namespace test10
+{//---------------------------------------------------------------------------------------------------------------------
+ // Hierarchical (node-aware) exchange, with virtual nodes of 2 ranks: point-to-point, multicast and
+ // broadcast messages.
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::HIERARCHICAL, 2);
+
+        test9::MessageHandler bh;     // broadcast
+        test8::MessageHandler mh;     // multicast
+        test6::ParticleContainer pc(8);
+        test6::MessageHandler pch(pc);// point-to-point
+
+        bh.postMessageToAll();
+        std::vector<int> others;
+        for( int r = 0; r < ::mpi12s::size; ++r )
+            if( r != rank ) others.push_back(r);
+        mh.postMessage(others);
+        std::vector<int> indices = {1,3,5,7};
+        pch.postMessage(indices, next_rank());
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        bool ok = bh.ok_ && mh.ok_;
+        std::sort(bh.received_from_.begin(), bh.received_from_.end());
+        std::sort(mh.received_from_.begin(), mh.received_from_.end());
+        ok &= (bh.received_from_ == others);
+        ok &= (mh.received_from_ == others);
+        int const prev_rank = next_rank(-1);
+        for( int i = 1; i < 8; i += 2 ) {
+            ok &= pc.is_alive(i) && (pc.r[i] == 100*prev_rank + i) && (pc.m[i] == 100*prev_rank + i + 8);
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test10
+
+namespace test11
+{//---------------------------------------------------------------------------------------------------------------------
+ // ONESIDED exchange mode, and AUTO mode: the ExchangeTuner must time all strategies, and all ranks must
+ // select the same one. The messages must arrive correctly, whatever the strategy.
+    bool step(test7::MessageHandler& mh, test9::MessageHandler& bh, int n)
+    {
+        bh.received_from_.clear();
+        mh.postMessage(n, next_rank());
+        bh.postMessageToAll();
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+        ::mpi12s::theMessageBuffer.clear();
+        bool ok = mh.verify(n) && bh.ok_;
+        ok &= (static_cast<int>(bh.received_from_.size()) == ::mpi12s::size - 1);
+        return ok;
+    }
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        test7::MessageHandler mh;
+        test9::MessageHandler bh;
+
+        bool ok = true;
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::ONESIDED);
+        ok &= step(mh, bh, 10);
+        ok &= step(mh, bh, 500); // the payload arena grows, so the window must be recreated.
+
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::AUTO, 2);
+        ::mpi12s::ExchangeTuner& tuner = ::mpi12s::theMessageBuffer.exchangeTuner();
+        std::vector<int> used;
+        for( int i = 0; i < 8; ++i ) {
+            ok &= step(mh, bh, 20);
+            used.push_back( ::mpi12s::theMessageBuffer.lastExchangeMode() );
+        }
+        prdbg("test11 tuner", tuner.toStr());
+        ok &= tuner.tuned();
+     // all strategies were tried
+        for( int mode : {::mpi12s::MessageBuffer::FLAT, ::mpi12s::MessageBuffer::ONESIDED, ::mpi12s::MessageBuffer::HIERARCHICAL} )
+            ok &= std::find(used.begin(), used.end(), mode) != used.end();
+     // all ranks selected the same strategy, and used it after tuning
+        int selected[2] = { tuner.selected(), -tuner.selected() };
+        MPI_Allreduce(MPI_IN_PLACE, selected, 2, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        ok &= (selected[0] == -selected[1]);
+        ok &= (used.back() == tuner.selected());
+
+     // A shift in the traffic pattern restarts the trials
+        ok &= step(mh, bh, 2000);
+        ok &= !tuner.tuned();
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test11
+
+namespace test12
+{//---------------------------------------------------------------------------------------------------------------------
+ // Posting messages from several threads concurrently. Every thread packs its own message, the messages are
+ // merged into theMessageBuffer when the exchange starts.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        std::vector<int> a_;
+    public:
+        std::vector<int> received_;
+        bool ok_ = true;
+
+        MessageHandler()
+        {
+            message().push_back(a_);
+        }
+
+     // Thread-safe: uses a message that is private to the calling thread.
+        void postMessage(int thread, int n, int to_rank)
+        {
+            std::vector<int> a(n, 1000*rank + thread);
+            ::mpi12s::Message message;
+            message.push_back(a);
+            MessageHandlerBase::postMessage(message, to_rank);
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            if(ok)
+            {
+                int from_rank = ::mpi12s::theMessageBuffer.messageSource(msg_id);
+                int thread = a_[0] - 1000*from_rank;
+                received_.push_back(thread);
+                ok_ &= (static_cast<int>(a_.size()) == 100 + thread);
+                for( auto ai : a_ )
+                    ok_ &= (ai == 1000*from_rank + thread);
+            }
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(10, 2);
+        MessageHandler mh;
+
+        int const nthreads = 4;
+        bool ok = true;
+        for( int step = 0; step < 2; ++step )
+        {
+            std::vector<std::thread> threads;
+            for( int t = 0; t < nthreads; ++t )
+                threads.emplace_back( [&mh,t]() {
+                    for( int i = 0; i < 10; ++i ) // only the last one is posted to the next rank, the others to the previous
+                        mh.postMessage(t, 100 + t, (i == 9 ? next_rank() : next_rank(-1)));
+                });
+            for( auto& thread : threads )
+                thread.join();
+         // The main thread posts too
+            mh.postMessage(nthreads, 100 + nthreads, next_rank());
+
+            mh.received_.clear();
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+
+            std::sort(mh.received_.begin(), mh.received_.end());
+            std::vector<int> expected;
+            for( int t = 0; t <= nthreads; ++t ) {
+                expected.push_back(t);
+             // the other messages come from next_rank() (a rank does not read its own messages, so
+             // next_rank(2) would not do for 2 ranks)
+                if( t < nthreads )
+                    for( int i = 0; i < 9; ++i ) expected.push_back(t);
+            }
+            std::sort(expected.begin(), expected.end());
+            ok &= mh.ok_ && (mh.received_ == expected);
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test12
+
+namespace test13
+{//---------------------------------------------------------------------------------------------------------------------
+ // Reading the messages concurrently with a ThreadPool. The MessageHandlers verify that the guarantees of their
+ // ReadConcurrency are met.
+    std::atomic<int> nReading(0); // number of messages being read
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        ReadConcurrency readConcurrency_;
+        std::atomic<int> nReadingMine_;
+        std::mutex mutex_;
+    public:
+        std::vector<int> received_;
+        bool ok_ = true;
+
+        MessageHandler(ReadConcurrency readConcurrency)
+          : readConcurrency_(readConcurrency)
+          , nReadingMine_(0)
+        {}
+
+        virtual ReadConcurrency readConcurrency() const { return readConcurrency_; }
+
+        void postMessage(int i, int to_rank)
+        {
+            std::vector<int> a(10 + i, i);
+            ::mpi12s::Message message;
+            message.push_back(a);
+            MessageHandlerBase::postMessage(message, to_rank);
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            int n = ++nReading;
+            int m = ++nReadingMine_;
+            bool ok = true;
+            if( readConcurrency_ == EXCLUSIVE ) ok &= (n == 1);
+            if( readConcurrency_ == SERIAL    ) ok &= (m == 1);
+         // Every thread reads in its own message:
+            std::vector<int> a;
+            ::mpi12s::Message message;
+            message.push_back(a);
+            bool read = MessageHandlerBase::readMessage(message, msg_id);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            int i = a[0];
+            ok &= read && (static_cast<int>(a.size()) == 10 + i);
+            for( auto ai : a )
+                ok &= (ai == i);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                received_.push_back(i);
+                ok_ &= ok;
+            }
+            --nReadingMine_;
+            --nReading;
+            return read;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(10, 2);
+        MessageHandler mhReentrant(::mpi2s::MessageHandlerBase::REENTRANT);
+        MessageHandler mhSerial   (::mpi2s::MessageHandlerBase::SERIAL);
+        MessageHandler mhSerial2  (::mpi2s::MessageHandlerBase::SERIAL);
+        MessageHandler mhExclusive(::mpi2s::MessageHandlerBase::EXCLUSIVE);
+        ::mpi12s::ThreadPool pool(3);
+
+        bool ok = true;
+        for( int step = 0; step < 2; ++step )
+        {
+            for( int i = 0; i < 8; ++i ) {
+                mhReentrant.postMessage(i, next_rank());
+                mhSerial   .postMessage(i, next_rank());
+                mhSerial2  .postMessage(i, next_rank());
+                if( i%3 == 0 )
+                    mhExclusive.postMessage(i, next_rank());
+            }
+            for( auto mh : {&mhReentrant, &mhSerial, &mhSerial2, &mhExclusive} )
+                mh->received_.clear();
+
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages(pool);
+            ::mpi12s::theMessageBuffer.clear();
+
+            std::vector<int> expected = {0, 1, 2, 3, 4, 5, 6, 7};
+         // SERIAL and EXCLUSIVE messages are read in order
+            ok &= (mhSerial .received_ == expected);
+            ok &= (mhSerial2.received_ == expected);
+            ok &= (mhExclusive.received_ == std::vector<int>({0, 3, 6}));
+            std::sort(mhReentrant.received_.begin(), mhReentrant.received_.end());
+            ok &= (mhReentrant.received_ == expected);
+            for( auto mh : {&mhReentrant, &mhSerial, &mhSerial2, &mhExclusive} )
+                ok &= mh->ok_;
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test13
+
+namespace test14
+{//---------------------------------------------------------------------------------------------------------------------
+ // Non-blocking broadcast, overlapped with computation, while a progress thread drives the transfer.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<int> a_;
+        MessageHandler()
+        {
+            message().push_back(a_);
+        }
+    };
+
+    bool test()
+    {
+        init(::mpi12s::MULTIPLE_PROGRESS);
+        bool ok = ::mpi12s::progressThreadRunning();
+        ::mpi12s::theMessageBuffer.initialize(100, 2);
+        MessageHandler mhSmall, mhLarge;
+
+        for( int step = 0; step < 2; ++step )
+        {
+            mhSmall.a_.assign(10, rank);
+            mhSmall.postMessage(next_rank(-1));
+            mhLarge.a_.assign(1000000, rank);  // large enough for a rendez-vous protocol
+            mhLarge.postMessage(next_rank());
+
+            ::mpi12s::theMessageBuffer.startBroadcast();
+            ok &= ::mpi12s::theMessageBuffer.broadcastInProgress();
+         // Posting in the MessageBuffer is not allowed now
+            try {
+                mhSmall.postMessage(next_rank());
+                ok = false;
+            } catch( std::runtime_error& e ) {}
+         // compute
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ::mpi12s::theMessageBuffer.finishBroadcast();
+            ok &= !::mpi12s::theMessageBuffer.broadcastInProgress();
+
+            mhSmall.a_.clear();
+            mhLarge.a_.clear();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+
+            ok &= (mhSmall.a_ == std::vector<int>(10, next_rank()));
+            ok &= (mhLarge.a_ == std::vector<int>(1000000, next_rank(-1)));
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test14
+
+namespace test15
+{//---------------------------------------------------------------------------------------------------------------------
+ // Ranks as threads of this process, exchanging messages through an InProcessTransport. No MPI needed.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<int> a_;
+        std::vector<int> received_; // a_[0] of the messages received
+        MessageHandler(::mpi12s::MessageBuffer& messageBuffer)
+          : ::mpi2s::MessageHandlerBase(messageBuffer)
+        {
+            message().push_back(a_);
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            received_.push_back(a_[0]);
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        int const nranks = 4;
+        std::vector<int> oks(nranks, 0);
+        ::mpi12s::InProcessTransport::run( nranks, [&oks](::mpi12s::InProcessTransport& transport)
+        {
+            int const rank = transport.rank();
+            int const size = transport.size();
+            auto next = [&](int n) { return (rank + n + size) % size; };
+
+            ::mpi12s::MessageBuffer messageBuffer(transport);
+            messageBuffer.initialize(10, 2); // small, to have it grow
+            MessageHandler mh(messageBuffer);
+            MessageHandler mhToAll(messageBuffer);
+            bool ok = true;
+            for( int step = 0; step < 3; ++step )
+            {
+                mh.a_.assign(100*(step + 1), 100*rank + 1);
+                mh.postMessage(next(1));
+                mh.a_.assign(10, 100*rank + 2);
+                mh.postMessage(std::vector<int>({next(1), next(2)}));
+                mhToAll.a_.assign(5, 100*rank + 3);
+                mhToAll.postMessageToAll();
+
+                mh.received_.clear();
+                mhToAll.received_.clear();
+                messageBuffer.broadcast();
+                messageBuffer.readMessages();
+                messageBuffer.clear();
+
+                std::vector<int> expected = {100*next(-1) + 1, 100*next(-1) + 2, 100*next(-2) + 2};
+                std::sort(expected.begin(), expected.end());
+                std::sort(mh.received_.begin(), mh.received_.end());
+                ok &= (mh.received_ == expected);
+                expected.clear();
+                for( int r = 0; r < size; ++r )
+                    if( r != rank ) expected.push_back(100*r + 3);
+                std::sort(mhToAll.received_.begin(), mhToAll.received_.end());
+                ok &= (mhToAll.received_ == expected);
+            }
+            oks[rank] = ok;
+        });
+        bool ok = std::all_of(oks.begin(), oks.end(), [](int ok) { return ok; });
+        std::cout<<"in-process, "<<nranks<<" ranks: done, ok="<<ok<<std::endl;
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test15
+
+namespace test16
+{//---------------------------------------------------------------------------------------------------------------------
+ // Packing and unpacking skewed messages in parallel: the messages are posted by tasks of a ThreadPool, and large
+ // messages are packed and unpacked in chunks, executed by the same ThreadPool.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        std::mutex mutex_;
+    public:
+        std::map<int,std::vector<double>> received_; // by value of the first item of the message 
+        bool ok_ = true;
+
+        virtual ReadConcurrency readConcurrency() const { return REENTRANT; }
+
+     // Thread-safe: uses a message that is private to the calling thread.
+        void postMessage(int id, size_t n, int to_rank)
+        {
+            std::vector<double> a(n, 1000*rank + id);
+            ::mpi12s::Message message;
+            message.push_back(id);
+            message.push_back(a);
+            MessageHandlerBase::postMessage(message, to_rank);
+        }
+
+        virtual
+        bool
+        readMessage
+          ( Index_t msg_id // the message id identifies the message header
+          )
+        {
+            int id;
+            std::vector<double> a;
+            ::mpi12s::Message message;
+            message.push_back(id);
+            message.push_back(a);
+            bool ok = MessageHandlerBase::readMessage(message, msg_id);
+            std::lock_guard<std::mutex> lock(mutex_);
+            received_[id] = std::move(a);
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(10, 2);
+        ::mpi12s::ThreadPool pool(3);
+        ::mpi12s::theMessageBuffer.setThreadPool(&pool, 4096);
+        MessageHandler mhCounts, mhMigration;
+
+        bool ok = true;
+        for( int step = 0; step < 2; ++step )
+        {
+         // one message is 1000x larger than the others
+            pool.submit( [&]() { mhMigration.postMessage(0, 100000, next_rank()); } );
+            for( int id = 0; id < 20; ++id )
+                pool.submit( [&mhCounts,id]() { mhCounts.postMessage(id, 100, next_rank(id%2 ? 1 : -1)); } );
+            pool.wait();
+
+            mhCounts.received_.clear();
+            mhMigration.received_.clear();
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+
+            ok &= (mhMigration.received_.size() == 1)
+               && (mhMigration.received_[0] == std::vector<double>(100000, 1000*next_rank(-1)));
+            ok &= (mhCounts.received_.size() == 20);
+            for( int id = 0; id < 20; ++id ) {
+                int from = next_rank(id%2 ? -1 : 1);
+                ok &= (mhCounts.received_[id] == std::vector<double>(100, 1000*from + id));
+            }
+        }
+        ::mpi12s::theMessageBuffer.setThreadPool(nullptr);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<", steals="<<pool.nSteals()<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test16
+
+namespace test17
+{//---------------------------------------------------------------------------------------------------------------------
+ // Coroutines: two exchanges in flight, overlapped with an interior computation.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<int> a_;
+        MessageHandler(::mpi12s::MessageBuffer& messageBuffer)
+          : ::mpi2s::MessageHandlerBase(messageBuffer)
+        {
+            message().push_back(a_);
+        }
+    };
+
+    std::vector<std::string> events;
+
+    ::mpi12s::Task
+    step(::mpi12s::Channel& channel, MessageHandler& mh, int n, int to_rank, int from_rank, bool& ok, std::string name)
+    {
+        for( int timestep = 0; timestep < 2; ++timestep )
+        {
+            mh.a_.assign(n, 100*rank + timestep);
+            mh.postMessage(to_rank);
+            events.push_back(name + " started");
+            co_await channel.exchange();
+            events.push_back(name + " finished");
+            ok &= (mh.a_ == std::vector<int>(n, 100*from_rank + timestep));
+        }
+    }
+
+    ::mpi12s::Task
+    interior(::mpi12s::Scheduler& scheduler, double& sum)
+    {
+        for( int block = 0; block < 4; ++block ) {
+            for( int i = 0; i < 1000; ++i )
+                sum += i;
+            events.push_back("interior");
+            co_await scheduler.yield();
+        }
+    }
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(10, 2);
+        ::mpi12s::MessageBuffer messageBuffer2;
+        messageBuffer2.initialize(10, 2);
+        MessageHandler mh1(::mpi12s::theMessageBuffer), mh2(messageBuffer2);
+
+        bool ok = true;
+        bool ok1 = true, ok2 = true;
+        double sum = 0;
+        {
+            ::mpi12s::Scheduler scheduler;
+            ::mpi12s::Channel channel1(scheduler), channel2(scheduler, messageBuffer2);
+            scheduler.spawn( step(channel1, mh1, 10, next_rank(), next_rank(-1), ok1, "step1") );
+            scheduler.spawn( step(channel2, mh2, 10000, next_rank(-1), next_rank(), ok2, "step2") );
+            scheduler.spawn( interior(scheduler, sum) );
+            scheduler.run();
+            ok &= (scheduler.nTasks() == 0);
+        }
+        ok &= ok1 && ok2 && (sum == 4*499500.0);
+     // both exchanges were started before the interior computation started
+        ok &= (events[0] == "step1 started") && (events[1] == "step2 started") && (events[2] == "interior");
+        ok &= (std::count(events.begin(), events.end(), "step1 finished") == 2);
+        ok &= (std::count(events.begin(), events.end(), "step2 finished") == 2);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test17
+
+namespace test18
+{//---------------------------------------------------------------------------------------------------------------------
+ // StaticMessage: compile time typed messages, compatible with Message.
+    typedef Eigen::Matrix<double,3,1,Eigen::DontAlign> Vec3;
+
+    class StaticMessageHandler : public ::mpi2s::MessageHandlerBase
+    {// posts and reads StaticMessages
+    public:
+        int i_ = 0;
+        Vec3 v_;
+        std::vector<double> a_;
+        std::string s_;
+        bool readMessage(Index_t msg_id) override
+        {
+            ::mpi12s::StaticMessage message(i_, v_, a_, s_);
+            return ::mpi2s::MessageHandlerBase::readMessage(message, msg_id);
+        }
+        void post(int to_rank)
+        {
+            postMessage( ::mpi12s::StaticMessage(i_, v_, a_, s_), to_rank );
+        }
+    };
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {// posts and reads the same items as Message
+    public:
+        int i_ = 0;
+        Vec3 v_;
+        std::vector<double> a_;
+        std::string s_;
+        MessageHandler()
+        {
+            message().push_back(i_);
+            message().push_back(v_);
+            message().push_back(a_);
+            message().push_back(s_);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(10, 2);
+
+     // fixed size StaticMessages have a compile time size
+        int i; double x; Vec3 v;
+        static_assert( decltype(::mpi12s::StaticMessage(i, x, v))::fixedMessageSize() == sizeof(int) + sizeof(double) + sizeof(Vec3) );
+        bool ok = ( ::mpi12s::StaticMessage(i, x, v).messageSize() == sizeof(int) + sizeof(double) + sizeof(Vec3) );
+
+        StaticMessageHandler smh;
+        MessageHandler mh;
+        ok &= ( ::mpi12s::StaticMessage(smh.i_, smh.v_, smh.a_, smh.s_).messageSize() == mh.message().messageSize() );
+
+        smh.i_ = rank;
+        smh.v_ = Vec3(rank, rank + 1, rank + 2);
+        smh.a_.assign(5 + rank, 0.5*rank);
+        smh.s_ = "static " + std::to_string(rank);
+        smh.post(next_rank());
+
+        mh.i_ = 10*rank;
+        mh.v_ = Vec3(-rank, -rank, -rank);
+        mh.a_.assign(3 + rank, -0.5*rank);
+        mh.s_ = "dynamic " + std::to_string(rank);
+        mh.postMessage(next_rank(-1));
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        int l = next_rank(-1), r = next_rank();
+        ok &= (smh.i_ == l) && (smh.v_ == Vec3(l, l + 1, l + 2));
+        ok &= (smh.a_ == std::vector<double>(5 + l, 0.5*l)) && (smh.s_ == "static " + std::to_string(l));
+        ok &= (mh.i_ == 10*r) && (mh.v_ == Vec3(-r, -r, -r));
+        ok &= (mh.a_ == std::vector<double>(3 + r, -0.5*r)) && (mh.s_ == "dynamic " + std::to_string(r));
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test18
+
+namespace test19
+{//---------------------------------------------------------------------------------------------------------------------
+ // IndexedMessageItem: move particles to the next rank, gathering directly from and scattering directly
+ // into the arrays of a structure of arrays.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    struct ParticleContainer
+    {
+        std::vector<float> r;
+        std::vector<vec_t> x;
+        std::vector<bool> alive;
+
+        ParticleContainer(int size) : r(size), x(size), alive(size, true)
+        {
+            for( int i = 0; i < size; ++i ) {
+                r[i] = 100*rank + i;
+                x[i] = vec_t(r[i], r[i] + 1, r[i] + 2);
+            }
+        }
+
+        Index_t add()
+        {
+            r.push_back(0);
+            x.push_back(vec_t::Zero());
+            alive.push_back(true);
+            return r.size() - 1;
+        }
+    };
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        ParticleContainer& pc_;
+        std::vector<Index_t> indices_;
+    public:
+        MessageHandler(ParticleContainer& pc)
+          : pc_(pc)
+        {
+            auto allocate = [this](size_t n, std::vector<Index_t>& indices) {
+                for( size_t i = 0; i < n; ++i )
+                    indices.push_back( pc_.add() );
+            };
+            message().push_back(pc_.r, indices_, allocate);
+            message().push_back(pc_.x, indices_, allocate);
+        }
+
+        using MessageHandlerBase::postMessage;
+        void postMessage(std::vector<Index_t> const& indices, int to_rank)
+        {
+            indices_ = indices;
+            MessageHandlerBase::postMessage(to_rank);
+            for( Index_t i : indices )
+                pc_.alive[i] = false;
+        }
+
+        bool readMessage(Index_t msg_id) override
+        {// new target slots for every message
+            indices_.clear();
+            return MessageHandlerBase::readMessage(msg_id);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+
+        ParticleContainer pc(8);
+        MessageHandler mh(pc);
+        mh.postMessage({1,3,5,7}, next_rank());
+     // the same message as a plain vector, read by the same handler
+        std::vector<float> r = {-1, -2};
+        std::vector<vec_t> x = {vec_t(-1,-1,-1), vec_t(-2,-2,-2)};
+        ::mpi12s::Message message;
+        message.push_back(r);
+        message.push_back(x);
+        mh.postMessage(message, next_rank());
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        int prev = next_rank(-1);
+        bool ok = (pc.r.size() == 14);
+        for( size_t i = 0; i < 8; ++i ) {
+            ok &= (pc.alive[i] == (i%2 == 0));
+            ok &= (pc.r[i] == 100*rank + i) && (pc.x[i] == vec_t(pc.r[i], pc.r[i] + 1, pc.r[i] + 2));
+        }
+        for( size_t j = 0; j < 4; ++j ) {
+            float expected = 100*prev + 2*j + 1;
+            ok &= (pc.r[8 + j] == expected) && (pc.x[8 + j] == vec_t(expected, expected + 1, expected + 2));
+        }
+        ok &= (pc.r[12] == -1) && (pc.x[12] == vec_t(-1,-1,-1));
+        ok &= (pc.r[13] == -2) && (pc.x[13] == vec_t(-2,-2,-2));
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test19
+
+namespace test20
+{//---------------------------------------------------------------------------------------------------------------------
+ // PropertySet: move particles to the next rank in the AOS, SOA and AOSOA wire layouts.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    struct ParticleContainer
+    {
+        std::vector<float>   r;
+        std::vector<vec_t>   x;
+        std::vector<Index_t> id;
+
+        ParticleContainer(int size)
+        {
+            for( int i = 0; i < size; ++i )
+                add(100*rank + i);
+        }
+
+        Index_t add(Index_t i = -1)
+        {
+            r.push_back(i);
+            x.push_back(vec_t(i, i + 1, i + 2));
+            id.push_back(i);
+            return r.size() - 1;
+        }
+    };
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        ParticleContainer& pc_;
+        std::vector<Index_t> indices_;
+    public:
+        ::mpi12s::PropertySet properties;
+
+        MessageHandler(ParticleContainer& pc)
+          : pc_(pc)
+        {
+            properties.push_back(pc_.r);
+            properties.push_back(pc_.x);
+            properties.push_back(pc_.id);
+            message().push_back
+              ( properties, indices_
+              , [this](size_t n, std::vector<Index_t>& indices) {
+                    for( size_t i = 0; i < n; ++i )
+                        indices.push_back( pc_.add() );
+                }
+              );
+        }
+
+        void postMessage(std::vector<Index_t> const& indices, int to_rank)
+        {
+            indices_ = indices;
+            MessageHandlerBase::postMessage(to_rank);
+        }
+
+        bool readMessage(Index_t msg_id) override
+        {
+            indices_.clear();
+            return MessageHandlerBase::readMessage(msg_id);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+
+        ParticleContainer pc(20);
+        MessageHandler mh(pc);
+        bool ok = (mh.properties.elementSize() == sizeof(float) + sizeof(vec_t) + sizeof(Index_t));
+
+        std::vector<Index_t> indices = {19, 0, 7, 3, 12, 5, 8};
+        mh.properties.setWireLayout(::mpi12s::AOS);
+        mh.postMessage(indices, next_rank());
+        mh.properties.setWireLayout(::mpi12s::SOA);
+        mh.postMessage(indices, next_rank());
+        mh.properties.setWireLayout(::mpi12s::AOSOA, 3);
+        mh.postMessage(indices, next_rank());
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        int prev = next_rank(-1);
+        ok &= (pc.r.size() == 20 + 3*indices.size());
+        for( size_t m = 0; m < 3; ++m ) {
+            for( size_t i = 0; i < indices.size(); ++i ) {
+                size_t j = 20 + m*indices.size() + i;
+                Index_t expected = 100*prev + indices[i];
+                ok &= (pc.id[j] == expected) && (pc.r[j] == expected) && (pc.x[j] == vec_t(expected, expected + 1, expected + 2));
+            }
+        }
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test20
+
+namespace test21
+{//---------------------------------------------------------------------------------------------------------------------
+ // Zero-copy messages: particles are sent straight from, and received straight into the particle container,
+ // by MPI derived datatypes, in the same exchange as ordinary messages.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    struct ParticleContainer
+    {
+        std::vector<float>   r;
+        std::vector<vec_t>   x;
+        std::vector<Index_t> id;
+
+        ParticleContainer(int size, bool reserve = true)
+        {
+            if( reserve ) {
+                r.reserve(100); x.reserve(100); id.reserve(100);
+            }
+            for( int i = 0; i < size; ++i )
+                add(100*rank + i);
+        }
+
+        Index_t add(Index_t i = -1)
+        {
+            r.push_back(i);
+            x.push_back(vec_t(i, i + 1, i + 2));
+            id.push_back(i);
+            return r.size() - 1;
+        }
+    };
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        ParticleContainer& pc_;
+        ::mpi12s::PropertySet properties_;
+    public:
+        std::vector<Index_t> indices;
+
+        MessageHandler(ParticleContainer& pc)
+          : pc_(pc)
+        {
+            auto allocate = [this](size_t n, std::vector<Index_t>& indices) {
+                for( size_t i = 0; i < n; ++i )
+                    indices.push_back( pc_.add() );
+            };
+            properties_.push_back(pc_.x);
+            properties_.push_back(pc_.id);
+            message().push_back(pc_.r, indices, allocate);
+            message().push_back(properties_, indices, allocate);
+        }
+    };
+
+    class OtherMessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<int> a;
+        OtherMessageHandler()
+        {
+            message().push_back(a);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+
+        ParticleContainer pc(10);
+        MessageHandler mh(pc);
+        OtherMessageHandler omh;
+
+        mh.indices = {9, 2, 4};
+        mh.postZeroCopyMessage(next_rank());
+        omh.a.assign(5, rank);
+        omh.postMessage(next_rank());
+     // only the ordinary message is in the payload arena
+        bool ok = ( ::mpi12s::theMessageBuffer.payloadSizeUsed() == convertSizeInBytes<sizeof(Index_t),sizeof(Index_t)>(omh.message().messageSize()) );
+        ok &= ::mpi12s::theMessageBuffer.isZeroCopy(0) && !::mpi12s::theMessageBuffer.isZeroCopy(1);
+        ok &= ( ::mpi12s::theMessageBuffer.messageLength(0) == Index_t(3*(sizeof(float) + sizeof(vec_t) + sizeof(Index_t))) );
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        int prev = next_rank(-1);
+        ok &= (pc.r.size() == 13) && (mh.indices == std::vector<Index_t>({10, 11, 12}));
+        std::vector<Index_t> sent = {9, 2, 4};
+        for( size_t i = 0; i < 3; ++i ) {
+            Index_t expected = 100*prev + sent[i];
+            ok &= (pc.id[10 + i] == expected) && (pc.r[10 + i] == expected) && (pc.x[10 + i] == vec_t(expected, expected + 1, expected + 2));
+        }
+        ok &= (omh.a == std::vector<int>(5, prev));
+        ::mpi12s::theMessageBuffer.clear();
+
+     // zero-copy messages from several sources, into (and from) arrays that grow when the target slots
+     // are provided: 16 particles fill the capacity of the arrays exactly.
+        {
+            ParticleContainer pc2(16, false);
+            MessageHandler mh2(pc2);
+            mh2.indices = {15, 2, 4};
+            mh2.postZeroCopyMessage(next_rank());
+            mh2.postZeroCopyMessage(next_rank(-1));
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+         // the slots of the messages follow each other, in the order of the sources
+            std::vector<int> sources = { std::min(next_rank(), prev), std::max(next_rank(), prev) };
+            ok &= ( pc2.r.size() == 22 ) && ( mh2.indices == std::vector<Index_t>({16, 17, 18, 19, 20, 21}) );
+            std::vector<Index_t> sent2 = {15, 2, 4};
+            for( size_t m = 0; m < 2; ++m )
+                for( size_t i = 0; i < 3; ++i ) {
+                    Index_t expected = 100*sources[m] + sent2[i];
+                    size_t slot = 16 + 3*m + i;
+                    ok &= (pc2.id[slot] == expected) && (pc2.r[slot] == expected) && (pc2.x[slot] == vec_t(expected, expected + 1, expected + 2));
+                }
+        }
+
+     // zero-copy messages require the FLAT exchange mode
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::HIERARCHICAL);
+        bool thrown = false;
+        try {
+            mh.postZeroCopyMessage(next_rank());
+        } catch( std::runtime_error& ) {
+            thrown = true;
+        }
+        ok &= thrown;
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::FLAT);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test21
+
+namespace test22
+{//---------------------------------------------------------------------------------------------------------------------
+ // SIMD gather and scatter kernels: compare all instruction sets supported by the cpu to a plain loop.
+    template<typename T>
+    bool check(size_t arraySize, std::vector<Index_t> const& indices)
+    {
+        bool ok = true;
+        std::vector<T> array(arraySize), dst(indices.size()), scattered(arraySize);
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(array.data());
+        for( size_t b = 0; b < arraySize*sizeof(T); ++b )
+            bytes[b] = (unsigned char)(b*7 + 3);
+        for( int isa = ::mpi12s::simd::SCALAR; isa <= ::mpi12s::simd::AVX512; ++isa )
+        {
+            ::mpi12s::simd::setIsa(::mpi12s::simd::Isa(isa));
+            ::mpi12s::simd::gather( dst.data(), array.data(), array.size(), sizeof(T), indices.data(), indices.size() );
+            for( size_t i = 0; i < indices.size(); ++i )
+                ok &= ( memcmp(&dst[i], &array[indices[i]], sizeof(T)) == 0 );
+            std::fill_n( reinterpret_cast<unsigned char*>(scattered.data()), scattered.size()*sizeof(T), 0 );
+            ::mpi12s::simd::scatter( scattered.data(), scattered.size(), dst.data(), sizeof(T), indices.data(), indices.size() );
+            for( Index_t index : indices )
+                ok &= ( memcmp(&scattered[index], &array[index], sizeof(T)) == 0 );
+        }
+        return ok;
+    }
+
+    bool test()
+    {
+        init();
+        ::mpi12s::simd::Isa supported = ::mpi12s::simd::isa();
+        std::cout<<::mpi12s::info<<" instruction set: "<<::mpi12s::simd::isaName(supported)<<std::endl;
+
+        size_t const arraySize = 1001;
+     // distinct indices in random order, including the last element of the array
+        std::vector<Index_t> indices;
+        for( Index_t i = arraySize - 1; i >= 0; i -= 3 )
+            indices.push_back(i);
+        std::mt19937 rng(rank);
+        std::shuffle( indices.begin(), indices.end(), rng );
+        indices.resize(indices.size() - 2); // not a multiple of 4 or 8
+
+        bool ok = true;
+        ok &= check<float>(arraySize, indices);
+        ok &= check<double>(arraySize, indices);
+        ok &= check<Eigen::Matrix<float ,3,1,Eigen::DontAlign>>(arraySize, indices);
+        ok &= check<Eigen::Matrix<double,3,1,Eigen::DontAlign>>(arraySize, indices);
+        ok &= check<char>(arraySize, indices);
+        ok &= check<int>(arraySize, std::vector<Index_t>());
+        ::mpi12s::simd::setIsa(supported);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test22
+
+namespace test23
+{//---------------------------------------------------------------------------------------------------------------------
+ // MessageView: read the elements of a vector directly in the message buffer, rather than copying them
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        int tag;
+        ::mpi12s::MessageView<double> r; // not aligned in the message buffer, because of tag
+        ::mpi12s::MessageView<float>  f;
+     // copies of the received elements
+        std::vector<double> rReceived;
+        std::vector<float, ::mpi12s::DefaultInitAllocator<float>> fReceived;
+        std::vector<int> tags;
+
+        MessageHandler()
+        {
+            message().push_back(tag);
+            message().push_back(r);
+            message().push_back(f);
+        }
+
+        bool readMessage(Index_t msg_id) override
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            tags.push_back(tag);
+            r.appendTo(rReceived);
+            f.appendTo(fReceived);
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+
+        int tag = rank;
+        std::vector<double> r = {100.*rank, 100.*rank + 1, 100.*rank + 2};
+        std::vector<float>  f = {-1.f*rank, -2.f*rank};
+        ::mpi12s::Message message;
+        message.push_back(tag);
+        message.push_back(r);
+        message.push_back(f);
+        mh.postMessage(message, next_rank());
+     // a StaticMessage with a view of ... nothing
+        int tag2 = -1;
+        ::mpi12s::MessageView<double> empty;
+        std::vector<float> f2 = {0.5f};
+        ::mpi12s::StaticMessage message2(tag2, empty, f2);
+        mh.postMessage(message2, next_rank());
+
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+
+        int prev = next_rank(-1);
+        bool ok = (mh.tags == std::vector<int>{prev, -1});
+        ok &= (mh.rReceived == std::vector<double>{100.*prev, 100.*prev + 1, 100.*prev + 2});
+        ok &= (mh.fReceived.size() == 3) && (mh.fReceived[0] == -1.f*prev) && (mh.fReceived[1] == -2.f*prev) && (mh.fReceived[2] == 0.5f);
+     // the views of the last message, in the message buffer
+        ok &= mh.r.empty() && (mh.f.size() == 1) && (mh.f[0] == 0.5f);
+        ok &= mh.f.isAligned() && (mh.f.span()[0] == 0.5f);
+     // forward the view of the last message
+        ::mpi12s::MessageView<float> fView = mh.f;
+        ::mpi12s::Message message3;
+        message3.push_back(fView);
+        ok &= (message3.messageSize() == sizeof(size_t) + sizeof(float));
+        std::vector<char> buffer(message3.messageSize());
+        void* ptr = buffer.data();
+        message3.write(ptr);
+        std::vector<float> f3;
+        ::mpi12s::Message message4;
+        message4.push_back(f3);
+        ptr = buffer.data();
+        message4.read(ptr);
+        ok &= (f3 == std::vector<float>{0.5f});
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test23
+
+namespace test24
+{//---------------------------------------------------------------------------------------------------------------------
+ // Lossless compression: the codec itself, and compressed messages in every exchange mode.
+    bool roundTrip(std::vector<char> const& data, size_t typeSize, bool mustCompress)
+    {
+        std::vector<char> compressed( ::mpi12s::compression::compressBound(data.size()) );
+        size_t sz = ::mpi12s::compression::compress( compressed.data(), data.data(), data.size(), typeSize );
+        if( sz == 0 )
+            return !mustCompress;
+        bool ok = ( sz < data.size() ) && ( ::mpi12s::compression::decompressedSize(compressed.data()) == data.size() );
+        std::vector<char> decompressed(data.size());
+        ::mpi12s::compression::decompress( decompressed.data(), compressed.data(), sz );
+        ok &= ( decompressed == data );
+     // truncated data is detected
+        try {
+            ::mpi12s::compression::decompress( decompressed.data(), compressed.data(), sz - 1 );
+            ok = false;
+        } catch( std::runtime_error& ) {}
+        return ok;
+    }
+
+ // positions of particles on a lattice, as floats
+    std::vector<float> lattice(size_t n, float offset)
+    {
+        std::vector<float> x(3*n);
+        for( size_t i = 0; i < n; ++i ) {
+            x[3*i    ] = offset + 0.1f*(i%16);
+            x[3*i + 1] = offset + 0.1f*((i/16)%16);
+            x[3*i + 2] = offset + 0.1f*(i/256);
+        }
+        return x;
+    }
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<float> x;
+        std::vector<std::vector<float>> received;
+        MessageHandler()
+        {
+            message().push_back(x);
+            setCompression(1024);
+        }
+        bool readMessage(Index_t msg_id) override
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            received.push_back(x);
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+     // the codec
+        std::mt19937 rng(rank);
+        for( size_t n : {0, 1, 15, 16, 17, 40, 1000} ) {
+            std::vector<char> zeros(n, 0);
+            for( size_t typeSize : {1, 3, 4, 8} )
+                ok &= roundTrip(zeros, typeSize, n > 40);
+        }
+        std::vector<char> random(100000);
+        for( char& c : random )
+            c = char(rng());
+        ok &= roundTrip(random, 4, false);
+        std::vector<float> x = lattice(10000, rank);
+        std::vector<char> bytes( (char*)x.data(), (char*)(x.data() + x.size()) );
+        ok &= roundTrip(bytes, 4, true);
+        ok &= roundTrip(bytes, 1, true);
+
+     // compressed messages
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+        int prev = next_rank(-1);
+        for( int mode : {::mpi12s::MessageBuffer::FLAT, ::mpi12s::MessageBuffer::ONESIDED, ::mpi12s::MessageBuffer::HIERARCHICAL} )
+        {
+            ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::ExchangeMode(mode));
+            mh.received.clear();
+            mh.x = lattice(10000, rank);             // compresses
+            mh.postMessage(next_rank());
+            mh.x = {1.f*rank, 2.f*rank};             // below the threshold
+            mh.postMessage(next_rank());
+            mh.x.resize(1000);                       // does not compress: random bits (but no nans)
+            for( float& f : mh.x ) {
+                uint32_t bits = rng() & 0xbfffffffu;
+                memcpy( &f, &bits, sizeof(f) );
+            }
+            std::vector<float> noise = mh.x;
+            mh.postMessage(next_rank());
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+
+            std::vector<float> noisePrev(noise.size());
+            MPI_Sendrecv( noise.data(), noise.size(), MPI_FLOAT, next_rank(), 0
+                        , noisePrev.data(), noisePrev.size(), MPI_FLOAT, prev, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+            ok &= ( mh.received.size() == 3 );
+            ok &= ( mh.received[0] == lattice(10000, prev) );
+            ok &= ( mh.received[1] == std::vector<float>{1.f*prev, 2.f*prev} );
+            ok &= ( mh.received[2] == noisePrev );
+        }
+        ::mpi12s::CompressionStatistics const& statistics = ::mpi12s::theMessageBuffer.compressionStatistics();
+        prdbg("test24", ::mpi12s::theMessageBuffer.statisticsToStr());
+        ok &= ( statistics.nCompressed == 3 ) && ( statistics.nIncompressible == 3 ) && ( statistics.nDecompressed == 3 );
+        ok &= ( statistics.ratio() > 2 ) && ( statistics.bytesDecompressed == statistics.bytesIn );
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::FLAT);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test24
+
+namespace test25
+{//---------------------------------------------------------------------------------------------------------------------
+ // Lossy encodings: fixed point positions in a bounding box, and float16 velocities.
+    typedef Eigen::Matrix<float , 3, 1, Eigen::DontAlign> vec3f;
+    typedef Eigen::Matrix<double, 3, 1, Eigen::DontAlign> vec3d;
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<vec3f> x;
+        std::vector<vec3d> v;
+        std::vector<Index_t> indices;
+        MessageHandler()
+        {
+            vec3f lower(-1.f, -2.f, -3.f), upper(1.f, 2.f, 3.f);
+            message().push_back( x, indices, ::mpi12s::Encoding::fixedPoint(16, lower, upper)
+                               , [this](size_t n, std::vector<Index_t>& slots) {
+                                     slots.resize(n);
+                                     for( size_t i = 0; i < n; ++i )
+                                         slots[i] = x.size() + i;
+                                     x.resize(x.size() + n);
+                                 } );
+            message().push_back( v, ::mpi12s::Encoding::float16() );
+        }
+    };
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+        std::mt19937 rng(rank);
+        std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+     // the error bounds
+        for( size_t bits : {1, 7, 8, 12, 16, 24, 32} )
+        {
+            ::mpi12s::Encoding encoding = ::mpi12s::Encoding::fixedPoint(bits, -10.0, 10.0);
+            std::vector<double> a(1001), b(1001);
+            for( size_t i = 0; i < a.size(); ++i )
+                a[i] = -10.0 + 0.02*i;
+            std::vector<char> buffer(a.size()*encoding.bytesPerComponent());
+            ::mpi12s::encoding::encode<double>(buffer.data(), a.data(), a.size(), 1, encoding);
+            ::mpi12s::encoding::decode<double>(b.data(), buffer.data(), b.size(), 1, encoding);
+            for( size_t i = 0; i < a.size(); ++i )
+                ok &= ( std::abs(a[i] - b[i]) <= encoding.errorBound(0)*(1 + 1e-9) );
+        }
+     // values outside the bounds are clamped
+        {
+            ::mpi12s::Encoding encoding = ::mpi12s::Encoding::fixedPoint(8, 0.0, 1.0);
+            float a[3] = {-5.f, 5.f, std::nanf("")}, b[3];
+            char buffer[3];
+            ::mpi12s::encoding::encode<float>(buffer, a, 3, 1, encoding);
+            ::mpi12s::encoding::decode<float>(b, buffer, 3, 1, encoding);
+            ok &= ( b[0] == 0.f ) && ( b[1] == 1.f ) && ( b[2] == 0.f );
+        }
+     // float16: the scalar and F16C conversions agree, and are within the error bound
+        {
+            std::vector<float> a(1003), b(a.size()), c(a.size());
+            for( float& f : a )
+                f = 1000.f*uniform(rng);
+            a[0] = 0.f; a[1] = 65504.f; a[2] = 1e-7f;
+            std::vector<uint16_t> h1(a.size()), h2(a.size());
+            ::mpi12s::simd::Isa isa = ::mpi12s::simd::currentIsa();
+            ::mpi12s::simd::setIsa(::mpi12s::simd::SCALAR);
+            ::mpi12s::simd::floatToHalf(h1.data(), a.data(), a.size());
+            ::mpi12s::simd::halfToFloat(b.data(), h1.data(), h1.size());
+            ::mpi12s::simd::setIsa(isa);
+            ::mpi12s::simd::floatToHalf(h2.data(), a.data(), a.size());
+            ::mpi12s::simd::halfToFloat(c.data(), h2.data(), h2.size());
+            ok &= ( h1 == h2 ) && ( b == c ) && ( b[1] == 65504.f );
+            for( size_t i = 3; i < a.size(); ++i )
+                ok &= ( std::abs(a[i] - b[i]) <= ::mpi12s::Encoding::float16().errorBound(0)*std::abs(a[i]) );
+        }
+     // invalid encodings
+        try {
+            ::mpi12s::Encoding::fixedPoint(16, 1.0, 1.0);
+            ok = false;
+        } catch( std::runtime_error& ) {}
+
+     // encoded message items, received by an allocator
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+        size_t const n = 1000;
+        std::vector<vec3f> x(n);
+        std::vector<vec3d> v(n);
+        for( size_t i = 0; i < n; ++i ) {
+            x[i] = vec3f(uniform(rng), 2*uniform(rng), 3*uniform(rng));
+            v[i] = vec3d(uniform(rng), uniform(rng), uniform(rng));
+        }
+        mh.x = x;
+        mh.v = v;
+        for( size_t i = 0; i < n; i += 2 )
+            mh.indices.push_back(i);                 // only the even elements
+        ok &= ( mh.message().messageSize() == 2*(3*sizeof(size_t) + 8*sizeof(double)) + (n/2)*3*2 + n*3*2 );
+        mh.postMessage(next_rank());
+        mh.x.clear();
+        mh.indices.clear();
+        ::mpi12s::theMessageBuffer.broadcast();
+        ::mpi12s::theMessageBuffer.readMessages();
+        ::mpi12s::theMessageBuffer.clear();
+     // what we received is what prev sent, which we cannot see, so send it ourselves
+        std::vector<vec3f> xPrev(n);
+        std::vector<vec3d> vPrev(n);
+        int prev = next_rank(-1);
+        MPI_Sendrecv( x.data(), 3*n, MPI_FLOAT, next_rank(), 0, xPrev.data(), 3*n, MPI_FLOAT, prev, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+        MPI_Sendrecv( v.data(), 3*n, MPI_DOUBLE, next_rank(), 0, vPrev.data(), 3*n, MPI_DOUBLE, prev, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE );
+        ::mpi12s::Encoding fixed = ::mpi12s::Encoding::fixedPoint(16, vec3f(-1.f, -2.f, -3.f), vec3f(1.f, 2.f, 3.f));
+        ok &= ( mh.x.size() == n/2 ) && ( mh.indices.size() == n/2 ) && ( mh.v.size() == n );
+        for( size_t i = 0; ok && i < n/2; ++i )
+            for( int c = 0; c < 3; ++c )
+                ok &= ( std::abs(mh.x[i][c] - xPrev[2*i][c]) <= fixed.errorBound(c)*(1 + 1e-9) + std::ldexp(std::abs(mh.x[i][c]), -24) );
+        for( size_t i = 0; ok && i < n; ++i )
+            for( int c = 0; c < 3; ++c )
+                ok &= ( std::abs(mh.v[i][c] - vPrev[i][c]) <= std::ldexp(1.0, -11)*std::abs(vPrev[i][c]) + 1e-7 );
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test25
+
+namespace test26
+{//---------------------------------------------------------------------------------------------------------------------
+ // Delta encoding of repeated messages to the same destination, with keyframes.
+    float position(int r, size_t i, int step)
+    {// particles with a slightly irregular position, moving slowly
+        return r + 0.1f*i + 0.01f*std::sin(1.f*i) + 1e-5f*step*std::cos(0.3f*i);
+    }
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<float> x;
+        std::vector<std::vector<float>> received;
+        std::vector<std::pair<int,int>> streams; // (source, destination) of the received messages
+        MessageHandler()
+        {
+            message().push_back(x);
+            setCompression(1024);
+        }
+        bool readMessage(Index_t msg_id) override
+        {
+            bool ok = MessageHandlerBase::readMessage(msg_id);
+            received.push_back(x);
+            streams.emplace_back( ::mpi12s::theMessageBuffer.messageSource(msg_id)
+                                , ::mpi12s::theMessageBuffer.messageDestination(msg_id) );
+            return ok;
+        }
+    };
+
+ // Post nSteps steps, and return the number of compressed bytes sent.
+    size_t run(MessageHandler& mh, int nSteps, size_t n, bool& ok)
+    {
+        int prev = next_rank(-1);
+        size_t bytesOut = ::mpi12s::theMessageBuffer.compressionStatistics().bytesOut;
+        for( int step = 0; step < nSteps; ++step )
+        {
+            size_t m = ( step == 5 ? n/2 : n ); // a different size forces a keyframe
+            mh.x.resize(m);
+            for( size_t i = 0; i < m; ++i )
+                mh.x[i] = position(rank, i, step);
+            mh.received.clear();
+            mh.postMessage(next_rank());
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+            ok &= ( mh.received.size() == 1 ) && ( mh.received[0].size() == m );
+            for( size_t i = 0; ok && i < m; ++i )
+                ok &= ( mh.received[0][i] == position(prev, i, step) );
+        }
+        return ::mpi12s::theMessageBuffer.compressionStatistics().bytesOut - bytesOut;
+    }
+
+ // Post to the next rank and to all ranks in every step: every source has two delta streams to this
+ // rank, which must not be reconstructed against each other's previous message.
+    bool runInterleaved(MessageHandler& mh, int nSteps, size_t n)
+    {
+        bool ok = true;
+        for( int step = 0; step < nSteps; ++step )
+        {
+            mh.x.resize(n);
+            for( size_t i = 0; i < n; ++i )
+                mh.x[i] = position(rank, i, step);
+            mh.postMessage(next_rank());
+            for( size_t i = 0; i < n; ++i )
+                mh.x[i] = -position(rank, i, 2*step);
+            mh.postMessageToAll();
+            mh.received.clear();
+            mh.streams.clear();
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+         // one message from the previous rank, and one broadcast from every other rank
+            ok &= ( mh.received.size() == static_cast<size_t>(::mpi12s::size) );
+            for( size_t m = 0; ok && m < mh.received.size(); ++m ) {
+                auto [src, dst] = mh.streams[m];
+                bool toAll = ( dst == ::mpi12s::MessageBuffer::ALL_RANKS );
+                ok &= ( mh.received[m].size() == n ) && ( toAll || src == next_rank(-1) );
+                for( size_t i = 0; ok && i < n; ++i )
+                    ok &= ( mh.received[m][i] == ( toAll ? -position(src, i, 2*step) : position(src, i, step) ) );
+            }
+        }
+        return ok;
+    }
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+        size_t const n = 10000;
+        size_t plain = run(mh, 10, n, ok);
+
+        mh.setDeltaEncoding(::mpi2s::MessageHandlerBase::XOR_DELTA, 4);
+        size_t xorDelta = run(mh, 10, n, ok);
+     // keyframes at steps 0, 4, 5 (size changed) and 6 (size changed)
+        ok &= ( mh.nKeyframesPosted() == 4 ) && ( mh.nDeltasPosted() == 6 );
+        ok &= ( xorDelta < plain );
+
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::ONESIDED);
+        mh.setDeltaEncoding(::mpi2s::MessageHandlerBase::SUBTRACT_DELTA, 4);
+        size_t subtractDelta = run(mh, 10, n, ok);
+        ok &= ( mh.nKeyframesPosted() == 8 ) && ( mh.nDeltasPosted() == 12 );
+        ok &= ( subtractDelta < plain );
+        prdbg(::mpi12s::tostr("test26 compressed bytes: plain=", plain, ", xor=", xorDelta, ", subtract=", subtractDelta));
+
+     // after a reset, the next message is a keyframe, also without compression
+        mh.setCompression(0);
+        mh.resetDeltaEncoding();
+        run(mh, 2, n, ok);
+        ok &= ( mh.nKeyframesPosted() == 9 ) && ( mh.nDeltasPosted() == 13 );
+
+     // a delta stream to the next rank, and one to all ranks, interleaved
+        mh.setDeltaEncoding(::mpi2s::MessageHandlerBase::XOR_DELTA, 4);
+        ok &= runInterleaved(mh, 6, 1000);
+        ok &= ( mh.nKeyframesPosted() == 13 ) && ( mh.nDeltasPosted() == 21 );
+        mh.setDeltaEncoding(::mpi2s::MessageHandlerBase::NO_DELTA);
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::FLAT);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test26
+
+namespace test27
+{//---------------------------------------------------------------------------------------------------------------------
+ // PropertySet with change tracking: only the columns touched since the last message to a destination are sent.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    struct ParticleContainer
+    {
+        std::vector<float>   r;
+        std::vector<vec_t>   x;
+        std::vector<Index_t> id;
+
+        ParticleContainer(int size)
+        {
+            for( int i = 0; i < size; ++i )
+                add(100*rank + i);
+        }
+
+        Index_t add(Index_t i = -1)
+        {
+            r.push_back(i);
+            x.push_back(vec_t(i, i + 1, i + 2));
+            id.push_back(i);
+            return r.size() - 1;
+        }
+    };
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+        ParticleContainer& pc_;
+    public:
+        std::vector<Index_t> indices;
+        ::mpi12s::PropertySet properties;
+
+        MessageHandler(ParticleContainer& pc)
+          : pc_(pc)
+        {
+            properties.push_back(pc_.r);
+            properties.push_back(pc_.x);
+            properties.push_back(pc_.id);
+            properties.setChangeTracking(true);
+            message().push_back
+              ( properties, indices
+              , [this](size_t n, std::vector<Index_t>& slots) {
+                    for( size_t i = 0; i < n; ++i )
+                        slots.push_back( pc_.add() );
+                }
+              );
+        }
+
+        bool readMessage(Index_t msg_id) override
+        {
+            indices.clear(); // new ghost slots every time
+            return MessageHandlerBase::readMessage(msg_id);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        int const nOwned = 20;
+        ParticleContainer pc(nOwned);
+        MessageHandler mh(pc);
+        int prev = next_rank(-1);
+        float shift = 100.f*(prev - rank); // the particles of prev are ours, shifted
+        size_t const prefix = 5*sizeof(size_t);
+        bool ok = true;
+
+        std::vector<Index_t> indices = {19, 0, 7, 3, 12, 5, 8};
+        for( int step = 0; step < 6; ++step )
+        {
+            size_t expectedElementSize = 0; // the size of the columns that must be sent
+            if( step == 0 )
+                expectedElementSize = mh.properties.elementSize();
+            if( step == 1 || step == 5 ) {
+                for( int i = 0; i < nOwned; ++i )
+                    pc.x[i] += vec_t(1, 1, 1);
+                mh.properties.touch(pc.x);
+                expectedElementSize = sizeof(vec_t);
+            }
+            if( step == 3 ) { // other elements
+                indices = {1, 2, 3};
+                expectedElementSize = mh.properties.elementSize();
+            }
+            if( step == 4 ) {
+                for( int i = 0; i < nOwned; ++i )
+                    pc.r[i] += 0.5f;
+                mh.properties.touch(pc.r);
+                mh.properties.setWireLayout(::mpi12s::AOSOA, 2);
+                expectedElementSize = sizeof(float);
+            }
+            if( step == 5 )
+                ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::ONESIDED);
+
+            mh.indices = indices;
+            mh.message().setPeer(next_rank());
+            ok &= ( mh.message().messageSize() == prefix + indices.size()*expectedElementSize );
+            mh.postMessage(next_rank());
+            size_t nBefore = pc.r.size();
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+
+         // all columns of the new ghosts are complete
+            ok &= ( pc.r.size() == nBefore + indices.size() );
+            for( size_t k = 0; ok && k < indices.size(); ++k ) {
+                size_t j = nBefore + k;
+                Index_t i = indices[k];
+                ok &= ( pc.id[j] == pc.id[i] + Index_t(shift) ) && ( pc.r[j] == pc.r[i] + shift )
+                   && ( pc.x[j] == pc.x[i] + vec_t(shift, shift, shift) );
+            }
+        }
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::FLAT);
+
+     // without a destination all columns are sent
+        mh.message().setPeer(-1);
+        ok &= ( mh.message().messageSize() == prefix + indices.size()*mh.properties.elementSize() );
+        try {
+            mh.properties.touch(pc.r);
+            std::vector<float> other;
+            mh.properties.touch(other);
+            ok = false;
+        } catch( std::runtime_error& ) {}
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test27
+
+namespace test28
+{//---------------------------------------------------------------------------------------------------------------------
+ // Ragged and nested containers, std::array, Eigen quaternions and aligned matrices as message items.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<std::vector<int>> neighbours;
+        ::mpi12s::RaggedArray<vec_t> bonds;
+        std::array<double,3> a;
+        Eigen::Quaterniond q;
+        Eigen::Matrix4f M; // aligned
+        std::vector<Eigen::Matrix4f> Ms;
+        std::vector<std::string> names;
+
+        MessageHandler()
+        {
+            message().push_back(neighbours);
+            message().push_back(bonds);
+            message().push_back(a);
+            message().push_back(q);
+            message().push_back(M);
+            message().push_back(Ms);
+            message().push_back(names);
+        }
+
+        void set(int r)
+        {
+            neighbours = { {r, r + 1, r + 2}, {}, {r + 3}, {} };
+            bonds.clear();
+            bonds.push_back( std::vector<vec_t>{ vec_t(r, 0, 0) } );
+            bonds.push_back( std::vector<vec_t>{} );
+            bonds.push_back( std::vector<vec_t>{ vec_t(r, 1, 0), vec_t(r, 2, 0) } );
+            a = {1.*r, 2.*r, 3.*r};
+            q = Eigen::Quaterniond(r, 1, 2, 3);
+            M = Eigen::Matrix4f::Constant(r);
+            Ms = { Eigen::Matrix4f::Identity()*r, Eigen::Matrix4f::Constant(-r) };
+            names = { "rank", std::to_string(r), "" };
+        }
+
+        bool check(int r) const
+        {
+            MessageHandler expected;
+            expected.set(r);
+            bool ok = ( neighbours == expected.neighbours ) && ( bonds.offsets() == expected.bonds.offsets() )
+                   && ( bonds.data() == expected.bonds.data() ) && ( a == expected.a )
+                   && ( q.coeffs() == expected.q.coeffs() ) && ( M == expected.M ) && ( names == expected.names );
+            ok &= ( Ms.size() == 2 ) && ( Ms[0] == expected.Ms[0] ) && ( Ms[1] == expected.Ms[1] );
+            return ok;
+        }
+    };
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+        static_assert( ::mpi12s::internal::fixed_size_memcpy_able<Eigen::Quaternionf>::value );
+        static_assert( ::mpi12s::internal::fixed_size_memcpy_able<Eigen::Matrix4d>::value );
+        static_assert(!::mpi12s::internal::fixed_size_memcpy_able<Eigen::VectorXd>::value );
+        static_assert( ::mpi12s::internal::fixed_size_memcpy_able<std::array<vec_t,2>>::value );
+        static_assert( ::mpi12s::internal::ragged_memcpy_able<std::vector<std::vector<vec_t>>>::value );
+        static_assert(!::mpi12s::internal::ragged_memcpy_able<std::vector<std::vector<std::string>>>::value );
+
+     // std::vector<std::vector<T>> and RaggedArray<T> are interchangeable, and take one size_t per row
+        {
+            std::vector<std::vector<vec_t>> rows = { {vec_t(1, 2, 3)}, {}, {vec_t(4, 5, 6), vec_t(7, 8, 9)} };
+            ::mpi12s::Message message;
+            message.push_back(rows);
+            ok &= ( message.messageSize() == 5*sizeof(size_t) + 3*sizeof(vec_t) );
+            std::vector<char> buffer(message.messageSize() + 1);
+            void* ptr = buffer.data() + 1; // misaligned
+            message.write(ptr);
+            ::mpi12s::RaggedArray<vec_t> ragged;
+            ::mpi12s::Message message2;
+            message2.push_back(ragged);
+            ptr = buffer.data() + 1;
+            message2.read(ptr);
+            ok &= ( ragged.size() == 3 ) && ( ragged.rowSize(1) == 0 ) && ( ragged[2][1] == vec_t(7, 8, 9) );
+            ok &= ( ptr == buffer.data() + buffer.size() );
+         // and back, with a StaticMessage
+            std::vector<std::vector<vec_t>> rows2;
+            ::mpi12s::StaticMessage staticMessage(ragged);
+            ok &= ( staticMessage.messageSize() == message.messageSize() );
+            ptr = buffer.data();
+            staticMessage.write(ptr);
+            ::mpi12s::StaticMessage staticMessage2(rows2);
+            ptr = buffer.data();
+            staticMessage2.read(ptr);
+            ok &= ( rows2 == rows );
+        }
+
+     // exchanged by a MessageHandler, also with a ThreadPool
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+        ::mpi12s::ThreadPool pool(3);
+        for( int usePool = 0; usePool < 2; ++usePool )
+        {
+            ::mpi12s::theMessageBuffer.setThreadPool( usePool ? &pool : nullptr, 64 );
+            mh.set(rank);
+            mh.postMessage(next_rank());
+            mh.set(-1);
+            ::mpi12s::theMessageBuffer.broadcast();
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+            ok &= mh.check( next_rank(-1) );
+        }
+        ::mpi12s::theMessageBuffer.setThreadPool(nullptr);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test28
+
+namespace test29
+{//---------------------------------------------------------------------------------------------------------------------
+ // Aggregate structs as message items, decomposed into their fields by compile time reflection.
+    typedef Eigen::Matrix<float, 3, 1, Eigen::DontAlign> vec_t;
+
+    struct Particle // fixed size, but not trivially copyable
+    {
+        vec_t x;
+        float m;
+        int   species;
+        bool operator==(Particle const&) const = default;
+    };
+
+    struct Atom // variable size
+    {
+        int              id;
+        vec_t            x;
+        std::vector<int> bonds;
+        std::string      name;
+        double           charge;
+        bool operator==(Atom const&) const = default;
+    };
+
+    struct Molecule // nested
+    {
+        std::string       name;
+        std::vector<Atom> atoms; // decomposed into columns
+        Particle          centre;
+        bool operator==(Molecule const&) const = default;
+    };
+
+ // Aggregates whose fields cannot be counted exactly are not reflectable, hence not memcpy-able.
+    struct WithArray // brace elision over-counts the fields of a C-array
+    {
+        double x[3];
+        std::vector<int> v;
+    };
+    struct Wide // more than MAX_FIELDS fields
+    {
+        int i0, i1, i2, i3, i4, i5, i6, i7, i8, i9, i10, i11, i12;
+        std::vector<int> v;
+    };
+
+    Atom atom(int r, int i) {
+        return Atom{ 10*r + i, vec_t(r, i, 0), std::vector<int>(i, r), std::string(i, 'a' + i), 0.5*r };
+    }
+    Molecule molecule(int r) {
+        return Molecule{ "molecule" + std::to_string(r), {atom(r, 0), atom(r, 1), atom(r, 2)}, Particle{vec_t(r, r, r), 1.f*r, r} };
+    }
+
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        Atom atom;
+        Molecule molecule;
+        std::vector<Particle> particles;
+
+        MessageHandler()
+        {
+            message().push_back(atom);
+            message().push_back(molecule);
+            message().push_back(particles);
+        }
+    };
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+        static_assert( ::mpi12s::reflection::fieldCount<Atom>() == 5 );
+        static_assert( ::mpi12s::internal::fixed_size_memcpy_able<Particle>::value );
+        static_assert( ::mpi12s::internal::variable_size_memcpy_able<std::vector<Particle>>::value );
+        static_assert( ::mpi12s::internal::aggregate_memcpy_able<Atom>::value );
+        static_assert( ::mpi12s::internal::column_memcpy_able<std::vector<Atom>>::value );
+        static_assert( ::mpi12s::internal::aggregate_memcpy_able<Molecule>::value );
+        static_assert(!::mpi12s::internal::column_memcpy_able<std::vector<Molecule>>::value ); // a column of columns
+        static_assert(!::mpi12s::reflection::isReflectable<WithArray>() );
+        static_assert(!::mpi12s::reflection::isReflectable<Wide>() );
+        static_assert(!::mpi12s::internal::memcpy_able<WithArray>::value );
+        static_assert(!::mpi12s::internal::memcpy_able<Wide>::value );
+
+     // the fields, one after the other, without padding
+        Atom a = atom(1, 2);
+        ok &= ( ::mpi12s::messageSize(a) == sizeof(int) + sizeof(vec_t) + (sizeof(size_t) + 2*sizeof(int)) + (sizeof(size_t) + 2) + sizeof(double) );
+     // a vector of atoms is decomposed into columns
+        {
+            std::vector<Atom> atoms = {atom(1, 0), atom(1, 3)};
+            std::vector<char> buffer( ::mpi12s::messageSize(atoms) + 1 );
+            void* ptr = buffer.data() + 1; // misaligned
+            ::mpi12s::write(atoms, ptr);
+            ok &= ( ptr == buffer.data() + buffer.size() );
+            int ids[2];
+            memcpy( ids, buffer.data() + 1 + sizeof(size_t), sizeof(ids) );
+            ok &= ( ids[0] == 10 ) && ( ids[1] == 13 );
+            std::vector<Atom> atoms2;
+            ptr = buffer.data() + 1;
+            ::mpi12s::read(atoms2, ptr);
+            ok &= ( atoms2 == atoms );
+        }
+
+     // exchanged by a MessageHandler
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        MessageHandler mh;
+        mh.atom = atom(rank, 4);
+        mh.molecule = molecule(rank);
+        mh.particles = { Particle{vec_t(rank, 0, 0), 1.f, 2}, Particle{vec_t(0, rank, 0), 3.f, 4} };
+        mh.postMessage(next_rank());
+     // and as a StaticMessage
+        Molecule m = molecule(rank);
+        ::mpi12s::StaticMessage staticMessage(m);
+        mh.postMessage(staticMessage, next_rank());
+        mh.atom = atom(-1, 0);
+        mh.molecule = molecule(-1);
+        mh.particles.clear();
+        ::mpi12s::theMessageBuffer.broadcast();
+        for( Index_t msg_id = 0, n = 0; msg_id < ::mpi12s::theMessageBuffer.nMessages(); ++msg_id ) {
+            if( !::mpi12s::theMessageBuffer.isIncoming(msg_id) )
+                continue;
+            if( n++ == 0 )
+                mh.readMessage(msg_id);
+            else {
+                m = molecule(-1);
+                mh.readMessage(staticMessage, msg_id);
+            }
+        }
+        ::mpi12s::theMessageBuffer.clear();
+
+        int prev = next_rank(-1);
+        ok &= ( mh.atom == atom(prev, 4) ) && ( mh.molecule == molecule(prev) ) && ( m == molecule(prev) );
+        ok &= ( mh.particles.size() == 2 ) && ( mh.particles[1] == Particle{vec_t(0, prev, 0), 3.f, 4} );
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test29
+
+namespace test30
+{//---------------------------------------------------------------------------------------------------------------------
+ // Cache line aligned payloads, and streaming copies for large messages.
+    class MessageHandler : public ::mpi2s::MessageHandlerBase
+    {
+    public:
+        std::vector<double> x;
+
+        MessageHandler()
+        {
+            message().push_back(x);
+        }
+
+        void set(int r, size_t n)
+        {
+            x.resize(n);
+            for( size_t i = 0; i < n; ++i )
+                x[i] = r + 0.001*i;
+        }
+
+        bool check(int r, size_t n) const
+        {
+            MessageHandler expected;
+            expected.set(r, n);
+            return ( x == expected.x );
+        }
+    };
+
+ // Are the payloads of all messages (posted and received) aligned to nBytes?
+    bool isAligned(size_t nBytes)
+    {
+        ::mpi12s::MessageBuffer& mb = ::mpi12s::theMessageBuffer;
+        bool ok = true;
+        for( Index_t msg_id = 0; msg_id < mb.nMessages(); ++msg_id )
+            if( mb.messageSource(msg_id) == rank || mb.isIncoming(msg_id) )
+                ok &= ( reinterpret_cast<uintptr_t>( mb.messagePtr(msg_id) ) % nBytes == 0 );
+        return ok;
+    }
+
+    bool test()
+    {
+        init();
+        bool ok = true;
+
+     // streamCopy() and copy() agree with memcpy, for all sizes and misalignments of src and dst
+        {
+            std::vector<char> src(1024 + 64), dst(1024 + 128), ref(1024 + 128);
+            for( size_t i = 0; i < src.size(); ++i )
+                src[i] = char(i*7 + 3);
+            ::mpi12s::simd::Isa supported = ::mpi12s::simd::isa();
+            size_t const threshold = ::mpi12s::simd::streamingThreshold();
+            ::mpi12s::simd::setStreamingThreshold(256);
+            for( int isa = ::mpi12s::simd::SCALAR; isa <= supported; ++isa )
+            {
+                ::mpi12s::simd::setIsa(::mpi12s::simd::Isa(isa));
+                for( size_t n : {0, 1, 15, 16, 63, 64, 65, 127, 128, 255, 256, 257, 1000, 1024} )
+                    for( size_t so : {0, 1, 8, 33} )
+                        for( size_t d_o : {0, 3, 16, 40} ) {
+                            std::fill( dst.begin(), dst.end(), 0 );
+                            std::fill( ref.begin(), ref.end(), 0 );
+                            memcpy( ref.data() + d_o, src.data() + so, n );
+                            ::mpi12s::simd::streamCopy( dst.data() + d_o, src.data() + so, n );
+                            ok &= ( dst == ref );
+                            std::fill( dst.begin(), dst.end(), 0 );
+                            ::mpi12s::simd::copy( dst.data() + d_o, src.data() + so, n );
+                            ok &= ( dst == ref );
+                        }
+            }
+            ::mpi12s::simd::setIsa(supported);
+            ::mpi12s::simd::setStreamingThreshold(threshold);
+        }
+
+     // an invalid alignment is refused
+        {
+            bool thrown = false;
+            try { ::mpi12s::theMessageBuffer.setPayloadAlignment(48); }
+            catch( std::runtime_error const& ) { thrown = true; }
+            ok &= thrown;
+        }
+
+     // the payloads are aligned on both sides, in every exchange mode, with and without a ThreadPool,
+     // and the large messages are copied with streaming stores
+        ::mpi12s::theMessageBuffer.initialize(100, 10);
+        ok &= ( ::mpi12s::theMessageBuffer.payloadAlignment() == ::mpi12s::MessageBuffer::CACHE_LINE );
+        size_t const threshold = ::mpi12s::simd::streamingThreshold();
+        ::mpi12s::simd::setStreamingThreshold(1024);
+        MessageHandler mh0, mh1;
+        ::mpi12s::ThreadPool pool(3);
+        ::mpi12s::MessageBuffer::ExchangeMode const modes[] = { ::mpi12s::MessageBuffer::FLAT
+                                                              , ::mpi12s::MessageBuffer::ONESIDED
+                                                              , ::mpi12s::MessageBuffer::HIERARCHICAL };
+        for( size_t alignment : {size_t(::mpi12s::MessageBuffer::CACHE_LINE), size_t(256)} )
+        {
+            ::mpi12s::theMessageBuffer.setPayloadAlignment(alignment);
+            ok &= ( reinterpret_cast<uintptr_t>( ::mpi12s::theMessageBuffer.payloadPtr() ) % alignment == 0 );
+            for( auto mode : modes )
+                for( int usePool = 0; usePool < 2; ++usePool )
+                {
+                    ::mpi12s::theMessageBuffer.setExchangeMode(mode);
+                    ::mpi12s::theMessageBuffer.setThreadPool( usePool ? &pool : nullptr, 1024 );
+                    mh0.set(rank, 3);
+                    mh1.set(rank, 1000); // > threshold
+                    mh0.postMessage(next_rank());
+                    mh1.postMessage(next_rank());
+                    mh0.postMessage(next_rank(-1));
+                    ok &= isAligned(alignment);
+                    mh0.set(-1, 0);
+                    mh1.set(-1, 0);
+                    ::mpi12s::theMessageBuffer.broadcast();
+                    ok &= isAligned(alignment);
+                    ::mpi12s::theMessageBuffer.readMessages();
+                    ::mpi12s::theMessageBuffer.clear();
+                    ok &= mh1.check( next_rank(-1), 1000 );
+                    ok &= mh0.check( ( mh0.x.size() && mh0.x[0] == next_rank() ? next_rank() : next_rank(-1) ), 3 );
+                }
+        }
+        ::mpi12s::theMessageBuffer.setThreadPool(nullptr);
+        ::mpi12s::theMessageBuffer.setPayloadAlignment(::mpi12s::MessageBuffer::CACHE_LINE);
+        ::mpi12s::simd::setStreamingThreshold(threshold);
+
+     // The received payloads fit in the payload arena, although the broadcast messages are placed
+     // after the point-to-point messages, and not in the order of the headers.
+        for( int m = 0; m < 2; ++m )
+        {
+            ::mpi12s::theMessageBuffer.initialize(1, 10);
+            ::mpi12s::theMessageBuffer.setExchangeMode( m ? ::mpi12s::MessageBuffer::ONESIDED : ::mpi12s::MessageBuffer::FLAT );
+            mh0.set(rank, 7); // 8 words
+            mh1.set(rank, 0); // 1 word
+            mh0.postMessageToAll();
+            mh1.postMessage(next_rank());
+            mh0.set(-1, 0);
+            mh1.set(-1, 1);
+            ::mpi12s::theMessageBuffer.broadcast();
+            ok &= ( ::mpi12s::theMessageBuffer.payloadSizeUsed() <= ::mpi12s::theMessageBuffer.payloadSize() );
+            ok &= isAligned(::mpi12s::MessageBuffer::CACHE_LINE);
+            ::mpi12s::theMessageBuffer.readMessages();
+            ::mpi12s::theMessageBuffer.clear();
+            ok &= ( mh0.x.size() == 7 ) && ( mh0.x[0] != rank ) && mh0.check( int(mh0.x[0]), 7 );
+            ok &= mh1.x.empty();
+        }
+        ::mpi12s::theMessageBuffer.setExchangeMode(::mpi12s::MessageBuffer::FLAT);
+
+        std::cout<<::mpi12s::info<<" done, ok="<<ok<<std::endl;
+        finalize();
+        return ok;
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace test30
+
+namespace bench_wire_layouts
+{//---------------------------------------------------------------------------------------------------------------------
+ // Time packing and unpacking every stride-th particle of nParticles particles with properties
+ // x, v, a (3D double vectors), r and m (double) in the AOS, SOA and AOSOA wire layouts.
+    typedef Eigen::Matrix<double, 3, 1, Eigen::DontAlign> vec_t;
+
+    std::string run(size_t nParticles, size_t stride, int nRepeat)
+    {
+        std::vector<vec_t>  x(nParticles, vec_t(1,2,3)), v(nParticles, vec_t(4,5,6)), a(nParticles, vec_t(7,8,9));
+        std::vector<double> r(nParticles, 1.0), m(nParticles, 2.0);
+        ::mpi12s::PropertySet properties;
+        properties.push_back(x);
+        properties.push_back(v);
+        properties.push_back(a);
+        properties.push_back(r);
+        properties.push_back(m);
+
+        std::vector<Index_t> indices;
+        for( size_t i = 0; i < nParticles; i += std::max<size_t>(stride, 1) )
+            indices.push_back(i);
+
+        std::vector<::mpi12s::WireLayoutTiming> timings
+          = ::mpi12s::benchmarkWireLayouts( properties, indices, {8, 32, 128, 512}, nRepeat );
+
+        std::stringstream ss;
+        ss<<"nParticles="<<nParticles<<" stride="<<stride<<" elementSize="<<properties.elementSize()<<'\n'
+          <<std::setw(8)<<"layout"<<std::setw(10)<<"blockSize"<<std::setw(14)<<"pack[s]"<<std::setw(14)<<"unpack[s]"<<'\n';
+        for( ::mpi12s::WireLayoutTiming const& timing : timings )
+            ss<<std::setw(8)<<::mpi12s::toStr(timing.layout)<<std::setw(10)<<timing.blockSize
+              <<std::setw(14)<<timing.packSeconds<<std::setw(14)<<timing.unpackSeconds<<'\n';
+        return ss.str();
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace bench_wire_layouts
+
+namespace bench_simd_kernels
+{//---------------------------------------------------------------------------------------------------------------------
+ // Time gathering and scattering every stride-th element of an array of nElements floats, doubles
+ // and 3D float and double vectors, for every instruction set supported by the cpu. The bandwidth
+ // counts the bytes of the elements copied and of the indices.
+    template<typename T>
+    void runType(std::stringstream& ss, char const* name, size_t nElements, size_t stride, int nRepeat)
+    {
+        std::vector<T> array(nElements);
+        std::vector<Index_t> indices;
+        for( size_t i = 0; i < nElements; i += std::max<size_t>(stride, 1) )
+            indices.push_back(i);
+        std::vector<T> buffer(indices.size());
+        double const bytes = indices.size()*(2*sizeof(T) + sizeof(Index_t));
+        typedef std::chrono::steady_clock clock;
+        for( int isa = ::mpi12s::simd::SCALAR; isa <= ::mpi12s::simd::AVX512; ++isa )
+        {
+            if( ::mpi12s::simd::setIsa(::mpi12s::simd::Isa(isa)) != isa )
+                break;
+            double tg = 1e30, ts = 1e30;
+            for( int r = 0; r < nRepeat; ++r ) {
+                clock::time_point t0 = clock::now();
+                ::mpi12s::simd::gather( buffer.data(), array.data(), array.size(), sizeof(T), indices.data(), indices.size() );
+                clock::time_point t1 = clock::now();
+                ::mpi12s::simd::scatter( array.data(), array.size(), buffer.data(), sizeof(T), indices.data(), indices.size() );
+                clock::time_point t2 = clock::now();
+                tg = std::min( tg, std::chrono::duration<double>(t1 - t0).count() );
+                ts = std::min( ts, std::chrono::duration<double>(t2 - t1).count() );
+            }
+            ss<<std::setw(8)<<name<<std::setw(8)<<::mpi12s::simd::isaName(::mpi12s::simd::Isa(isa))
+              <<std::setw(14)<<bytes/tg*1e-9<<std::setw(14)<<bytes/ts*1e-9<<'\n';
+        }
+    }
+
+    std::string run(size_t nElements, size_t stride, int nRepeat)
+    {
+        ::mpi12s::simd::Isa supported = ::mpi12s::simd::isa();
+        std::stringstream ss;
+        ss<<"nElements="<<nElements<<" stride="<<stride<<'\n'
+          <<std::setw(8)<<"type"<<std::setw(8)<<"isa"<<std::setw(14)<<"gather[GB/s]"<<std::setw(14)<<"scatter[GB/s]"<<'\n';
+        runType<float >(ss, "float" , nElements, stride, nRepeat);
+        runType<double>(ss, "double", nElements, stride, nRepeat);
+        runType<Eigen::Matrix<float ,3,1,Eigen::DontAlign>>(ss, "vec3f", nElements, stride, nRepeat);
+        runType<Eigen::Matrix<double,3,1,Eigen::DontAlign>>(ss, "vec3d", nElements, stride, nRepeat);
+        ::mpi12s::simd::setIsa(supported);
+        return ss.str();
+    }
+ //---------------------------------------------------------------------------------------------------------------------
+}// namespace bench_simd_kernels
+
 PYBIND11_MODULE(core, m)
 {// optional module doc-string
     m.doc() = "pybind11 core plugin"; // optional module docstring
@@ -850,4 +3217,32 @@ PYBIND11_MODULE(core, m)
     m.def("test4", &test4::test, "");
     m.def("test5", &test5::test, "");
     m.def("test6", &test6::test, "");
+    m.def("test7", &test7::test, "");
+    m.def("test8", &test8::test, "");
+    m.def("test9", &test9::test, "");
+    m.def("test10", &test10::test, "");
+    m.def("test11", &test11::test, "");
+    m.def("test12", &test12::test, "");
+    m.def("test13", &test13::test, "");
+    m.def("test14", &test14::test, "");
+    m.def("test15", &test15::test, "");
+    m.def("test16", &test16::test, "");
+    m.def("test17", &test17::test, "");
+    m.def("test18", &test18::test, "");
+    m.def("test19", &test19::test, "");
+    m.def("test20", &test20::test, "");
+    m.def("test21", &test21::test, "");
+    m.def("test22", &test22::test, "");
+    m.def("test23", &test23::test, "");
+    m.def("test24", &test24::test, "");
+    m.def("test25", &test25::test, "");
+    m.def("test26", &test26::test, "");
+    m.def("test27", &test27::test, "");
+    m.def("test28", &test28::test, "");
+    m.def("test29", &test29::test, "");
+    m.def("test30", &test30::test, "");
+    m.def("bench_wire_layouts", &bench_wire_layouts::run, "Time pack and unpack of particle properties in the AOS, SOA and AOSOA wire layouts."
+         , py::arg("nParticles") = 1000000, py::arg("stride") = 2, py::arg("nRepeat") = 10);
+    m.def("bench_simd_kernels", &bench_simd_kernels::run, "Bandwidth of the gather and scatter kernels for every instruction set supported by the cpu."
+         , py::arg("nElements") = 4000000, py::arg("stride") = 2, py::arg("nRepeat") = 10);
 }
@@ -4,12 +4,21 @@
 #include <type_traits>
 #include <vector>
 #include <string>
+#include <memory>
+#include <array>
+#include <cstdint>
 #include <Eigen/Geometry>
+#include "RaggedArray.h"
+#include "Reflection.h"
+#include "SimdKernels.h"
 
 typedef int64_t Index_t;
 
 namespace mpi12s
-{//-------------------------------------------------------------------------------------------------
+{
+    template<typename T, typename A = std::allocator<T>>
+    class DefaultInitAllocator; // see below
+ //-------------------------------------------------------------------------------------------------
    namespace internal
     {// This contains the machinery
      //-------------------------------------------------------------------------------------------------
@@ -24,7 +33,23 @@ namespace mpi12s
         }
      //-------------------------------------------------------------------------------------------------
         template<typename T>
-        struct fixed_size_memcpy_able : std::is_trivially_copyable<T> {};
+        struct fixed_size_memcpy_able;
+
+     // Aggregates (see Reflection.h) whose fields are all fixed_size_memcpy_able are also fixed size
+     // memcpy-able (even if they are not trivially copyable, e.g. with Eigen fields), and are copied
+     // as a whole, by a single memcpy.
+        template<typename T>
+        constexpr bool isFixedSizeAggregate()
+        {
+            if constexpr( std::is_trivially_copyable<T>::value || !reflection::isReflectable<T>() )
+                return false;
+            else
+                return reflection::allFields<T, fixed_size_memcpy_able>();
+        }
+
+        template<typename T>
+        struct fixed_size_memcpy_able
+          : std::bool_constant<std::is_trivially_copyable<T>::value || isFixedSizeAggregate<T>()> {};
      //-------------------------------------------------------------------------------------------------
      // specializations:
         template<typename T>
@@ -33,23 +58,403 @@ namespace mpi12s
         template<typename T>
         struct fixed_size_memcpy_able<T*> : std::false_type {};
 
-     // Specializations for vector types
-        template<typename T, int N>
-        struct fixed_size_memcpy_able<Eigen::Matrix<T,N,1,Eigen::DontAlign>> : std::true_type {};
-     // TODO
-     // Also provide specializations for Vector, Point, Quaternion, ...
+        template<typename T, size_t N>
+        struct fixed_size_memcpy_able<std::array<T,N>> : fixed_size_memcpy_able<T> {};
+
+     // Specializations for Eigen types of fixed size (aligned or not), and quaternions
+        template<typename T, int R, int C, int O, int MR, int MC>
+        struct fixed_size_memcpy_able<Eigen::Matrix<T,R,C,O,MR,MC>>
+          : std::bool_constant<R != Eigen::Dynamic && C != Eigen::Dynamic && fixed_size_memcpy_able<T>::value> {};
+
+        template<typename T, int R, int C, int O, int MR, int MC>
+        struct fixed_size_memcpy_able<Eigen::Array<T,R,C,O,MR,MC>>
+          : std::bool_constant<R != Eigen::Dynamic && C != Eigen::Dynamic && fixed_size_memcpy_able<T>::value> {};
+
+        template<typename T, int O>
+        struct fixed_size_memcpy_able<Eigen::Quaternion<T,O>> : fixed_size_memcpy_able<T> {};
 
      //-------------------------------------------------------------------------------------------------
         template<typename T>
         struct variable_size_memcpy_able : std::false_type {};
      //-------------------------------------------------------------------------------------------------
      // specializations:
-        template<typename T>
-        struct variable_size_memcpy_able<std::vector<T>> : fixed_size_memcpy_able<T> {};
+        template<typename T, typename A>
+        struct variable_size_memcpy_able<std::vector<T,A>> : fixed_size_memcpy_able<T> {};
 
         template<>
         struct variable_size_memcpy_able<std::string> : std::true_type {}; // C++17 required
 
+     //-------------------------------------------------------------------------------------------------
+     // Ragged containers: a collection of variable size rows of fixed size elements. In a message they
+     // are represented as the number of rows n, n+1 offsets of the rows (starting with 0), and all the
+     // elements, row after row. So, the rows are written in a single pass, without a size prefix per
+     // row, and std::vector<std::vector<T>> and RaggedArray<T> are interchangeable.
+        template<typename T>
+        struct ragged_memcpy_able : std::false_type {};
+     //-------------------------------------------------------------------------------------------------
+     // specializations:
+        template<typename T, typename A, typename AOuter>
+        struct ragged_memcpy_able<std::vector<std::vector<T,A>,AOuter>> : fixed_size_memcpy_able<T> {};
+
+        template<typename C, typename Tr, typename A, typename AOuter>
+        struct ragged_memcpy_able<std::vector<std::basic_string<C,Tr,A>,AOuter>> : std::true_type {};
+
+        template<typename T>
+        struct ragged_memcpy_able<RaggedArray<T>> : fixed_size_memcpy_able<T> {};
+
+     //-------------------------------------------------------------------------------------------------
+     // Aggregates with fields that are not fixed size (e.g. a std::vector of bonds), but all memcpy-able.
+     // The fields are written one after the other (consecutive fixed size fields by a single memcpy).
+        template<typename T>
+        struct memcpy_able;
+
+        template<typename T>
+        constexpr bool isVariableSizeAggregate()
+        {
+            if constexpr( !reflection::isReflectable<T>() || fixed_size_memcpy_able<T>::value )
+                return false;
+            else
+                return reflection::allFields<T, memcpy_able>();
+        }
+
+        template<typename T>
+        struct aggregate_memcpy_able : std::bool_constant<isVariableSizeAggregate<T>()> {};
+
+     //-------------------------------------------------------------------------------------------------
+     // A std::vector of such aggregates, with fields that are fixed size or variable size memcpy-able,
+     // is decomposed into columns: the number of elements, followed by the columns of the fields, i.e.
+     // the values of a fixed size field of all elements, or a variable size field of all elements in
+     // the representation of a ragged container (offsets and data).
+        template<typename T>
+        struct column_field_memcpy_able
+          : std::bool_constant<fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value> {};
+
+        template<typename T>
+        constexpr bool isColumnAggregate()
+        {
+            if constexpr( !aggregate_memcpy_able<T>::value )
+                return false;
+            else
+                return reflection::allFields<T, column_field_memcpy_able>();
+        }
+
+        template<typename T>
+        struct column_memcpy_able : std::false_type {};
+
+        template<typename T, typename A>
+        struct column_memcpy_able<std::vector<T,A>> : std::bool_constant<isColumnAggregate<T>()> {};
+
+     //-------------------------------------------------------------------------------------------------
+        template<typename T>
+        struct memcpy_able
+          : std::bool_constant
+            < fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value
+           || ragged_memcpy_able<T>::value || aggregate_memcpy_able<T>::value || column_memcpy_able<T>::value
+            > {};
+
+     // Can T be copied as a prefix followed by a single contiguous block of data (see memcpy_traits::data())?
+     // The others are written and read as a whole.
+        template<typename T>
+        struct contiguous_memcpy_able
+          : std::bool_constant<fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value> {};
+
+     //-------------------------------------------------------------------------------------------------
+     // Copy n elements from a message buffer to a container (std::vector or std::string). assign()
+     // copies the elements straight from the buffer, whereas resize() followed by memcpy would first
+     // value-initialise (zero) all the elements. But assign() requires a properly aligned buffer.
+     // Large copies go through simd::copy() (streaming stores) after a resize(), but only if that does
+     // not initialise anything: c already has n elements (repeated exchanges of the same array), or
+     // its allocator default-initialises (DefaultInitAllocator).
+        template<typename Container>
+        inline void
+        assignFromBuffer(Container& c, void const* src, size_t n)
+        {
+            typedef typename Container::value_type value_type;
+            constexpr bool defaultInit
+              = std::is_same<typename Container::allocator_type, DefaultInitAllocator<value_type>>::value;
+            if( n * sizeof(value_type) >= simd::streamingThreshold() && ( defaultInit || c.size() == n ) ) {
+                c.resize(n);
+                simd::copy( c.data(), src, n * sizeof(value_type) );
+            } else if( reinterpret_cast<uintptr_t>(src) % alignof(value_type) == 0 ) {
+                value_type const* first = static_cast<value_type const*>(src);
+                c.assign( first, first + n );
+            } else {
+                c.resize(n);
+                memcpy( static_cast<void*>(c.data()), src, n * sizeof(value_type) );
+            }
+        }
+
+     //-------------------------------------------------------------------------------------------------
+        template<typename T>
+        struct ragged_traits
+     // The ragged containers whose rows are separate containers (std::vector<std::vector<T>>, ...)
+     //-------------------------------------------------------------------------------------------------
+        {
+            typedef typename T::value_type row_type;
+            typedef typename row_type::value_type element_type;
+
+            static size_t nElements(T const& t)
+            {
+                size_t n = 0;
+                for( row_type const& row : t )
+                    n += row.size();
+                return n;
+            }
+
+            static size_t messageSize(T const& t) {
+                return ( t.size() + 2 ) * sizeof(size_t) + nElements(t) * sizeof(element_type);
+            }
+
+            static void write(T const& t, void*& dst)
+            {
+                size_t nRows = t.size();
+                memcpy( dst, &nRows, sizeof(size_t) );
+                advance_void_ptr( dst, sizeof(size_t) );
+             // the offsets
+                size_t offset = 0;
+                memcpy( dst, &offset, sizeof(size_t) );
+                advance_void_ptr( dst, sizeof(size_t) );
+                for( row_type const& row : t ) {
+                    offset += row.size();
+                    memcpy( dst, &offset, sizeof(size_t) );
+                    advance_void_ptr( dst, sizeof(size_t) );
+                }
+             // the elements
+                for( row_type const& row : t ) {
+                    size_t nBytes = row.size() * sizeof(element_type);
+                    memcpy( dst, row.data(), nBytes );
+                    advance_void_ptr( dst, nBytes );
+                }
+            }
+
+            static void read(T& t, void*& src)
+            {
+                size_t nRows;
+                memcpy( &nRows, src, sizeof(size_t) );
+                advance_void_ptr( src, sizeof(size_t) );
+                char const* offsets = static_cast<char const*>(src);
+                advance_void_ptr( src, ( nRows + 1 ) * sizeof(size_t) );
+                t.resize(nRows);
+                size_t begin = 0;
+                for( size_t i = 0; i < nRows; ++i ) {
+                    size_t end;
+                    memcpy( &end, offsets + ( i + 1 ) * sizeof(size_t), sizeof(size_t) );
+                    assignFromBuffer( t[i], static_cast<char const*>(src) + begin * sizeof(element_type), end - begin );
+                    begin = end;
+                }
+                advance_void_ptr( src, begin * sizeof(element_type) );
+            }
+        };
+
+     //-------------------------------------------------------------------------------------------------
+        template<typename T>
+        struct ragged_traits<RaggedArray<T>>
+     // RaggedArray<T> is written and read with two copies: the offsets and the data.
+     //-------------------------------------------------------------------------------------------------
+        {
+            typedef T element_type;
+
+            static size_t nElements(RaggedArray<T> const& t) { return t.nElements(); }
+
+            static size_t messageSize(RaggedArray<T> const& t) {
+                return ( t.size() + 2 ) * sizeof(size_t) + t.nElements() * sizeof(T);
+            }
+
+            static void write(RaggedArray<T> const& t, void*& dst)
+            {
+                size_t nRows = t.size();
+                memcpy( dst, &nRows, sizeof(size_t) );
+                advance_void_ptr( dst, sizeof(size_t) );
+                size_t nBytes = ( nRows + 1 ) * sizeof(size_t);
+                memcpy( dst, t.offsets().data(), nBytes );
+                advance_void_ptr( dst, nBytes );
+                nBytes = t.nElements() * sizeof(T);
+                simd::copy( dst, t.data().data(), nBytes );
+                advance_void_ptr( dst, nBytes );
+            }
+
+            static void read(RaggedArray<T>& t, void*& src)
+            {
+                size_t nRows;
+                memcpy( &nRows, src, sizeof(size_t) );
+                advance_void_ptr( src, sizeof(size_t) );
+                t.offsets().resize( nRows + 1 );
+                memcpy( t.offsets().data(), src, ( nRows + 1 ) * sizeof(size_t) );
+                advance_void_ptr( src, ( nRows + 1 ) * sizeof(size_t) );
+                size_t n = t.offsets().back();
+                assignFromBuffer( t.data(), src, n );
+                advance_void_ptr( src, n * sizeof(T) );
+            }
+        };
+
+        template<typename T>
+        struct memcpy_traits;
+
+     //-------------------------------------------------------------------------------------------------
+        template<typename T>
+        struct aggregate_traits
+     // Aggregates with variable size fields: the fields are written one after the other. Runs of fixed
+     // size fields that are adjacent in memory (no padding between them) are copied by a single memcpy.
+     //-------------------------------------------------------------------------------------------------
+        {
+            static size_t messageSize(T& t)
+            {
+                return std::apply
+                  ( [](auto&... f) -> size_t {
+                        return ( memcpy_traits<std::remove_reference_t<decltype(f)>>::messageSize(f) + ... + 0 );
+                    }
+                  , reflection::fields(t)
+                  );
+            }
+
+            template<bool Write>
+            static void transfer(T& t, void*& ptr)
+            {
+             // The current run of adjacent fixed size fields, as byte offsets in t, so that the memcpy
+             // of a run accesses t, rather than past the end of the first field of the run.
+                char* base = reinterpret_cast<char*>(&t);
+                size_t runBegin = 0;
+                size_t runSize = 0;
+                auto flush = [&]() {
+                    if( runSize == 0 )
+                        return;
+                    if constexpr(Write) memcpy( ptr, base + runBegin, runSize );
+                    else                memcpy( base + runBegin, ptr, runSize );
+                    advance_void_ptr( ptr, runSize );
+                    runSize = 0;
+                };
+                auto field = [&](auto& f) {
+                    typedef std::remove_reference_t<decltype(f)> F;
+                    if constexpr(fixed_size_memcpy_able<F>::value) {
+                        size_t offset = static_cast<size_t>( reinterpret_cast<char*>(&f) - base );
+                        if( runSize > 0 && offset == runBegin + runSize )
+                            runSize += sizeof(F);
+                        else {
+                            flush();
+                            runBegin = offset;
+                            runSize = sizeof(F);
+                        }
+                    } else {
+                        flush();
+                        if constexpr(Write) memcpy_traits<F>::write(f, ptr);
+                        else                memcpy_traits<F>::read (f, ptr);
+                    }
+                };
+                std::apply( [&](auto&... f) { ( field(f), ... ); }, reflection::fields(t) );
+                flush();
+            }
+        };
+
+     //-------------------------------------------------------------------------------------------------
+        template<typename T>
+        struct column_traits
+     // A std::vector of aggregates, decomposed into columns (see column_memcpy_able).
+     //-------------------------------------------------------------------------------------------------
+        {
+            typedef typename T::value_type element_type;
+            typedef reflection::fieldTypes_t<element_type> field_types;
+            static size_t const nFields = std::tuple_size<field_types>::value;
+
+            template<size_t I>
+            static auto& field(element_type& e) { return std::get<I>( reflection::fields(e) ); }
+
+            template<size_t I>
+            static size_t columnSize(T& t)
+            {
+                typedef std::tuple_element_t<I, field_types> F;
+                if constexpr(fixed_size_memcpy_able<F>::value)
+                    return t.size() * sizeof(F);
+                else {
+                    size_t n = 0;
+                    for( element_type& e : t )
+                        n += field<I>(e).size();
+                    return ( t.size() + 1 ) * sizeof(size_t) + n * sizeof(typename F::value_type);
+                }
+            }
+
+            template<size_t I>
+            static void writeColumn(T& t, void*& dst)
+            {
+                typedef std::tuple_element_t<I, field_types> F;
+                if constexpr(fixed_size_memcpy_able<F>::value) {
+                    char* d = static_cast<char*>(dst);
+                    for( element_type& e : t ) {
+                        memcpy( d, &field<I>(e), sizeof(F) );
+                        d += sizeof(F);
+                    }
+                    dst = d;
+                } else {
+                    size_t offset = 0;
+                    memcpy( dst, &offset, sizeof(size_t) );
+                    advance_void_ptr( dst, sizeof(size_t) );
+                    for( element_type& e : t ) {
+                        offset += field<I>(e).size();
+                        memcpy( dst, &offset, sizeof(size_t) );
+                        advance_void_ptr( dst, sizeof(size_t) );
+                    }
+                    for( element_type& e : t ) {
+                        size_t nBytes = field<I>(e).size() * sizeof(typename F::value_type);
+                        memcpy( dst, field<I>(e).data(), nBytes );
+                        advance_void_ptr( dst, nBytes );
+                    }
+                }
+            }
+
+            template<size_t I>
+            static void readColumn(T& t, void*& src)
+            {
+                typedef std::tuple_element_t<I, field_types> F;
+                if constexpr(fixed_size_memcpy_able<F>::value) {
+                    char const* s = static_cast<char const*>(src);
+                    for( element_type& e : t ) {
+                        memcpy( static_cast<void*>(&field<I>(e)), s, sizeof(F) );
+                        s += sizeof(F);
+                    }
+                    src = const_cast<char*>(s);
+                } else {
+                    typedef typename F::value_type value_type;
+                    char const* offsets = static_cast<char const*>(src);
+                    advance_void_ptr( src, ( t.size() + 1 ) * sizeof(size_t) );
+                    size_t begin = 0;
+                    for( size_t i = 0; i < t.size(); ++i ) {
+                        size_t end;
+                        memcpy( &end, offsets + ( i + 1 ) * sizeof(size_t), sizeof(size_t) );
+                        assignFromBuffer( field<I>(t[i]), static_cast<char const*>(src) + begin * sizeof(value_type), end - begin );
+                        begin = end;
+                    }
+                    advance_void_ptr( src, begin * sizeof(value_type) );
+                }
+            }
+
+            static size_t messageSize(T& t)
+            {
+                return [&]<size_t... I>(std::index_sequence<I...>) {
+                    return sizeof(size_t) + ( columnSize<I>(t) + ... + 0 );
+                }( std::make_index_sequence<nFields>{} );
+            }
+
+            static void write(T& t, void*& dst)
+            {
+                size_t n = t.size();
+                memcpy( dst, &n, sizeof(size_t) );
+                advance_void_ptr( dst, sizeof(size_t) );
+                [&]<size_t... I>(std::index_sequence<I...>) {
+                    ( writeColumn<I>(t, dst), ... );
+                }( std::make_index_sequence<nFields>{} );
+            }
+
+            static void read(T& t, void*& src)
+            {
+                size_t n;
+                memcpy( &n, src, sizeof(size_t) );
+                advance_void_ptr( src, sizeof(size_t) );
+                t.resize(n);
+                [&]<size_t... I>(std::index_sequence<I...>) {
+                    ( readColumn<I>(t, src), ... );
+                }( std::make_index_sequence<nFields>{} );
+            }
+        };
+
      //-------------------------------------------------------------------------------------------------
         template<typename T>
         struct memcpy_traits
@@ -87,8 +492,20 @@ namespace mpi12s
                 {// the size of siz_t + the size of a single T::value_type times the number of items in the collection
                     return sizeof(size_t) + sizeof(typename T::value_type) * t.size();
                 }
+                else if constexpr(ragged_memcpy_able<T>::value)
+                {// the number of rows, the offsets, and the elements
+                    return ragged_traits<T>::messageSize(t);
+                }
+                else if constexpr(aggregate_memcpy_able<T>::value)
+                {// the fields
+                    return aggregate_traits<T>::messageSize(t);
+                }
+                else if constexpr(column_memcpy_able<T>::value)
+                {// the number of elements, and the columns
+                    return column_traits<T>::messageSize(t);
+                }
                 else
-                    static_assert(fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value, "type T is not memcpy-able");
+                    static_assert(memcpy_able<T>::value, "type T is not memcpy-able");
             }
 
          // write a T to a buffer
@@ -133,7 +550,7 @@ namespace mpi12s
 
                  // write the collection:
                     nBytes = size * sizeof(typename T::value_type);
-                    memcpy( dst, &t[0], nBytes );
+                    simd::copy( dst, &t[0], nBytes );
                  // advance the pointer in the buffer
                     advance_void_ptr(dst, nBytes);
                     if constexpr(::mpi12s::_debug_ && _debug_)
@@ -142,8 +559,18 @@ namespace mpi12s
                                     )
                              );
                 }
+                else if constexpr(ragged_memcpy_able<T>::value)
+                {
+                    if constexpr(::mpi12s::_debug_ && _debug_)
+                        prdbg( tostr("ragged_memcpy_able<T=", typeid(T).name(), ">::write(t, dst=", dst, ")") );
+                    ragged_traits<T>::write(t, dst);
+                }
+                else if constexpr(aggregate_memcpy_able<T>::value)
+                    aggregate_traits<T>::template transfer<true>(t, dst);
+                else if constexpr(column_memcpy_able<T>::value)
+                    column_traits<T>::write(t, dst);
                 else
-                    static_assert(fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value, "type T is not memcpy-able");
+                    static_assert(memcpy_able<T>::value, "type T is not memcpy-able");
             }
 
         // read a T from a buffer
@@ -184,11 +611,10 @@ namespace mpi12s
                                     )
                              );
 
-                 // resize the collection
-                    t.resize(size);
-                 // read the collection:
-                    nBytes = size * sizeof(typename T::value_type);
-                    memcpy( &t[0], src, nBytes );
+                 // read the collection
+                    typedef typename T::value_type value_type;
+                    nBytes = size * sizeof(value_type);
+                    assignFromBuffer( t, src, size );
                  // advance the pointer in the buffer
                     advance_void_ptr(src, nBytes);
                     if constexpr(::mpi12s::_debug_ && _debug_)
@@ -197,13 +623,100 @@ namespace mpi12s
                                     )
                              );
 }
+                else if constexpr(ragged_memcpy_able<T>::value)
+                {
+                    if constexpr(::mpi12s::_debug_ && _debug_)
+                        prdbg( tostr("ragged_memcpy_able<T=", typeid(T).name(), ">::read(t, src=", src, ")") );
+                    ragged_traits<T>::read(t, src);
+                }
+                else if constexpr(aggregate_memcpy_able<T>::value)
+                    aggregate_traits<T>::template transfer<false>(t, src);
+                else if constexpr(column_memcpy_able<T>::value)
+                    column_traits<T>::read(t, src);
                 else
-                    static_assert(fixed_size_memcpy_able<T>::value || variable_size_memcpy_able<T>::value, "type T is not memcpy-able");
+                    static_assert(memcpy_able<T>::value, "type T is not memcpy-able");
+            }
+
+         // The message representation of t consists of a prefix (the size of a collection, or nothing for
+         // fixed size objects), followed by t's data. The functions below allow to copy the data separately,
+         // e.g. in chunks, in parallel.
+            static
+            size_t      // the size of the prefix, in bytes
+            prefixSize()
+            {
+                if constexpr(variable_size_memcpy_able<T>::value)
+                    return sizeof(size_t);
+                else
+                    return 0;
+            }
+
+         // Write the prefix of t to dst.
+            static void writePrefix(T& t, void* dst)
+            {
+                if constexpr(variable_size_memcpy_able<T>::value) {
+                    size_t size = t.size();
+                    memcpy( dst, &size, sizeof(size_t) );
+                }
+            }
+
+         // Read the prefix of t from src, and resize t accordingly. (For a std::vector<T> the new elements
+         // are value-initialised, use a std::vector<T,DefaultInitAllocator<T>> to avoid that.)
+            static void readPrefix(T& t, void const* src)
+            {
+                if constexpr(variable_size_memcpy_able<T>::value) {
+                    size_t size;
+                    memcpy( &size, src, sizeof(size_t) );
+                    t.resize(size);
+                }
+            }
+
+         // Pointer to the data of t, and its size in bytes
+            static void* data(T& t)
+            {
+                if constexpr(variable_size_memcpy_able<T>::value)
+                    return const_cast<typename T::value_type*>(t.data());
+                else
+                    return &t;
+            }
+            static size_t dataSize(T& t)
+            {
+                if constexpr(variable_size_memcpy_able<T>::value)
+                    return t.size() * sizeof(typename T::value_type);
+                else
+                    return sizeof(T);
             }
         };
      //-------------------------------------------------------------------------------------------------
     }// namespace internal 
 
+ //-------------------------------------------------------------------------------------------------
+ // An allocator which default-initialises rather than value-initialises, i.e. resize() and 
+ // emplace_back() without arguments leave trivial elements uninitialised, instead of zeroing them.
+ // A std::vector<T,DefaultInitAllocator<T>> is useful as a message item that is immediately 
+ // overwritten when a message is read, in particular when messages are read in parallel 
+ // (MessageBuffer::setThreadPool()), as that resizes the vector before copying the elements.
+    template<typename T, typename A>
+    class DefaultInitAllocator : public A
+    {
+        typedef std::allocator_traits<A> traits_;
+    public:
+        template<typename U>
+        struct rebind {
+            typedef DefaultInitAllocator<U, typename traits_::template rebind_alloc<U>> other;
+        };
+
+        using A::A;
+
+        template<typename U>
+        void construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value) {
+            ::new(static_cast<void*>(ptr)) U; // default-initialisation
+        }
+        template<typename U, typename... Args>
+        void construct(U* ptr, Args&&... args) {
+            traits_::construct( static_cast<A&>(*this), ptr, std::forward<Args>(args)... );
+        }
+    };
+
  //-------------------------------------------------------------------------------------------------
  // The three template functions that the outside world should use for reading and writing messages.
  //------------------------------------------------------------------------------------------------- 
@@ -5,6 +5,9 @@
 #include <sstream>
 #include <chrono>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
 
 
 namespace mpi12s
@@ -14,14 +17,46 @@ namespace mpi12s
     std::string info;
     std::string dbg_fname;
     int64_t timestamp0;
+    int threadSupport = MPI_THREAD_SINGLE;
 
+ //---------------------------------------------------------------------------------------------------------------------
+ // The progress thread
+ //---------------------------------------------------------------------------------------------------------------------
+ // Most MPI implementations only progress non-blocking operations while some thread is inside the MPI library. The 
+ // progress thread enters the library periodically, by probing a private communicator, on which no messages are ever
+ // sent, so the probe never interferes with the application's messages.
+    namespace
+    {
+        std::thread       progressThread;
+        std::atomic<bool> stopProgress(false);
+        MPI_Comm          progressComm = MPI_COMM_NULL;
+        int const         progressIntervalMicroseconds = 20;
+
+        void progress()
+        {
+            while( !stopProgress.load(std::memory_order_relaxed) ) {
+                int flag = 0;
+                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, progressComm, &flag, MPI_STATUS_IGNORE);
+                std::this_thread::sleep_for( std::chrono::microseconds(progressIntervalMicroseconds) );
+            }
+        }
+    }
+
+    bool progressThreadRunning()
+    {
+        return progressThread.joinable();
+    }
 
-    void init()
+    void init(ThreadMode threadMode)
     {// initialize MPI
         int argc = 0;
         char **argv = nullptr;
-        int success =
-        MPI_Init(&argc, &argv);
+        int success;
+        if( threadMode == SINGLE ) {
+            success = MPI_Init(&argc, &argv);
+        } else {
+            success = MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &threadSupport);
+        }
 
      // initialize rank and size
         MPI_Comm_size(MPI_COMM_WORLD, &size);
@@ -32,6 +67,19 @@ namespace mpi12s
         ss<<"MPI rank ["<<rank<<'/'<<size<<']';
         info = ss.str();
 
+        if( threadMode != SINGLE )
+        {
+            if( threadSupport < MPI_THREAD_MULTIPLE ) {
+                std::string errmsg = info + "mpi12s::init() : MPI does not provide MPI_THREAD_MULTIPLE.";
+                throw std::runtime_error(errmsg);
+            }
+            if( threadMode == MULTIPLE_PROGRESS ) {
+                MPI_Comm_dup(MPI_COMM_WORLD, &progressComm);
+                stopProgress = false;
+                progressThread = std::thread(progress);
+            }
+        }
+
      // initialize debug output file.
         if constexpr(_debug_)
         {
@@ -64,6 +112,11 @@ namespace mpi12s
 
     void finalize()
     {
+        if( progressThread.joinable() ) {
+            stopProgress = true;
+            progressThread.join();
+            MPI_Comm_free(&progressComm);
+        }
         int success = MPI_Finalize();
         if constexpr(::mpi12s::_verbose_) {
             std::string msg = (success==MPI_SUCCESS ? "mpi12s::finalize()\n  MPI_Finalize succeeded."
@@ -78,6 +131,8 @@ namespace mpi12s
     const Lines_t nolines;
     void prdbg(std::string const& s, Lines_t const& lines)
     {
+        if( dbg_fname.empty() )
+            return; // init() was not called (e.g. ranks running on an InProcessTransport)
         FILE* fh = fopen(dbg_fname.c_str(), "a");
         if(fh==nullptr){printf("%s failed to open .dbg file: permission issue?\n", CINFO); exit(1);}
 
@@ -28,17 +28,32 @@ namespace mpi12s // this code is both for the one-sided approach and for the two
     extern int rank;
     extern int size;
     extern std::string info; // "MPI rank [rank/size]", useful for debugging messages
+    extern int threadSupport; // the level of thread support provided by MPI (MPI_THREAD_SINGLE, ...)
 
  // typedefs
     typedef std::vector<std::string> Lines_t;
 
 
+ // The level of thread support requested by init()
+    enum ThreadMode
+      { SINGLE            // MPI_Init: only the main thread calls MPI.
+      , MULTIPLE          // MPI_Init_thread with MPI_THREAD_MULTIPLE: any thread may call MPI.
+      , MULTIPLE_PROGRESS // As MULTIPLE, and a background thread drives the progress of the outstanding
+                          // non-blocking operations (e.g. between MessageBuffer::startBroadcast() and 
+                          // MessageBuffer::finishBroadcast()), while the application computes.
+      };
+
  // Initialize MPI
-    void init();
+    void init
+      ( ThreadMode threadMode = SINGLE
+      );
 
- // finalize MPI
+ // finalize MPI (stops the progress thread, if any)
     void finalize();
 
+ // Is the progress thread running?
+    bool progressThreadRunning();
+
  // get the rank corresponding to rank_ + n
     inline int // result is always in [0,size_[ (as with periodic boundary conditions)
     next_rank
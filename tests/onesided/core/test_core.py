@@ -55,6 +55,137 @@ def test_6():
     print(f"ok = {ok}")
     assert ok
 
+def test_7():
+    ok = onesided.core.test7()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_8():
+    ok = onesided.core.test8()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_9():
+    ok = onesided.core.test9()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_10():
+    ok = onesided.core.test10()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_11():
+    ok = onesided.core.test11()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_12():
+    ok = onesided.core.test12()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_13():
+    ok = onesided.core.test13()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_14():
+    ok = onesided.core.test14()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_15():
+    """No MPI launcher needed."""
+    ok = onesided.core.test15()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_16():
+    ok = onesided.core.test16()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_17():
+    ok = onesided.core.test17()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_18():
+    ok = onesided.core.test18()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_19():
+    ok = onesided.core.test19()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_20():
+    ok = onesided.core.test20()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_21():
+    ok = onesided.core.test21()
+    print(f"ok = {ok}")
+    assert ok
+
+
+def test_22():
+    ok = onesided.core.test22()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_23():
+    ok = onesided.core.test23()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_24():
+    ok = onesided.core.test24()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_25():
+    ok = onesided.core.test25()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_26():
+    ok = onesided.core.test26()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_27():
+    ok = onesided.core.test27()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_28():
+    ok = onesided.core.test28()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_29():
+    ok = onesided.core.test29()
+    print(f"ok = {ok}")
+    assert ok
+
+def test_30():
+    ok = onesided.core.test30()
+    print(f"ok = {ok}")
+    assert ok
+
 
 #===============================================================================
 # The code below is for debugging a particular test in eclipse/pydev.